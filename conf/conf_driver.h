@@ -0,0 +1,191 @@
+/*
+ * This file loads the driver configuration for renard-phy-s2lp.
+ *
+ * Unlike conf_hardware.h, the options in this file do not describe the board, but enable or disable optional driver
+ * features. Every option can be overridden using a compile-time switch, e.g. -DRENARD_PHY_S2LP_SHADOW_REGISTERS=0.
+ */
+
+#ifndef _RENARD_PHY_S2LP_CONF_DRIVER_H
+#define _RENARD_PHY_S2LP_CONF_DRIVER_H
+
+/*
+ * Register shadow cache:
+ * Keep a copy of the S2-LP's configuration registers (addresses below MC_STATE1) in RAM. Reads of registers that the
+ * driver has written or read before are served from the copy and writes that would not change a register's value are
+ * skipped, which saves SPI transactions. The copy is invalidated whenever the S2-LP is reset or shut down.
+ * Costs 159 bytes of RAM.
+ */
+#ifndef RENARD_PHY_S2LP_SHADOW_REGISTERS
+#define RENARD_PHY_S2LP_SHADOW_REGISTERS 1
+#endif
+
+/*
+ * Asynchronous operation:
+ * Enables renard_phy_s2lp_tx_async, which returns right after an uplink has been started and streams the remaining
+ * symbols from the "FIFO almost empty" interrupt using asynchronous (DMA) SPI transfers. All SPI transfers from
+ * interrupt context are asynchronous, the driver never waits for SPI there. The HAL must then implement the optional
+ * asynchronous functions in renard_phy_s2lp_hal.h.
+ */
+#ifndef RENARD_PHY_S2LP_ASYNC
+#define RENARD_PHY_S2LP_ASYNC 0
+#endif
+
+/*
+ * Packed FIFO refills:
+ * Instead of writing exactly one 80-byte symbol whenever the TX FIFO is almost empty, fill up all of the FIFO's free
+ * space with a single burst write, continuing across symbol boundaries. The "FIFO almost empty" threshold is lowered
+ * to the amount of data the S2-LP transmits within RENARD_PHY_S2LP_REFILL_LATENCY_US at the uplink's datarate, so
+ * that every refill writes more data and fewer interrupts per frame are needed.
+ * Costs 260 bytes of RAM for refill buffers.
+ */
+#ifndef RENARD_PHY_S2LP_TX_PACKED_REFILL
+#define RENARD_PHY_S2LP_TX_PACKED_REFILL 0
+#endif
+
+/*
+ * TX symbol cache:
+ * By default, every refill expands its symbol waveforms from the ramp parameters in fifo_symbols.c right into a refill
+ * buffer (82 bytes, twice that with RENARD_PHY_S2LP_ASYNC for double-buffering, the packed refill buffers otherwise).
+ * Enabling the cache expands all seven waveforms into the driver context once instead (again only when the FEM power
+ * adjustment changes), symbol-wise refills are then sent straight from there and packed refills are copied from it.
+ * Costs 574 bytes of RAM per driver context (minus the 82 / 164 bytes of symbol-wise refill buffers that are no longer
+ * needed), saves about 170 CPU cycles per symbol in the refill path (measured on the host, see host/bench.c).
+ */
+#ifndef RENARD_PHY_S2LP_TX_SYMBOL_CACHE
+#define RENARD_PHY_S2LP_TX_SYMBOL_CACHE 0
+#endif
+
+/*
+ * Worst-case time in microseconds from the S2-LP asserting "FIFO almost empty" until the refill SPI transfer has
+ * completed, i.e. interrupt latency + SPI transfer of up to 130 bytes. Measure this on your platform, the default is
+ * a conservative value for a Cortex-M0+ with 8MHz SPI clock. Only used for packed FIFO refills.
+ */
+#ifndef RENARD_PHY_S2LP_REFILL_LATENCY_US
+#define RENARD_PHY_S2LP_REFILL_LATENCY_US 500
+#endif
+
+/*
+ * TX FIFO monitor:
+ * Read the TX FIFO's fill level (TX_FIFO_STATUS) right before every refill and report the lowest level seen during a
+ * frame in renard_phy_s2lp_tx_report, i.e. how much margin was left before an underrun. Costs one additional SPI
+ * transaction per refill, so only enable it to measure timing margins. Underruns are detected either way.
+ */
+#ifndef RENARD_PHY_S2LP_TX_FIFO_MONITOR
+#define RENARD_PHY_S2LP_TX_FIFO_MONITOR 0
+#endif
+
+/*
+ * Sleep before downlink:
+ * Put the S2-LP into SLEEP, which retains its registers, for the gap between the end of an uplink that requests a
+ * downlink and the start of the downlink window, instead of idling in READY. It is woken up
+ * RENARD_PHY_S2LP_WAKEUP_LEAD_MS before the window opens, which must cover the crystal oscillator's start-up time
+ * (about 1ms) plus the HAL timer's resolution. Only a timeout interrupt is pending during the gap, so the MCU can stay
+ * in its deepest sleep mode inside renard_phy_s2lp_interrupt_wait (or between protocol polls).
+ */
+#ifndef RENARD_PHY_S2LP_SLEEP_BEFORE_DOWNLINK
+#define RENARD_PHY_S2LP_SLEEP_BEFORE_DOWNLINK 1
+#endif
+
+#ifndef RENARD_PHY_S2LP_WAKEUP_LEAD_MS
+#define RENARD_PHY_S2LP_WAKEUP_LEAD_MS 2
+#endif
+
+/*
+ * Hardware RX timeout:
+ * Let the S2-LP's own RX timer (TIMERS5..4) end the downlink window instead of an MCU timer. The timer's expiry is
+ * reported through the same GPIO interrupt as received frames, so that the MCU does not need any timer while
+ * listening. The RX timer covers at most about 3s, longer windows are split into several timer periods and RX is
+ * restarted after each of them from the GPIO interrupt. When RX is restarted after a received frame, the timer is
+ * re-armed with the time left until the end of the window, so the HAL must then provide its timestamp function.
+ * See renard_phy_s2lp_rx_timeout.
+ */
+#ifndef RENARD_PHY_S2LP_RX_HW_TIMEOUT
+#define RENARD_PHY_S2LP_RX_HW_TIMEOUT 0
+#endif
+
+/*
+ * Sniff mode:
+ * Enables renard_phy_s2lp_rx_sniff. Instead of keeping the receiver on for the whole downlink window, the S2-LP's
+ * wake-up timer (low duty cycle mode) starts RX every RENARD_PHY_S2LP_SNIFF_PERIOD_MS, the receiver listens for
+ * RENARD_PHY_S2LP_SNIFF_LISTEN_US and goes back to SLEEP unless it senses a carrier above
+ * RENARD_PHY_S2LP_SNIFF_RSSI_DBM. Sigfox downlinks start with a 91 bit preamble (about 150ms at 600bps), so a period
+ * of 100ms still gives every downlink at least one chance to be sensed. Downlinks weaker than the threshold are lost.
+ * Sniffing is active by default once enabled. Cannot be combined with RENARD_PHY_S2LP_RX_HW_TIMEOUT, which needs the
+ * RX timer for the whole window.
+ */
+#ifndef RENARD_PHY_S2LP_RX_SNIFF
+#define RENARD_PHY_S2LP_RX_SNIFF 0
+#endif
+
+#ifndef RENARD_PHY_S2LP_SNIFF_PERIOD_MS
+#define RENARD_PHY_S2LP_SNIFF_PERIOD_MS 100
+#endif
+
+#ifndef RENARD_PHY_S2LP_SNIFF_LISTEN_US
+#define RENARD_PHY_S2LP_SNIFF_LISTEN_US 4000
+#endif
+
+#ifndef RENARD_PHY_S2LP_SNIFF_RSSI_DBM
+#define RENARD_PHY_S2LP_SNIFF_RSSI_DBM -125
+#endif
+
+#if (RENARD_PHY_S2LP_RX_SNIFF == 1) && (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+#error "RENARD_PHY_S2LP_RX_SNIFF and RENARD_PHY_S2LP_RX_HW_TIMEOUT cannot be enabled at the same time"
+#endif
+
+/*
+ * Downlink candidate ring:
+ * Number of received downlink candidates that can wait for decoding (sfx_downlink_decode) while the receiver is
+ * already listening again. Candidates are captured from the GPIO interrupt and decoded afterwards, so that a valid
+ * downlink right after a corrupt one is not missed. If the ring is full, the oldest candidate is decoded before the
+ * next one is captured. Costs about 24 bytes of RAM per candidate in every transfer.
+ */
+#ifndef RENARD_PHY_S2LP_DL_CANDIDATES
+#define RENARD_PHY_S2LP_DL_CANDIDATES 4
+#endif
+
+/*
+ * Statistics:
+ * Count SPI transactions, SPI bytes and TX FIFO refills and measure the worst-case gap between refills (see
+ * renard_phy_s2lp_stats), and record timestamps and results of every phase of a protocol transfer (see
+ * renard_phy_s2lp_protocol_stats). The HAL must then provide its timestamp function.
+ */
+#ifndef RENARD_PHY_S2LP_STATS
+#define RENARD_PHY_S2LP_STATS 0
+#endif
+
+/*
+ * Energy accounting:
+ * Record how long the S2-LP spends in shutdown, reset, sleep, idle (READY), RX and TX (per uplink datarate and FEM
+ * mode), see renard_phy_s2lp_energy. Combined with the board's supply current table (RENARD_PHY_S2LP_CURRENT_*_NA in
+ * conf_hardware.h and presets_hardware/), this gives an estimate of the charge drawn per transfer, see
+ * renard_phy_s2lp_protocol_energy. The HAL must then provide its timestamp function.
+ */
+#ifndef RENARD_PHY_S2LP_ENERGY
+#define RENARD_PHY_S2LP_ENERGY 0
+#endif
+
+/*
+ * Trace hook:
+ * Invoked as RENARD_PHY_S2LP_TRACE(phy, event, value) at every phase of a transfer and for every TX FIFO refill, see
+ * renard_phy_s2lp_trace_event_t in renard_phy_s2lp.h. phy is the driver context (renard_phy_s2lp_t *) of the S2-LP
+ * that the event belongs to. Define it here to a function of your own, including a declaration of that function, e.g.
+ * "struct renard_phy_s2lp; void app_trace(struct renard_phy_s2lp *phy, int event, uint32_t value);". Compiles to
+ * nothing by default.
+ */
+#ifndef RENARD_PHY_S2LP_TRACE
+#define RENARD_PHY_S2LP_TRACE(phy, event, value) do { } while (0)
+#endif
+
+/*
+ * HAL trace recorder:
+ * Build renard-phy-s2lp-hal-trace (renard_phy_s2lp_hal_trace.h), a HAL wrapper that records every HAL call of the
+ * driver to a binary trace, e.g. to capture field failures on the target. Costs up to 1.5KB of flash, 24 bytes of RAM
+ * per recorder, its stack usage per HAL call is a few bytes on top of the wrapped HAL's. Disabled by default, so that
+ * regular firmware builds do not contain it.
+ */
+#ifndef RENARD_PHY_S2LP_HAL_TRACE
+#define RENARD_PHY_S2LP_HAL_TRACE 0
+#endif
+
+#endif
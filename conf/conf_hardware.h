@@ -94,6 +94,25 @@
 #define DOWNLINK_FDEV_M                 67
 #define DOWNLINK_FDEV_E                 0
 
+/*
+ * Supply current table in nA, only used for energy accounting (RENARD_PHY_S2LP_ENERGY, see conf_driver.h)
+ * Current drawn by the whole radio section (S2-LP and, if present, FEM) in every state the driver puts it in.
+ * Defaults are typical S2-LP values at 3V from the datasheet ("Table 5. Power consumption"), SMPS on, TX at +14dBm.
+ * --> RESET: Time between releasing SDN and the end of the Power-On-Reset wait, S2-LP starts up
+ * --> IDLE: READY state, crystal oscillator running
+ * --> TX_*_BOOST: TX with the FEM's power amplifier, for RC profiles that do not bypass the FEM
+ * Measure your board with a power analyser if the estimate needs to be accurate!
+ */
+#define RENARD_PHY_S2LP_CURRENT_SHUTDOWN_NA         3
+#define RENARD_PHY_S2LP_CURRENT_RESET_NA            350000
+#define RENARD_PHY_S2LP_CURRENT_SLEEP_NA            600
+#define RENARD_PHY_S2LP_CURRENT_IDLE_NA             350000
+#define RENARD_PHY_S2LP_CURRENT_RX_NA               7000000
+#define RENARD_PHY_S2LP_CURRENT_TX_100BPS_NA        21000000
+#define RENARD_PHY_S2LP_CURRENT_TX_600BPS_NA        21000000
+#define RENARD_PHY_S2LP_CURRENT_TX_100BPS_BOOST_NA  21000000
+#define RENARD_PHY_S2LP_CURRENT_TX_600BPS_BOOST_NA  21000000
+
 #if defined(RENARD_PHY_S2LP_CONF_HT32SX)
 	#pragma message("[renard-phy-s2lp] Compiling for HT32SX")
 	#include "presets_hardware/ht32sx.h"
@@ -104,4 +123,31 @@
 	#pragma message("[renard-phy-s2lp] Compiling generic, no-frontend module (FEM) library")
 #endif
 
+/*
+ * Uplink waveform, see fifo_symbols.c for how the symbols are generated from it. All values are S2-LP PA power levels,
+ * higher levels mean lower output power. With FEM, levels are lowered by renard_phy_s2lp_fem_power_adjustment_by_rc.
+ * --> FLOOR: Level at full power, e.g. during '1' symbols
+ * --> PEAK: Level at the phase change of a '0' symbol
+ * --> SYMBOL_RAMP: Levels above FLOOR while power drops from full power to PEAK before the phase change of a '0'
+ *     symbol, at most 23 values. Power rises again along the same ramp after the phase change.
+ * --> FRAME_RAMP: Levels above FLOOR of the ramp-up before every frame, down to full power, at most 72 values. The
+ *     ramp-down after every frame is its mirror image.
+ * Presets may define their own waveform (all four values), defaults are the waveforms for operation without and with
+ * front-end module.
+ */
+#ifndef RENARD_PHY_S2LP_WAVEFORM_FLOOR
+#if (RENARD_PHY_S2LP_HAVE_FEM == 0)
+	#define RENARD_PHY_S2LP_WAVEFORM_FLOOR          1
+	#define RENARD_PHY_S2LP_WAVEFORM_PEAK           220
+	#define RENARD_PHY_S2LP_WAVEFORM_SYMBOL_RAMP    1, 1, 2, 3, 5, 7, 10, 14, 19, 23, 29, 38, 53
+#else
+	#define RENARD_PHY_S2LP_WAVEFORM_FLOOR          35
+	#define RENARD_PHY_S2LP_WAVEFORM_PEAK           220
+	#define RENARD_PHY_S2LP_WAVEFORM_SYMBOL_RAMP    1, 1, 2, 3, 5, 7, 10, 13, 18, 22, 26, 30, 43
+#endif
+	#define RENARD_PHY_S2LP_WAVEFORM_FRAME_RAMP     79, 69, 66, 59, 50, 44, 39, 34, 30, 25, 23, 21, 19, 17, 16, 15, \
+			14, 12, 12, 10, 10, 9, 9, 8, 8, 7, 7, 6, 6, 6, 6, 5, 5, 5, 5, 5, 4, 4, 4, 4, 4, 3, 3, 3, 3, 3, 3, 2, 2, 2, \
+			2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1
+#endif
+
 #endif
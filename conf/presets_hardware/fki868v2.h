@@ -26,3 +26,27 @@
 
 #define DOWNLINK_FDEV_M                 67
 #define DOWNLINK_FDEV_E                 0
+
+/*
+ * Supply current table in nA, see conf_hardware.h
+ * S2-LP only, typical datasheet values. The board's on-board 3.3V regulator and LEDs are not included.
+ */
+#undef RENARD_PHY_S2LP_CURRENT_SHUTDOWN_NA
+#undef RENARD_PHY_S2LP_CURRENT_RESET_NA
+#undef RENARD_PHY_S2LP_CURRENT_SLEEP_NA
+#undef RENARD_PHY_S2LP_CURRENT_IDLE_NA
+#undef RENARD_PHY_S2LP_CURRENT_RX_NA
+#undef RENARD_PHY_S2LP_CURRENT_TX_100BPS_NA
+#undef RENARD_PHY_S2LP_CURRENT_TX_600BPS_NA
+#undef RENARD_PHY_S2LP_CURRENT_TX_100BPS_BOOST_NA
+#undef RENARD_PHY_S2LP_CURRENT_TX_600BPS_BOOST_NA
+
+#define RENARD_PHY_S2LP_CURRENT_SHUTDOWN_NA         3
+#define RENARD_PHY_S2LP_CURRENT_RESET_NA            350000
+#define RENARD_PHY_S2LP_CURRENT_SLEEP_NA            600
+#define RENARD_PHY_S2LP_CURRENT_IDLE_NA             350000
+#define RENARD_PHY_S2LP_CURRENT_RX_NA               7000000
+#define RENARD_PHY_S2LP_CURRENT_TX_100BPS_NA        21000000
+#define RENARD_PHY_S2LP_CURRENT_TX_600BPS_NA        21000000
+#define RENARD_PHY_S2LP_CURRENT_TX_100BPS_BOOST_NA  21000000
+#define RENARD_PHY_S2LP_CURRENT_TX_600BPS_BOOST_NA  21000000
@@ -50,3 +50,29 @@
 
 #define DOWNLINK_FDEV_M                 67
 #define DOWNLINK_FDEV_E                 0
+
+/*
+ * Supply current table in nA, see conf_hardware.h
+ * S2-LP plus SKY66420-11: The FEM draws about 1uA while shut down, its LNA about 6mA in RX and its PA about 100mA when
+ * boosting the S2-LP's output (RC2). In bypass mode (RC1), the FEM's own current is negligible. Approximate values,
+ * the SoC's MCU is not included.
+ */
+#undef RENARD_PHY_S2LP_CURRENT_SHUTDOWN_NA
+#undef RENARD_PHY_S2LP_CURRENT_RESET_NA
+#undef RENARD_PHY_S2LP_CURRENT_SLEEP_NA
+#undef RENARD_PHY_S2LP_CURRENT_IDLE_NA
+#undef RENARD_PHY_S2LP_CURRENT_RX_NA
+#undef RENARD_PHY_S2LP_CURRENT_TX_100BPS_NA
+#undef RENARD_PHY_S2LP_CURRENT_TX_600BPS_NA
+#undef RENARD_PHY_S2LP_CURRENT_TX_100BPS_BOOST_NA
+#undef RENARD_PHY_S2LP_CURRENT_TX_600BPS_BOOST_NA
+
+#define RENARD_PHY_S2LP_CURRENT_SHUTDOWN_NA         1000
+#define RENARD_PHY_S2LP_CURRENT_RESET_NA            351000
+#define RENARD_PHY_S2LP_CURRENT_SLEEP_NA            1600
+#define RENARD_PHY_S2LP_CURRENT_IDLE_NA             351000
+#define RENARD_PHY_S2LP_CURRENT_RX_NA               13000000
+#define RENARD_PHY_S2LP_CURRENT_TX_100BPS_NA        21000000
+#define RENARD_PHY_S2LP_CURRENT_TX_600BPS_NA        21000000
+#define RENARD_PHY_S2LP_CURRENT_TX_100BPS_BOOST_NA  121000000
+#define RENARD_PHY_S2LP_CURRENT_TX_600BPS_BOOST_NA  121000000
@@ -0,0 +1,422 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "renard_phy_s2lp_hal.h"
+#include "renard_phy_s2lp.h"
+#include "renard_phy_s2lp_protocol.h"
+#include "renard_phy_s2lp_rc_profiles.h"
+#include "conf_hardware.h"
+#include "conf_driver.h"
+
+#include "renard_phy_s2lp_hal_emu.h"
+#include "s2lp_emu.h"
+
+/*
+ * bench - Benchmark suite for renard-phy-s2lp and renard-phy-s2lp-protocol
+ *
+ * Runs the driver against the emulator HAL and reports, per operation, RC profile and uplink datarate, the cost of
+ * one call: SPI transactions and bytes, interrupt waits, TX FIFO underruns, virtual (S2-LP) time and the S2-LP's charge
+ * consumption, which are all deterministic, as well as host CPU cycles spent in the driver itself (excluding HAL and
+ * emulator), taken from the fastest repetition so that preemption and interrupts on the host do not show up.
+ *
+ * Output is CSV, one line per benchmark. If a baseline file is given, every deterministic metric is compared
+ * against the baseline line with the same key (op, rc, datarate, fem, refill: symbol-wise or packed TX FIFO refills)
+ * and the benchmark fails if any of them got worse. Host CPU cycles are only compared if a tolerance in percent is
+ * given, since they depend on the host: The baseline has to be recorded on the same (reference) host, "make bench"
+ * uses a default tolerance.
+ * If an energy file is given, the time spent in and the charge drawn in every S2-LP power state are appended to it
+ * (energy budget), one line per benchmark and power state.
+ *
+ * Usage: bench [-b baseline.csv] [-t cycle_tolerance_percent] [-e energy.csv]
+ */
+
+#define BENCH_REPETITIONS 64
+#define BENCH_UPLINK_LENGTH 26
+#define BENCH_FREQUENCY 868130000
+
+#define BENCH_FIELDS "op,rc,datarate,fem,refill,spi_transactions,spi_bytes,interrupt_waits,tx_fifo_underruns," \
+		"virtual_us,charge_uc,cycles,cycles_per_symbol"
+#define BENCH_ENERGY_FIELDS "op,rc,datarate,fem,refill,state,time_us,charge_uc"
+
+static const char *BENCH_POWER_NAMES[S2LP_EMU_POWER_COUNT] = {
+	[S2LP_EMU_POWER_SHUTDOWN] = "shutdown",
+	[S2LP_EMU_POWER_STANDBY] = "standby",
+	[S2LP_EMU_POWER_SLEEP] = "sleep",
+	[S2LP_EMU_POWER_READY] = "ready",
+	[S2LP_EMU_POWER_LOCK] = "lock",
+	[S2LP_EMU_POWER_RX] = "rx",
+	[S2LP_EMU_POWER_TX] = "tx"
+};
+
+typedef struct
+{
+	char op[16];
+	char rc[4];
+	char datarate[8];
+	char fem[4];
+	char refill[8];
+
+	double spi_transactions;
+	double spi_bytes;
+	double interrupt_waits;
+	double tx_fifo_underruns;
+	double virtual_us;
+	double charge_uc;
+	double cycles;
+	double cycles_per_symbol;
+} bench_result_t;
+
+typedef struct
+{
+	renard_phy_s2lp_hal_emu_t hal;
+	renard_phy_s2lp_t phy;
+	renard_phy_s2lp_protocol_t protocol;
+
+	renard_phy_s2lp_rc_t rc_profile;
+	renard_phy_s2lp_ul_datarate_t datarate;
+	sfx_commoninfo common;
+} bench_ctx_t;
+
+typedef void (*bench_op_t)(bench_ctx_t *ctx);
+
+static bench_result_t *m_baseline;
+static size_t m_baseline_length;
+static double m_cycle_tolerance = -1;
+static FILE *m_energy;
+static unsigned int m_regressions;
+
+/**********************************************************************************************************************/
+
+/*
+ * Benchmarked operations
+ */
+static void bench_mode_tx(bench_ctx_t *ctx)
+{
+	renard_phy_s2lp_mode(&ctx->phy, S2LP_MODE_TX);
+}
+
+static void bench_mode_rx(bench_ctx_t *ctx)
+{
+	renard_phy_s2lp_mode(&ctx->phy, S2LP_MODE_RX);
+}
+
+static void bench_tx(bench_ctx_t *ctx)
+{
+	uint8_t stream[BENCH_UPLINK_LENGTH];
+	for (uint8_t i = 0; i < sizeof(stream); i++)
+		stream[i] = i * 37 + 0xaa;
+
+	renard_phy_s2lp_tx(&ctx->phy, stream, sizeof(stream), ctx->datarate, ctx->rc_profile);
+}
+
+static void bench_rx(bench_ctx_t *ctx)
+{
+	s2lp_emu_t *emu = renard_phy_s2lp_hal_emu(&ctx->hal);
+	s2lp_emu_rx_frame_t downlink = {emu->now + 10000000, 0, -110, 15, {0x12, 0x34, 0x56}, 0};
+	uint8_t frame[15];
+	int16_t rssi;
+
+	s2lp_emu_rx_schedule(emu, &downlink);
+	renard_phy_s2lp_interrupt_timeout(&ctx->phy, 100);
+	renard_phy_s2lp_rx(&ctx->phy, frame, &rssi);
+	renard_phy_s2lp_interrupt_clear(&ctx->phy);
+}
+
+/*
+ * Re-arm after an invalid candidate frame: prepare receives a (false) frame, run makes the S2-LP listen again. Its
+ * virtual time plus the ISR latency is the shortest gap between the end of a false frame and the SYNC word of the
+ * real downlink that still allows the downlink to be received. rx_rearm_full is the path without
+ * renard_phy_s2lp_rx_restart: stop reception, read the frame, start reception from scratch.
+ */
+static void bench_rearm_prepare(bench_ctx_t *ctx)
+{
+	s2lp_emu_t *emu = renard_phy_s2lp_hal_emu(&ctx->hal);
+	s2lp_emu_rx_frame_t candidate = {emu->now + 10000000, 0, -110, 15, {0xff}, 0};
+
+	renard_phy_s2lp_mode(&ctx->phy, S2LP_MODE_RX);
+	s2lp_emu_rx_schedule(emu, &candidate);
+	renard_phy_s2lp_interrupt_timeout(&ctx->phy, 100);
+	renard_phy_s2lp_rx_start(&ctx->phy);
+	renard_phy_s2lp_interrupt_wait(&ctx->phy);
+}
+
+static void bench_rearm(bench_ctx_t *ctx)
+{
+	uint8_t frame[15];
+	int16_t rssi;
+
+	renard_phy_s2lp_rx_read(&ctx->phy, frame, &rssi);
+	renard_phy_s2lp_rx_restart(&ctx->phy);
+}
+
+static void bench_rearm_full(bench_ctx_t *ctx)
+{
+	uint8_t frame[15];
+	int16_t rssi;
+
+	renard_phy_s2lp_rx_finish(&ctx->phy, true, frame, &rssi);
+	renard_phy_s2lp_rx_start(&ctx->phy);
+}
+
+static void bench_transfer(bench_ctx_t *ctx, bool request_downlink)
+{
+	sfx_ul_plain uplink;
+	sfx_dl_plain downlink;
+	int16_t rssi;
+
+	memset(&uplink, 0, sizeof(uplink));
+	uplink.msg[0] = 0x42;
+	uplink.msg[1] = ctx->common.seqnum;
+	uplink.msglen = 2;
+	uplink.replicas = true;
+	uplink.request_downlink = request_downlink;
+
+	/* Frame that fails CRC check half-way through the downlink window, the transfer then times out */
+	if (request_downlink) {
+		s2lp_emu_t *emu = renard_phy_s2lp_hal_emu(&ctx->hal);
+		s2lp_emu_rx_frame_t junk = {emu->now + 32000000000ULL, 0, -120, 15, {0x00}, 0};
+		s2lp_emu_rx_schedule(emu, &junk);
+	}
+
+	renard_phy_s2lp_protocol_transfer(&ctx->protocol, &ctx->common, &uplink, &downlink, ctx->rc_profile, ctx->datarate,
+			&rssi);
+	ctx->common.seqnum++;
+}
+
+static void bench_transfer_uplink(bench_ctx_t *ctx)
+{
+	bench_transfer(ctx, false);
+}
+
+static void bench_transfer_downlink(bench_ctx_t *ctx)
+{
+	bench_transfer(ctx, true);
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Measurement and baseline comparison
+ */
+static bool bench_parse(char *line, bench_result_t *result)
+{
+	memset(result, 0, sizeof(*result));
+
+	return sscanf(line, "%15[^,],%3[^,],%7[^,],%3[^,],%7[^,],%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf", result->op,
+			result->rc, result->datarate, result->fem, result->refill, &result->spi_transactions, &result->spi_bytes,
+			&result->interrupt_waits, &result->tx_fifo_underruns, &result->virtual_us, &result->charge_uc,
+			&result->cycles, &result->cycles_per_symbol) == 13;
+}
+
+static bool bench_load_baseline(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+		return false;
+
+	char line[256];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		bench_result_t result;
+		if (line[0] == '#' || !bench_parse(line, &result))
+			continue;
+
+		bench_result_t *baseline = realloc(m_baseline, (m_baseline_length + 1) * sizeof(bench_result_t));
+		if (baseline == NULL)
+			break;
+
+		m_baseline = baseline;
+		m_baseline[m_baseline_length++] = result;
+	}
+
+	fclose(file);
+	return true;
+}
+
+static void bench_check(const bench_result_t *result, const char *metric, double value, double baseline,
+		double tolerance)
+{
+	/* Allow for rounding of printed values */
+	if (value > baseline * (1 + tolerance / 100) + 0.05) {
+		fprintf(stderr, "bench: REGRESSION %s rc=%s datarate=%s fem=%s refill=%s: %s %.1f > baseline %.1f\n",
+				result->op, result->rc, result->datarate, result->fem, result->refill, metric, value, baseline);
+		m_regressions++;
+	}
+}
+
+static void bench_compare(const bench_result_t *result)
+{
+	for (size_t i = 0; i < m_baseline_length; i++) {
+		const bench_result_t *b = &m_baseline[i];
+		if (strcmp(b->op, result->op) != 0 || strcmp(b->rc, result->rc) != 0 ||
+				strcmp(b->datarate, result->datarate) != 0 || strcmp(b->fem, result->fem) != 0 ||
+				strcmp(b->refill, result->refill) != 0)
+			continue;
+
+		bench_check(result, "spi_transactions", result->spi_transactions, b->spi_transactions, 0);
+		bench_check(result, "spi_bytes", result->spi_bytes, b->spi_bytes, 0);
+		bench_check(result, "interrupt_waits", result->interrupt_waits, b->interrupt_waits, 0);
+		bench_check(result, "tx_fifo_underruns", result->tx_fifo_underruns, b->tx_fifo_underruns, 0);
+		bench_check(result, "virtual_us", result->virtual_us, b->virtual_us, 0);
+		bench_check(result, "charge_uc", result->charge_uc, b->charge_uc, 0);
+		if (m_cycle_tolerance >= 0)
+			bench_check(result, "cycles", result->cycles, b->cycles, m_cycle_tolerance);
+		return;
+	}
+}
+
+/*
+ * Run op once to warm up (mode switches, caches), then BENCH_REPETITIONS times. Before every call, prepare (if not
+ * NULL) brings the driver into the state that op expects, its cost is not included. per_profile tells whether op
+ * depends on RC profile and datarate, symbols is the number of uplink symbols that op transmits (cycles per symbol).
+ */
+static void bench_run(const char *op, bench_op_t prepare, bench_op_t run, bench_ctx_t *ctx, bool per_profile,
+		uint32_t symbols)
+{
+	s2lp_emu_t *emu = renard_phy_s2lp_hal_emu(&ctx->hal);
+	const renard_phy_s2lp_hal_emu_stats_t *hal_stats = renard_phy_s2lp_hal_emu_stats(&ctx->hal);
+	uint64_t spi_transactions = 0, spi_bytes = 0, interrupt_waits = 0, tx_fifo_underruns = 0, virtual_ns = 0;
+	uint64_t cycles = UINT64_MAX, state_ns[S2LP_EMU_POWER_COUNT] = {0};
+	double charge[S2LP_EMU_POWER_COUNT] = {0};
+
+	for (uint32_t i = 0; i <= BENCH_REPETITIONS; i++) {
+		if (prepare != NULL)
+			prepare(ctx);
+
+		renard_phy_s2lp_hal_emu_stats_reset(&ctx->hal);
+		uint64_t now = emu->now;
+		uint64_t start = renard_phy_s2lp_hal_emu_cycles();
+
+		run(ctx);
+
+		uint64_t end = renard_phy_s2lp_hal_emu_cycles();
+		if (i == 0)
+			continue;
+
+		spi_transactions += emu->stats.spi_transactions;
+		spi_bytes += emu->stats.spi_bytes;
+		interrupt_waits += hal_stats->interrupt_waits;
+		tx_fifo_underruns += emu->stats.tx_fifo_underruns;
+		virtual_ns += emu->now - now;
+		if (end - start - hal_stats->hal_cycles < cycles)
+			cycles = end - start - hal_stats->hal_cycles;
+
+		for (uint8_t power = 0; power < S2LP_EMU_POWER_COUNT; power++) {
+			state_ns[power] += emu->stats.state_ns[power];
+			charge[power] += s2lp_emu_charge(emu, power);
+		}
+	}
+
+	bench_result_t result;
+	memset(&result, 0, sizeof(result));
+	snprintf(result.op, sizeof(result.op), "%s", op);
+	snprintf(result.rc, sizeof(result.rc), "%s", per_profile ? (ctx->rc_profile == PROFILE_RC1 ? "1" : "2") : "-");
+	snprintf(result.datarate, sizeof(result.datarate), "%s",
+			!per_profile ? "-" : ctx->datarate == UL_DATARATE_600BPS ? "600" : "100");
+	snprintf(result.fem, sizeof(result.fem), "%d", RENARD_PHY_S2LP_HAVE_FEM);
+	snprintf(result.refill, sizeof(result.refill), "%s", RENARD_PHY_S2LP_TX_PACKED_REFILL == 1 ? "packed" : "symbol");
+	result.spi_transactions = (double)spi_transactions / BENCH_REPETITIONS;
+	result.spi_bytes = (double)spi_bytes / BENCH_REPETITIONS;
+	result.interrupt_waits = (double)interrupt_waits / BENCH_REPETITIONS;
+	result.tx_fifo_underruns = (double)tx_fifo_underruns / BENCH_REPETITIONS;
+	result.virtual_us = (double)virtual_ns / 1000 / BENCH_REPETITIONS;
+	for (uint8_t power = 0; power < S2LP_EMU_POWER_COUNT; power++)
+		result.charge_uc += charge[power] / BENCH_REPETITIONS;
+	result.cycles = (double)cycles;
+	result.cycles_per_symbol = symbols == 0 ? 0 : result.cycles / symbols;
+
+	printf("%s,%s,%s,%s,%s,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.0f,%.1f\n", result.op, result.rc, result.datarate,
+			result.fem, result.refill, result.spi_transactions, result.spi_bytes, result.interrupt_waits,
+			result.tx_fifo_underruns, result.virtual_us, result.charge_uc, result.cycles, result.cycles_per_symbol);
+
+	for (uint8_t power = 0; m_energy != NULL && power < S2LP_EMU_POWER_COUNT; power++) {
+		fprintf(m_energy, "%s,%s,%s,%s,%s,%s,%.1f,%.3f\n", result.op, result.rc, result.datarate, result.fem,
+				result.refill, BENCH_POWER_NAMES[power], (double)state_ns[power] / 1000 / BENCH_REPETITIONS,
+				charge[power] / BENCH_REPETITIONS);
+	}
+
+	bench_compare(&result);
+}
+
+/**********************************************************************************************************************/
+
+int main(int argc, char **argv)
+{
+	const char *baseline = NULL;
+	const char *energy = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			baseline = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			m_cycle_tolerance = strtod(argv[++i], NULL);
+		} else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+			energy = argv[++i];
+		} else {
+			fprintf(stderr, "Usage: bench [-b baseline.csv] [-t cycle_tolerance_percent] [-e energy.csv]\n");
+			return 1;
+		}
+	}
+
+	if (baseline != NULL && !bench_load_baseline(baseline)) {
+		fprintf(stderr, "bench: cannot read baseline %s\n", baseline);
+		return 1;
+	}
+
+	/* Appended to, so that the results of several bench builds can be collected in one file */
+	if (energy != NULL) {
+		m_energy = fopen(energy, "a");
+		if (m_energy == NULL) {
+			fprintf(stderr, "bench: cannot write energy budget %s\n", energy);
+			return 1;
+		}
+
+		if (ftell(m_energy) == 0)
+			fprintf(m_energy, "# " BENCH_ENERGY_FIELDS "\n");
+	}
+
+	static bench_ctx_t ctx;
+	ctx.common.devid = 0x0012abcd;
+
+	renard_phy_s2lp_hal_emu_configure(&ctx.hal, NULL);
+	if (!renard_phy_s2lp_init(&ctx.phy, &renard_phy_s2lp_hal_emu_functions, &ctx.hal)) {
+		fprintf(stderr, "bench: renard_phy_s2lp_init failed\n");
+		return 1;
+	}
+	renard_phy_s2lp_protocol_init(&ctx.protocol, &ctx.phy, 0x1234);
+
+	printf("# " BENCH_FIELDS "\n");
+
+	/* Warm mode switches, frequency is retained */
+	renard_phy_s2lp_frequency(&ctx.phy, BENCH_FREQUENCY);
+	bench_run("mode_tx", bench_mode_rx, bench_mode_tx, &ctx, false, 0);
+	bench_run("mode_rx", bench_mode_tx, bench_mode_rx, &ctx, false, 0);
+	bench_run("rx", bench_mode_rx, bench_rx, &ctx, false, 0);
+	bench_run("rx_rearm", bench_rearm_prepare, bench_rearm, &ctx, false, 0);
+	bench_run("rx_rearm_full", bench_rearm_prepare, bench_rearm_full, &ctx, false, 0);
+
+	for (ctx.rc_profile = PROFILE_RC1; ctx.rc_profile <= PROFILE_RC2; ctx.rc_profile++) {
+		for (ctx.datarate = UL_DATARATE_100BPS; ctx.datarate <= UL_DATARATE_600BPS; ctx.datarate++) {
+			if (!renard_phy_s2lp_baudrates_allowed_by_rc[ctx.rc_profile][ctx.datarate])
+				continue;
+
+			bench_run("tx", bench_mode_tx, bench_tx, &ctx, true, BENCH_UPLINK_LENGTH * 8);
+			bench_run("transfer_ul", NULL, bench_transfer_uplink, &ctx, true, 0);
+			bench_run("transfer_dl", NULL, bench_transfer_downlink, &ctx, true, 0);
+		}
+	}
+
+	renard_phy_s2lp_stop(&ctx.phy);
+	free(m_baseline);
+	if (m_energy != NULL)
+		fclose(m_energy);
+
+	if (m_regressions > 0) {
+		fprintf(stderr, "bench: %u regression(s) against %s\n", m_regressions, baseline);
+		return 1;
+	}
+
+	return 0;
+}
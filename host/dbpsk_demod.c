@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "dbpsk_demod.h"
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define DBPSK_DEMOD_VECTOR 1
+#else
+#define DBPSK_DEMOD_VECTOR 0
+#endif
+
+/* Phase changes of at least 90° count as 180° phase change, more than 45° away from 0° / 180° is ambiguous */
+#define DBPSK_DEMOD_FLIP 64
+#define DBPSK_DEMOD_AMBIGUOUS_MIN 32
+#define DBPSK_DEMOD_AMBIGUOUS_MAX 96
+
+/**********************************************************************************************************************/
+
+/*
+ * Scalar kernels:
+ * dbpsk_demod_phase_scalar: Phase change over one symbol starting at the given byte couple, in units of 180° / 128
+ * dbpsk_demod_sync_scalar: Index of the first byte couple that changes the phase by at least 90°, count if none
+ */
+static int32_t dbpsk_demod_phase_scalar(const uint8_t *couples)
+{
+	int32_t phase = 0;
+	for (uint32_t i = 0; i < DBPSK_DEMOD_SYMBOL_COUPLES; i++)
+		phase += (int8_t)couples[2 * i];
+
+	return phase;
+}
+
+static uint32_t dbpsk_demod_sync_scalar(const uint8_t *couples, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		int8_t frequency = couples[2 * i];
+		if (frequency >= DBPSK_DEMOD_FLIP || frequency <= -DBPSK_DEMOD_FLIP)
+			return i;
+	}
+
+	return count;
+}
+
+#if (DBPSK_DEMOD_VECTOR == 1)
+
+/*
+ * Vector kernels: Same as above, but eight byte couples at a time. Every 16 bit lane holds one byte couple, with the
+ * frequency byte in the lower half on little endian hosts. Shifting it up and back down sign-extends it.
+ */
+typedef int16_t dbpsk_demod_v8hi_t __attribute__((vector_size(16)));
+typedef uint16_t dbpsk_demod_v8hu_t __attribute__((vector_size(16)));
+
+#define DBPSK_DEMOD_LANES 8
+
+static inline dbpsk_demod_v8hi_t dbpsk_demod_frequencies(const uint8_t *couples)
+{
+	dbpsk_demod_v8hu_t lanes;
+	memcpy(&lanes, couples, sizeof(lanes));
+
+	return (dbpsk_demod_v8hi_t)(lanes << 8) >> 8;
+}
+
+static int32_t dbpsk_demod_phase_vector(const uint8_t *couples)
+{
+	/* At most 5 * 128 per lane, no overflow */
+	dbpsk_demod_v8hi_t sum = dbpsk_demod_frequencies(couples);
+	for (uint32_t i = DBPSK_DEMOD_LANES; i < DBPSK_DEMOD_SYMBOL_COUPLES; i += DBPSK_DEMOD_LANES)
+		sum += dbpsk_demod_frequencies(&couples[2 * i]);
+
+	int32_t phase = 0;
+	for (uint32_t lane = 0; lane < DBPSK_DEMOD_LANES; lane++)
+		phase += sum[lane];
+
+	return phase;
+}
+
+static uint32_t dbpsk_demod_sync_vector(const uint8_t *couples, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + DBPSK_DEMOD_LANES <= count; i += DBPSK_DEMOD_LANES) {
+		dbpsk_demod_v8hi_t frequencies = dbpsk_demod_frequencies(&couples[2 * i]);
+		dbpsk_demod_v8hi_t flips = (frequencies >= DBPSK_DEMOD_FLIP) | (frequencies <= -DBPSK_DEMOD_FLIP);
+
+		uint64_t any[2];
+		memcpy(any, &flips, sizeof(any));
+		if ((any[0] | any[1]) != 0)
+			break;
+	}
+
+	return i + dbpsk_demod_sync_scalar(&couples[2 * i], count - i);
+}
+
+#endif
+
+/**********************************************************************************************************************/
+
+/*
+ * Demodulator, specialized for scalar or vector kernels by the compiler since vector is always a constant
+ */
+static inline bool dbpsk_demod_run(const uint8_t *couples, uint32_t count, uint8_t *bits, uint32_t size,
+		dbpsk_demod_result_t *result, bool vector)
+{
+	memset(result, 0, sizeof(*result));
+	memset(bits, 0, size);
+
+#if (DBPSK_DEMOD_VECTOR == 1)
+	result->sync = vector ? dbpsk_demod_sync_vector(couples, count) : dbpsk_demod_sync_scalar(couples, count);
+#else
+	(void)vector;
+	result->sync = dbpsk_demod_sync_scalar(couples, count);
+#endif
+
+	/* First phase change is halfway through the second preamble bit, go back one and a half symbols */
+	if (result->sync == count || result->sync < DBPSK_DEMOD_SYMBOL_COUPLES * 3 / 2)
+		return false;
+
+	uint32_t start = result->sync - DBPSK_DEMOD_SYMBOL_COUPLES * 3 / 2;
+	for (; start + DBPSK_DEMOD_SYMBOL_COUPLES <= count && result->bits < size * 8;
+			start += DBPSK_DEMOD_SYMBOL_COUPLES) {
+#if (DBPSK_DEMOD_VECTOR == 1)
+		int32_t phase = vector ? dbpsk_demod_phase_vector(&couples[2 * start]) :
+				dbpsk_demod_phase_scalar(&couples[2 * start]);
+#else
+		int32_t phase = dbpsk_demod_phase_scalar(&couples[2 * start]);
+#endif
+
+		/* Wrap phase change to -180°..180° */
+		int32_t change = (int32_t)(((uint32_t)phase + 128) & 0xff) - 128;
+		int32_t magnitude = change < 0 ? -change : change;
+
+		if (magnitude > DBPSK_DEMOD_AMBIGUOUS_MIN && magnitude < DBPSK_DEMOD_AMBIGUOUS_MAX)
+			result->ambiguous++;
+
+		if (magnitude < DBPSK_DEMOD_FLIP)
+			bits[result->bits / 8] |= 0x80 >> (result->bits % 8);
+
+		result->bits++;
+	}
+
+	return true;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Public interface
+ */
+bool dbpsk_demod(const uint8_t *couples, uint32_t count, uint8_t *bits, uint32_t size, dbpsk_demod_result_t *result)
+{
+	return dbpsk_demod_run(couples, count, bits, size, result, DBPSK_DEMOD_VECTOR == 1);
+}
+
+bool dbpsk_demod_scalar(const uint8_t *couples, uint32_t count, uint8_t *bits, uint32_t size,
+		dbpsk_demod_result_t *result)
+{
+	return dbpsk_demod_run(couples, count, bits, size, result, false);
+}
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * dbpsk-demod - Host-side DBPSK demodulator for S2-LP direct polar mode byte couple streams
+ *
+ * Recovers the bits of a Sigfox uplink from the byte couples (frequency, power) that the S2-LP's modulator transmits,
+ * e.g. as captured by s2lp-emu. It only relies on the physics of the waveform and on Sigfox framing, not on the symbol
+ * tables or the bit sequencing of renard-phy-s2lp, so that it can serve as an independent reference for both:
+ * --> The carrier phase is integrated from the signed frequency bytes. At the frequency deviation that renard-phy-s2lp
+ *     configures, a frequency byte of +/-128 shifts the phase by +/-180° within one byte couple period, so phase is
+ *     measured in units of 180° / 128 and wraps around at 256.
+ * --> Symbol timing is recovered from the first phase change in the stream, which is the second bit of the Sigfox
+ *     preamble (0xaaaaa). Symbols are DBPSK_DEMOD_SYMBOL_COUPLES long, the phase is sampled halfway between two phase
+ *     changes, where the signal is steady.
+ * --> Every symbol whose phase differs by about 180° from the previous one is a binary '0', every symbol with about the
+ *     same phase is a binary '1'.
+ * Bits are packed MSB first, the first bit is the first bit of the preamble. The ramp-down after the frame has a
+ * steady phase, so a frame of n bytes decodes to n * 8 bits followed by a few '1' bits.
+ *
+ * dbpsk_demod integrates phase with GCC vector extensions (SSE2 / NEON / ... depending on the host), eight byte
+ * couples at a time. dbpsk_demod_scalar is a plain C implementation of the same algorithm that dbpsk_demod falls back
+ * to on other compilers and big endian hosts. Both produce exactly the same results.
+ */
+
+#ifndef _DBPSK_DEMOD_H
+#define _DBPSK_DEMOD_H
+
+#define DBPSK_DEMOD_SYMBOL_COUPLES 40
+
+typedef struct
+{
+	/* Number of bits written to the output buffer */
+	uint32_t bits;
+
+	/* Byte couple index of the first phase change */
+	uint32_t sync;
+
+	/* Symbols with a phase difference that is neither close to 0° nor to 180° (more than 45° off) */
+	uint32_t ambiguous;
+} dbpsk_demod_result_t;
+
+/*
+ * Demodulate count byte couples (2 * count bytes) into a buffer of size bytes. Returns false if the stream contains
+ * no phase change or not enough byte couples before the first one for the first preamble bit.
+ */
+bool dbpsk_demod(const uint8_t *couples, uint32_t count, uint8_t *bits, uint32_t size, dbpsk_demod_result_t *result);
+bool dbpsk_demod_scalar(const uint8_t *couples, uint32_t count, uint8_t *bits, uint32_t size,
+		dbpsk_demod_result_t *result);
+
+#endif
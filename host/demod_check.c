@@ -0,0 +1,355 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "renard_phy_s2lp_hal.h"
+#include "renard_phy_s2lp.h"
+#include "renard_phy_s2lp_protocol.h"
+#include "renard_phy_s2lp_rc_profiles.h"
+#include "fifo_symbols.h"
+
+#include "renard_phy_s2lp_hal_emu.h"
+#include "s2lp_emu.h"
+#include "dbpsk_demod.h"
+
+/*
+ * demod-check - End-to-end check of renard-phy-s2lp uplinks against an independent DBPSK demodulator
+ *
+ * Sends randomized uplinks (payload, length, single bit, replicas, RC profile, uplink datarate) through
+ * renard_phy_s2lp_protocol_transfer against the emulator HAL, captures the modulator output of every frame and
+ * demodulates it with dbpsk-demod. A frame passes if it decodes to the Sigfox preamble followed by the frame that
+ * librenard's sfx_uplink_encode produced for it, with nothing but steady phase after it, no ambiguous symbols and the
+ * same result from the vector and the scalar demodulator. This covers the symbol waveforms in fifo_symbols.c, the bit
+ * sequencing of the driver and the nibble packing of the protocol layer.
+ *
+ * With -k, demod-check also measures demodulator throughput on randomized frames that are synthesized straight from
+ * the symbol waveforms, without the driver and the emulator, once with the vector and once with the scalar kernel.
+ *
+ * Usage: demod-check [-n transfers] [-k frames] [-s seed]
+ * Exits with status 1 if any frame fails the check.
+ */
+
+#define DEMOD_CHECK_MAX_PAYLOAD 12
+
+/* Byte couples of the longest possible frame: preamble and frame bits plus ramp-up and ramp-down (4 symbols at most) */
+#define DEMOD_CHECK_MAX_COUPLES ((SFX_UL_MAX_FRAMELEN * 8 + 4) * FIFO_SYMBOL_LENGTH / 2)
+
+/* Number of different frames synthesized for the throughput measurement */
+#define DEMOD_CHECK_POOL 256
+
+static uint8_t m_capture_buffer[3 * 2 * DEMOD_CHECK_MAX_COUPLES];
+static s2lp_emu_capture_t m_capture = {m_capture_buffer, sizeof(m_capture_buffer), 0, {0}, {0}, {0}, {0}, 0};
+
+static uint32_t m_random = 0x5eed;
+static renard_phy_s2lp_hal_emu_t m_hal;
+static renard_phy_s2lp_t m_phy;
+static renard_phy_s2lp_protocol_t m_protocol;
+
+/**********************************************************************************************************************/
+
+static uint32_t demod_check_random(uint32_t min, uint32_t max)
+{
+	m_random = m_random * 1103515245 + 12345;
+	return min + (m_random >> 8) % (max - min + 1);
+}
+
+static double demod_check_seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void demod_check_hex(const char *label, const uint8_t *data, uint32_t length)
+{
+	fprintf(stderr, "  %-9s", label);
+	for (uint32_t i = 0; i < length; i++)
+		fprintf(stderr, "%02x", data[i]);
+	fprintf(stderr, "\n");
+}
+
+/*
+ * Demodulate count byte couples with both demodulators and compare the bits to the expected bytestream. Returns NULL
+ * if the frame passes, a description of the first problem otherwise. bits receives the demodulated bits.
+ */
+static const char *demod_check_stream(const uint8_t *couples, uint32_t count, const uint8_t *expected, uint8_t length,
+		uint8_t *bits, uint32_t size, uint32_t *decoded)
+{
+	dbpsk_demod_result_t result;
+	dbpsk_demod_result_t result_scalar;
+	uint8_t bits_scalar[SFX_UL_MAX_FRAMELEN + 4];
+
+	bool ok = dbpsk_demod(couples, count, bits, size, &result);
+	bool ok_scalar = dbpsk_demod_scalar(couples, count, bits_scalar, sizeof(bits_scalar), &result_scalar);
+	*decoded = result.bits;
+
+	if (!ok)
+		return "no preamble";
+
+	if (!ok_scalar || memcmp(&result, &result_scalar, sizeof(result)) != 0 ||
+			memcmp(bits, bits_scalar, (result.bits + 7) / 8) != 0)
+		return "vector and scalar demodulator disagree";
+
+	if (result.ambiguous > 0)
+		return "ambiguous symbols";
+
+	if (result.bits / 8 != length)
+		return "wrong frame length";
+
+	if (memcmp(bits, expected, length) != 0)
+		return "wrong frame content";
+
+	for (uint32_t bit = length * 8; bit < result.bits; bit++) {
+		if ((bits[bit / 8] & (0x80 >> (bit % 8))) == 0)
+			return "phase change after frame";
+	}
+
+	return NULL;
+}
+
+/*
+ * Expected bytestream of an uplink frame: Sigfox preamble (5 nibbles 0xa), then the frame's nibbles, most significant
+ * nibble first. Returns its length in bytes, a trailing half byte is not transmitted.
+ */
+static uint8_t demod_check_bytestream(const uint8_t *frame, uint8_t nibbles, uint8_t *bytestream)
+{
+	uint8_t length = (nibbles + 5) / 2;
+
+	memset(bytestream, 0, length);
+	for (uint8_t i = 0; i < 2 * length; i++) {
+		uint8_t nibble = i < 5 ? 0xa : (frame[(i - 5) / 2] >> ((i - 5) % 2 == 0 ? 4 : 0)) & 0x0f;
+		bytestream[i / 2] |= i % 2 == 0 ? nibble << 4 : nibble;
+	}
+
+	return length;
+}
+
+/*
+ * Send one randomized uplink and check all of its frames, returns the number of frames that failed
+ */
+static uint32_t demod_check_transfer(uint32_t index, renard_phy_s2lp_rc_t rc_profile,
+		renard_phy_s2lp_ul_datarate_t datarate, sfx_commoninfo *common, uint32_t *frames)
+{
+	sfx_ul_plain uplink;
+	sfx_dl_plain downlink;
+	sfx_ul_encoded encoded;
+	int16_t rssi;
+	uint32_t failed = 0;
+
+	memset(&uplink, 0, sizeof(uplink));
+	uplink.msglen = demod_check_random(0, DEMOD_CHECK_MAX_PAYLOAD);
+	for (uint8_t i = 0; i < uplink.msglen; i++)
+		uplink.msg[i] = demod_check_random(0, 0xff);
+	uplink.singlebit = uplink.msglen == 0 && demod_check_random(0, 1) == 1;
+	uplink.replicas = demod_check_random(0, 1) == 1;
+	uplink.request_downlink = false;
+
+	sfx_uplink_encode(uplink, *common, &encoded);
+
+	m_capture.length = 0;
+	m_capture.bursts = 0;
+	renard_phy_s2lp_protocol_transfer(&m_protocol, common, &uplink, &downlink, rc_profile, datarate, &rssi);
+	common->seqnum++;
+
+	uint8_t framecount = uplink.replicas ? 3 : 1;
+	if (m_capture.bursts != framecount) {
+		fprintf(stderr, "demod-check: transfer %u: %u frame(s) transmitted, expected %u\n", index, m_capture.bursts,
+				framecount);
+		return framecount;
+	}
+
+	for (uint8_t f = 0; f < framecount; f++) {
+		uint32_t start = m_capture.burst_start[f];
+		uint32_t end = f + 1 < m_capture.bursts ? m_capture.burst_start[f + 1] : m_capture.length;
+		uint8_t expected[SFX_UL_MAX_FRAMELEN + 4];
+		uint8_t bits[SFX_UL_MAX_FRAMELEN + 4];
+		uint32_t decoded;
+
+		uint8_t length = demod_check_bytestream(encoded.frame[f], encoded.framelen_nibbles, expected);
+		const char *error = demod_check_stream(&m_capture.buffer[start], (end - start) / 2, expected, length, bits,
+				sizeof(bits), &decoded);
+
+		(*frames)++;
+		if (error != NULL) {
+			fprintf(stderr, "demod-check: transfer %u, RC%u, %ubps, %u byte payload, frame %u: %s\n", index,
+					rc_profile + 1, datarate == UL_DATARATE_600BPS ? 600 : 100, uplink.msglen, f, error);
+			demod_check_hex("expected", expected, length);
+			demod_check_hex("decoded", bits, (decoded + 7) / 8 > sizeof(bits) ? sizeof(bits) : (decoded + 7) / 8);
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+/*
+ * Synthesize the byte couples of a frame with the given bytestream from the symbol waveforms, returns their number.
+ * Phase changes alternate between negative and positive frequency deviation like in renard_phy_s2lp_tx.
+ */
+static uint32_t demod_check_synthesize(const uint8_t *bytestream, uint8_t length, uint8_t *couples)
+{
+	uint32_t offset = 0;
+
+#define DEMOD_CHECK_SYMBOL(symbol) do { \
+		uint8_t symbol_length = FIFO_SYMBOL_LENGTHS[symbol] - FIFO_CMD_LENGTH; \
+		fifo_symbol_expand(symbol, 0, FIFO_CMD_LENGTH, symbol_length, &couples[offset]); \
+		offset += symbol_length; \
+	} while (0)
+
+	DEMOD_CHECK_SYMBOL(FIFO_SYMBOL_BEFOREFRAME_1);
+	DEMOD_CHECK_SYMBOL(FIFO_SYMBOL_BEFOREFRAME_2);
+	for (uint32_t bit = 0; bit < length * 8u; bit++) {
+		uint8_t bit_index = 7 - bit % 8;
+		if ((bytestream[bit / 8] >> bit_index) & 0x01)
+			DEMOD_CHECK_SYMBOL(FIFO_SYMBOL_ONE);
+		else if (bit_index % 2 == 0)
+			DEMOD_CHECK_SYMBOL(FIFO_SYMBOL_ZERO_FDEV_NEG);
+		else
+			DEMOD_CHECK_SYMBOL(FIFO_SYMBOL_ZERO_FDEV_POS);
+	}
+	DEMOD_CHECK_SYMBOL(FIFO_SYMBOL_AFTERFRAME_1);
+	DEMOD_CHECK_SYMBOL(FIFO_SYMBOL_AFTERFRAME_2);
+
+#undef DEMOD_CHECK_SYMBOL
+
+	return offset / 2;
+}
+
+/*
+ * Throughput measurement: DEMOD_CHECK_POOL randomized frames, synthesized once and demodulated round-robin
+ */
+typedef struct
+{
+	uint8_t couples[2 * DEMOD_CHECK_MAX_COUPLES];
+	uint32_t count;
+	uint8_t bytestream[SFX_UL_MAX_FRAMELEN];
+	uint8_t length;
+} demod_check_frame_t;
+
+typedef bool (*demod_check_demod_t)(const uint8_t *couples, uint32_t count, uint8_t *bits, uint32_t size,
+		dbpsk_demod_result_t *result);
+
+/*
+ * Demodulate the given number of frames from the pool, print throughput. Returns the number of wrongly decoded frames.
+ */
+static uint32_t demod_check_kernel(const char *name, demod_check_demod_t demod, const demod_check_frame_t *pool,
+		uint32_t frames)
+{
+	uint64_t bits = 0;
+	uint32_t failed = 0;
+
+	double start = demod_check_seconds();
+	for (uint32_t i = 0; i < frames; i++) {
+		const demod_check_frame_t *frame = &pool[i % DEMOD_CHECK_POOL];
+		uint8_t decoded[SFX_UL_MAX_FRAMELEN + 4];
+		dbpsk_demod_result_t result;
+
+		if (!demod(frame->couples, frame->count, decoded, sizeof(decoded), &result) ||
+				result.bits / 8 != frame->length || memcmp(decoded, frame->bytestream, frame->length) != 0)
+			failed++;
+		bits += result.bits;
+	}
+	double seconds = demod_check_seconds() - start;
+
+	printf("%s,%u,%llu,%.3f,%.0f,%u\n", name, frames, (unsigned long long)bits, seconds,
+			seconds > 0 ? frames * 60 / seconds : 0, failed);
+
+	return failed;
+}
+
+static uint32_t demod_check_throughput(uint32_t frames)
+{
+	demod_check_frame_t *pool = malloc(DEMOD_CHECK_POOL * sizeof(demod_check_frame_t));
+	if (pool == NULL) {
+		fprintf(stderr, "demod-check: out of memory\n");
+		return frames;
+	}
+
+	for (uint32_t i = 0; i < DEMOD_CHECK_POOL; i++) {
+		demod_check_frame_t *frame = &pool[i];
+
+		frame->length = demod_check_random(8, SFX_UL_MAX_FRAMELEN);
+		for (uint8_t j = 0; j < frame->length; j++)
+			frame->bytestream[j] = demod_check_random(0, 0xff);
+		frame->bytestream[0] = 0xaa;
+		frame->bytestream[1] = 0xaa;
+		frame->bytestream[2] = 0xa0 | (frame->bytestream[2] & 0x0f);
+		frame->count = demod_check_synthesize(frame->bytestream, frame->length, frame->couples);
+	}
+
+	printf("# kernel,frames,bits,seconds,frames_per_minute,failed\n");
+	uint32_t failed = demod_check_kernel("vector", dbpsk_demod, pool, frames);
+	failed += demod_check_kernel("scalar", dbpsk_demod_scalar, pool, frames);
+
+	free(pool);
+	return failed;
+}
+
+/**********************************************************************************************************************/
+
+static void demod_check_usage(void)
+{
+	fprintf(stderr, "Usage: demod-check [-n transfers] [-k frames] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t transfers = 200;
+	uint32_t kernel_frames = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:k:s:h")) != -1) {
+		switch (opt) {
+			case 'n': transfers = strtoul(optarg, NULL, 0); break;
+			case 'k': kernel_frames = strtoul(optarg, NULL, 0); break;
+			case 's': m_random = strtoul(optarg, NULL, 0); break;
+			default: demod_check_usage(); return 1;
+		}
+	}
+
+	if (optind != argc) {
+		demod_check_usage();
+		return 1;
+	}
+
+	renard_phy_s2lp_hal_emu_configure(&m_hal, NULL);
+	if (!renard_phy_s2lp_init(&m_phy, &renard_phy_s2lp_hal_emu_functions, &m_hal)) {
+		fprintf(stderr, "demod-check: renard_phy_s2lp_init failed\n");
+		return 1;
+	}
+	renard_phy_s2lp_protocol_init(&m_protocol, &m_phy, 0x1234);
+	renard_phy_s2lp_hal_emu(&m_hal)->tx_capture = &m_capture;
+
+	sfx_commoninfo common;
+	memset(&common, 0, sizeof(common));
+	common.devid = 0x0012abcd;
+
+	uint32_t frames = 0;
+	uint32_t failed = 0;
+	for (uint32_t i = 0; i < transfers; i++) {
+		renard_phy_s2lp_rc_t rc_profile = demod_check_random(PROFILE_RC1, PROFILE_RC2);
+		renard_phy_s2lp_ul_datarate_t datarate = demod_check_random(UL_DATARATE_100BPS, UL_DATARATE_600BPS);
+		if (!renard_phy_s2lp_baudrates_allowed_by_rc[rc_profile][datarate])
+			datarate = datarate == UL_DATARATE_100BPS ? UL_DATARATE_600BPS : UL_DATARATE_100BPS;
+
+		common.devid = demod_check_random(0, 0xffffff);
+		for (uint8_t k = 0; k < sizeof(common.key); k++)
+			common.key[k] = demod_check_random(0, 0xff);
+
+		failed += demod_check_transfer(i, rc_profile, datarate, &common, &frames);
+	}
+
+	renard_phy_s2lp_stop(&m_phy);
+	printf("demod-check: %u transfer(s), %u frame(s), %u failed\n", transfers, frames, failed);
+
+	if (kernel_frames > 0)
+		failed += demod_check_throughput(kernel_frames);
+
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,616 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "renard_phy_s2lp.h"
+#include "renard_phy_s2lp_protocol.h"
+#include "renard_phy_s2lp_rc_profiles.h"
+#include "renard_phy_s2lp_hal_emu.h"
+
+/*
+ * fleet-sim - Sigfox fleet simulator for renard-phy-s2lp
+ *
+ * Simulates how the random carrier selection of renard-phy-s2lp-protocol affects collisions and message loss as the
+ * number of devices in a cell rises. Every device sends uplinks at random times (Poisson process). Every uplink is a
+ * real renard_phy_s2lp_protocol_transfer (initial frame and optional replicas) through driver and protocol against
+ * the emulator HAL, with a protocol context seeded per device: Every worker thread has its own emulated S2-LP, driver
+ * and protocol context, and the emulator's TX capture provides start, end and carrier frequency of every frame.
+ * All frames are placed on a shared spectrum timeline, a frame is lost if any other frame overlaps it in both time
+ * and frequency (no capture effect), a message is lost if all of its frames are lost.
+ *
+ * Devices, spectrum sorting and collision detection are distributed over a pool of worker threads. Results only
+ * depend on the seed, not on the number of threads.
+ *
+ * Usage: fleet-sim [-n devices[,devices...]] [-t threads] [-p period_s] [-d duration_s] [-r 1|2] [-b 100|600]
+ *                  [-l payload_bytes] [-w bandwidth_hz] [-1] [-s seed]
+ */
+
+/* Devices per job, frames per job are handed out per frequency bin */
+#define DEVICES_PER_JOB 64
+
+/**********************************************************************************************************************/
+
+/*
+ * Worker thread pool: fleet_pool_run calls job(ctx, worker, index) for every index in [0, count) from all workers and
+ * returns once all calls are complete, worker is the index of the calling worker thread in [0, threadcount)
+ */
+typedef void (*fleet_job_t)(void *ctx, uint32_t worker, uint32_t index);
+
+typedef struct fleet_pool fleet_pool_t;
+
+typedef struct
+{
+	fleet_pool_t *pool;
+	pthread_t thread;
+	uint32_t index;
+} fleet_worker_t;
+
+struct fleet_pool
+{
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t idle;
+	fleet_worker_t *workers;
+	uint32_t threadcount;
+
+	fleet_job_t job;
+	void *ctx;
+	uint32_t generation;
+	uint32_t next;
+	uint32_t count;
+	uint32_t busy;
+	bool quit;
+};
+
+static void *fleet_pool_worker(void *arg)
+{
+	fleet_worker_t *worker = arg;
+	fleet_pool_t *pool = worker->pool;
+	uint32_t generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	while (true) {
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->work, &pool->lock);
+
+		if (pool->quit)
+			break;
+
+		generation = pool->generation;
+		pool->busy++;
+		while (pool->next < pool->count) {
+			uint32_t index = pool->next++;
+			fleet_job_t job = pool->job;
+			void *ctx = pool->ctx;
+
+			pthread_mutex_unlock(&pool->lock);
+			job(ctx, worker->index, index);
+			pthread_mutex_lock(&pool->lock);
+		}
+
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->idle);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+static bool fleet_pool_init(fleet_pool_t *pool, uint32_t threadcount)
+{
+	memset(pool, 0, sizeof(*pool));
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+
+	pool->workers = calloc(threadcount, sizeof(fleet_worker_t));
+	if (pool->workers == NULL)
+		return false;
+
+	for (pool->threadcount = 0; pool->threadcount < threadcount; pool->threadcount++) {
+		fleet_worker_t *worker = &pool->workers[pool->threadcount];
+		worker->pool = pool;
+		worker->index = pool->threadcount;
+		if (pthread_create(&worker->thread, NULL, fleet_pool_worker, worker) != 0)
+			return pool->threadcount > 0;
+	}
+
+	return true;
+}
+
+static void fleet_pool_run(fleet_pool_t *pool, fleet_job_t job, void *ctx, uint32_t count)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->job = job;
+	pool->ctx = ctx;
+	pool->next = 0;
+	pool->count = count;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work);
+
+	while (pool->next < pool->count || pool->busy > 0)
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void fleet_pool_destroy(fleet_pool_t *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (uint32_t i = 0; i < pool->threadcount; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+
+	free(pool->workers);
+	pthread_cond_destroy(&pool->idle);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Simulation model
+ */
+typedef struct
+{
+	uint32_t devices;
+	uint32_t threads;
+	double period_s;
+	double duration_s;
+	renard_phy_s2lp_rc_t rc_profile;
+	renard_phy_s2lp_ul_datarate_t datarate;
+	uint8_t payloadlen;
+	uint32_t bandwidth;
+	bool replicas;
+	uint64_t seed;
+} fleet_config_t;
+
+/* Emulated S2-LP with driver and protocol context, one per worker thread */
+typedef struct
+{
+	renard_phy_s2lp_hal_emu_t hal;
+	renard_phy_s2lp_t phy;
+	renard_phy_s2lp_protocol_t protocol;
+	s2lp_emu_capture_t capture;
+} fleet_radio_t;
+
+typedef struct
+{
+	uint64_t start;
+	uint32_t duration;
+	uint32_t frequency;
+	uint32_t message;
+} fleet_frame_t;
+
+/* Frames of the messages of one device job, message numbers start at 0 for every job */
+typedef struct
+{
+	fleet_frame_t *frames;
+	uint64_t framecount;
+	uint64_t capacity;
+	uint32_t messages;
+	bool failed;
+} fleet_batch_t;
+
+typedef struct
+{
+	const fleet_config_t *config;
+	uint64_t duration_us;
+	fleet_radio_t *radios;
+	fleet_batch_t *batches;
+
+	fleet_frame_t *frames;
+	uint64_t framecount;
+	uint64_t airtime_us;
+	uint32_t max_duration_us;
+
+	/* frames sorted by frequency bin and start time, bins[b] is the index of the first frame in bin b */
+	fleet_frame_t *sorted;
+	uint64_t *bins;
+	uint32_t bincount;
+	uint32_t low;
+	uint8_t *collided;
+} fleet_sim_t;
+
+static uint64_t splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Power up the emulated S2-LP of a worker from scratch and capture its TX bursts (timing only)
+ */
+static bool fleet_radio_init(fleet_radio_t *radio)
+{
+	renard_phy_s2lp_hal_emu_configure(&radio->hal, NULL);
+	if (!renard_phy_s2lp_init(&radio->phy, &renard_phy_s2lp_hal_emu_functions, &radio->hal))
+		return false;
+
+	memset(&radio->capture, 0, sizeof(radio->capture));
+	renard_phy_s2lp_hal_emu(&radio->hal)->tx_capture = &radio->capture;
+
+	return true;
+}
+
+static bool fleet_batch_add(fleet_batch_t *batch, uint64_t start, uint32_t duration, uint32_t frequency)
+{
+	if (batch->framecount == batch->capacity) {
+		uint64_t capacity = batch->capacity > 0 ? 2 * batch->capacity : 1024;
+		fleet_frame_t *frames = realloc(batch->frames, capacity * sizeof(fleet_frame_t));
+		if (frames == NULL)
+			return false;
+
+		batch->frames = frames;
+		batch->capacity = capacity;
+	}
+
+	fleet_frame_t *frame = &batch->frames[batch->framecount++];
+	frame->start = start;
+	frame->duration = duration;
+	frame->frequency = frequency;
+	frame->message = batch->messages;
+
+	return true;
+}
+
+/*
+ * Run the uplinks of devices [index * DEVICES_PER_JOB, (index + 1) * DEVICES_PER_JOB) on the worker's radio and
+ * collect their frames. Every job starts with a freshly initialized radio and every device with its own protocol
+ * seed, so that frames do not depend on which worker runs the job.
+ */
+static void fleet_generate(void *ctx, uint32_t worker, uint32_t index)
+{
+	fleet_sim_t *sim = ctx;
+	const fleet_config_t *config = sim->config;
+	fleet_radio_t *radio = &sim->radios[worker];
+	fleet_batch_t *batch = &sim->batches[index];
+	s2lp_emu_t *emu = renard_phy_s2lp_hal_emu(&radio->hal);
+	uint32_t first = index * DEVICES_PER_JOB;
+	uint32_t last = first + DEVICES_PER_JOB < config->devices ? first + DEVICES_PER_JOB : config->devices;
+
+	if (!fleet_radio_init(radio)) {
+		batch->failed = true;
+		return;
+	}
+
+	for (uint32_t device = first; device < last; device++) {
+		uint64_t state = config->seed ^ ((uint64_t)device << 20);
+		uint16_t random = splitmix64(&state);
+		renard_phy_s2lp_protocol_init(&radio->protocol, &radio->phy, random == 0 ? 1 : random);
+
+		sfx_commoninfo common;
+		memset(&common, 0, sizeof(common));
+		common.devid = device;
+
+		sfx_ul_plain uplink;
+		memset(&uplink, 0, sizeof(uplink));
+		uplink.msglen = config->payloadlen;
+		uplink.replicas = config->replicas;
+
+		/* Poisson arrivals, but a device can only start a new transfer once the previous one is complete */
+		double t = 0;
+		while (true) {
+			double u = (splitmix64(&state) >> 11) * (1.0 / 9007199254740992.0);
+			t += -log(1.0 - u) * config->period_s * 1e6;
+			if (t >= sim->duration_us)
+				break;
+
+			sfx_dl_plain downlink;
+			int16_t rssi;
+			uint64_t begin = emu->now;
+			radio->capture.bursts = 0;
+			if (renard_phy_s2lp_protocol_transfer(&radio->protocol, &common, &uplink, &downlink, config->rc_profile,
+					config->datarate, &rssi) != PROTOCOL_ERROR_NONE) {
+				batch->failed = true;
+				return;
+			}
+			common.seqnum++;
+
+			for (uint8_t f = 0; f < radio->capture.bursts; f++) {
+				uint64_t start = (uint64_t)t + (radio->capture.burst_time[f] - begin) / 1000;
+				uint32_t duration = (radio->capture.burst_end[f] - radio->capture.burst_time[f]) / 1000;
+				if (!fleet_batch_add(batch, start, duration, radio->capture.burst_frequency[f])) {
+					batch->failed = true;
+					return;
+				}
+			}
+
+			batch->messages++;
+			t += (emu->now - begin) / 1000.0;
+		}
+	}
+}
+
+static int fleet_frame_compare(const void *a, const void *b)
+{
+	const fleet_frame_t *fa = a, *fb = b;
+	return fa->start < fb->start ? -1 : fa->start > fb->start ? 1 : fa->frequency < fb->frequency ? -1 :
+			fa->frequency > fb->frequency ? 1 : 0;
+}
+
+static void fleet_sort_bin(void *ctx, uint32_t worker, uint32_t bin)
+{
+	fleet_sim_t *sim = ctx;
+	(void)worker;
+	qsort(&sim->sorted[sim->bins[bin]], sim->bins[bin + 1] - sim->bins[bin], sizeof(fleet_frame_t),
+			fleet_frame_compare);
+}
+
+/*
+ * Mark every frame in the given bin that overlaps with any other frame in time and frequency. Bins are as wide as
+ * the collision bandwidth, so only the neighbouring bins need to be searched.
+ */
+static void fleet_collide_bin(void *ctx, uint32_t worker, uint32_t bin)
+{
+	fleet_sim_t *sim = ctx;
+	uint32_t bandwidth = sim->config->bandwidth;
+	(void)worker;
+
+	for (uint64_t i = sim->bins[bin]; i < sim->bins[bin + 1]; i++) {
+		const fleet_frame_t *frame = &sim->sorted[i];
+		uint64_t earliest = frame->start > sim->max_duration_us ? frame->start - sim->max_duration_us + 1 : 0;
+		uint64_t end = frame->start + frame->duration;
+
+		for (uint32_t b = bin > 0 ? bin - 1 : 0; b <= bin + 1 && b < sim->bincount && !sim->collided[i]; b++) {
+			/* first frame in bin that can still be on air when this frame starts */
+			uint64_t lo = sim->bins[b], hi = sim->bins[b + 1];
+			while (lo < hi) {
+				uint64_t mid = lo + (hi - lo) / 2;
+				if (sim->sorted[mid].start < earliest)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			for (uint64_t j = lo; j < sim->bins[b + 1] && sim->sorted[j].start < end; j++) {
+				const fleet_frame_t *other = &sim->sorted[j];
+				uint32_t distance = other->frequency > frame->frequency ?
+						other->frequency - frame->frequency : frame->frequency - other->frequency;
+				if (j != i && other->start + other->duration > frame->start && distance < bandwidth) {
+					sim->collided[i] = 1;
+					break;
+				}
+			}
+		}
+	}
+}
+
+/* Frequency bin of a carrier, carriers are within the RC profile's bounds up to synthesizer rounding */
+static uint32_t fleet_bin(const fleet_sim_t *sim, uint32_t frequency)
+{
+	uint32_t bin = frequency > sim->low ? (frequency - sim->low) / sim->config->bandwidth : 0;
+	return bin < sim->bincount ? bin : sim->bincount - 1;
+}
+
+static double fleet_clock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static bool fleet_simulate(fleet_pool_t *pool, fleet_radio_t *radios, const fleet_config_t *config)
+{
+	double started = fleet_clock();
+	const char *error = "out of memory";
+	bool ok = false;
+
+	fleet_sim_t sim;
+	memset(&sim, 0, sizeof(sim));
+	sim.config = config;
+	sim.duration_us = config->duration_s * 1e6;
+	sim.radios = radios;
+
+	/*
+	 * Run all uplinks, every job collects its own frames, then concatenate them and number messages consecutively
+	 */
+	uint32_t jobs = (config->devices + DEVICES_PER_JOB - 1) / DEVICES_PER_JOB;
+	sim.batches = calloc(jobs, sizeof(fleet_batch_t));
+	if (sim.batches == NULL)
+		goto out;
+
+	fleet_pool_run(pool, fleet_generate, &sim, jobs);
+
+	for (uint32_t i = 0; i < jobs; i++) {
+		if (sim.batches[i].failed) {
+			error = "uplink transfer failed";
+			goto out;
+		}
+		sim.framecount += sim.batches[i].framecount;
+	}
+
+	sim.frames = malloc((sim.framecount + 1) * sizeof(fleet_frame_t));
+	sim.sorted = malloc((sim.framecount + 1) * sizeof(fleet_frame_t));
+	sim.collided = calloc(sim.framecount + 1, 1);
+	if (sim.frames == NULL || sim.sorted == NULL || sim.collided == NULL)
+		goto out;
+
+	uint32_t messages = 0;
+	uint64_t framecount = 0;
+	for (uint32_t i = 0; i < jobs; i++) {
+		for (uint64_t f = 0; f < sim.batches[i].framecount; f++) {
+			fleet_frame_t *frame = &sim.frames[framecount++];
+			*frame = sim.batches[i].frames[f];
+			frame->message += messages;
+			sim.airtime_us += frame->duration;
+			if (frame->duration > sim.max_duration_us)
+				sim.max_duration_us = frame->duration;
+		}
+		messages += sim.batches[i].messages;
+	}
+
+	/*
+	 * Place frames on spectrum timeline: Bucket by frequency bin (counting sort), then sort every bin by time
+	 */
+	sim.low = renard_phy_s2lp_freq_bound_low_by_rc[config->rc_profile];
+	sim.bincount = (renard_phy_s2lp_freq_bound_high_by_rc[config->rc_profile] - sim.low) / config->bandwidth + 1;
+	sim.bins = calloc(sim.bincount + 1, sizeof(uint64_t));
+	if (sim.bins == NULL)
+		goto out;
+
+	for (uint64_t i = 0; i < sim.framecount; i++)
+		sim.bins[fleet_bin(&sim, sim.frames[i].frequency) + 1]++;
+	for (uint32_t b = 0; b < sim.bincount; b++)
+		sim.bins[b + 1] += sim.bins[b];
+	for (uint64_t i = 0; i < sim.framecount; i++)
+		sim.sorted[sim.bins[fleet_bin(&sim, sim.frames[i].frequency)]++] = sim.frames[i];
+	memmove(&sim.bins[1], &sim.bins[0], sim.bincount * sizeof(uint64_t));
+	sim.bins[0] = 0;
+
+	fleet_pool_run(pool, fleet_sort_bin, &sim, sim.bincount);
+	fleet_pool_run(pool, fleet_collide_bin, &sim, sim.bincount);
+
+	/*
+	 * A message is delivered if at least one of its frames is received, unsorted frames are no longer needed
+	 */
+	uint8_t *delivered = (uint8_t *)sim.frames;
+	memset(delivered, 0, messages);
+	uint64_t collisions = 0;
+	for (uint64_t i = 0; i < sim.framecount; i++) {
+		if (sim.collided[i])
+			collisions++;
+		else
+			delivered[sim.sorted[i].message] = 1;
+	}
+
+	uint32_t received = 0;
+	for (uint32_t m = 0; m < messages; m++)
+		received += delivered[m];
+
+	/* Offered load: Average number of frames per collision bandwidth at any point in time */
+	double load = (double)sim.airtime_us / sim.duration_us / sim.bincount;
+
+	printf("%9u %10u %10" PRIu64 " %9.5f %9.6f %9.6f %11.3f %11.1f %8.2f\n", config->devices, messages,
+			sim.framecount, load, sim.framecount ? (double)collisions / sim.framecount : 0.0,
+			messages ? (double)(messages - received) / messages : 0.0, received / config->duration_s,
+			received * 8.0 * config->payloadlen / config->duration_s, fleet_clock() - started);
+	ok = true;
+
+out:
+	if (!ok)
+		fprintf(stderr, "fleet-sim: %s for %u devices\n", error, config->devices);
+
+	for (uint32_t i = 0; sim.batches != NULL && i < jobs; i++)
+		free(sim.batches[i].frames);
+	free(sim.batches);
+	free(sim.frames);
+	free(sim.sorted);
+	free(sim.bins);
+	free(sim.collided);
+
+	return ok;
+}
+
+/**********************************************************************************************************************/
+
+static void fleet_usage(void)
+{
+	fprintf(stderr, "Usage: fleet-sim [-n devices[,devices...]] [-t threads] [-p period_s] [-d duration_s] "
+			"[-r 1|2] [-b 100|600] [-l payload_bytes] [-w bandwidth_hz] [-1] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *devices = "100,1000,10000";
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t datarate = 100;
+	bool bandwidth_set = false;
+	int opt;
+
+	fleet_config_t config = {
+		.threads = cpus > 0 ? cpus : 1,
+		.period_s = 600,
+		.duration_s = 3600,
+		.rc_profile = PROFILE_RC1,
+		.payloadlen = 12,
+		.replicas = true,
+		.seed = 1
+	};
+
+	while ((opt = getopt(argc, argv, "n:t:p:d:r:b:l:w:1s:h")) != -1) {
+		switch (opt) {
+			case 'n': devices = optarg; break;
+			case 't': config.threads = strtoul(optarg, NULL, 0); break;
+			case 'p': config.period_s = strtod(optarg, NULL); break;
+			case 'd': config.duration_s = strtod(optarg, NULL); break;
+			case 'r': config.rc_profile = strtoul(optarg, NULL, 0) == 2 ? PROFILE_RC2 : PROFILE_RC1; break;
+			case 'b': datarate = strtoul(optarg, NULL, 0); break;
+			case 'l': config.payloadlen = strtoul(optarg, NULL, 0); break;
+			case 'w': config.bandwidth = strtoul(optarg, NULL, 0); bandwidth_set = true; break;
+			case '1': config.replicas = false; break;
+			case 's': config.seed = strtoull(optarg, NULL, 0); break;
+			default: fleet_usage(); return 1;
+		}
+	}
+
+	config.datarate = datarate == 600 ? UL_DATARATE_600BPS : UL_DATARATE_100BPS;
+	if (!renard_phy_s2lp_baudrates_allowed_by_rc[config.rc_profile][config.datarate]) {
+		fprintf(stderr, "fleet-sim: %ubps not allowed in RC%u\n", datarate, config.rc_profile + 1);
+		return 1;
+	}
+
+	/* DBPSK signals occupy about as many Hz as they have bits per second */
+	if (!bandwidth_set)
+		config.bandwidth = config.datarate == UL_DATARATE_600BPS ? 600 : 100;
+
+	if (config.threads == 0 || config.bandwidth == 0 || config.payloadlen > 12 || config.period_s <= 0 ||
+			config.duration_s <= 0) {
+		fleet_usage();
+		return 1;
+	}
+
+	fleet_pool_t pool;
+	if (!fleet_pool_init(&pool, config.threads)) {
+		fprintf(stderr, "fleet-sim: failed to start worker threads\n");
+		return 1;
+	}
+
+	fleet_radio_t *radios = calloc(pool.threadcount, sizeof(fleet_radio_t));
+	if (radios == NULL) {
+		fprintf(stderr, "fleet-sim: out of memory\n");
+		fleet_pool_destroy(&pool);
+		return 1;
+	}
+
+	printf("# RC%u, %ubps, %u byte payload, %s, one message per %.0fs, %.0fs simulated, %uHz collision bandwidth, "
+			"%u threads\n", config.rc_profile + 1, datarate, config.payloadlen,
+			config.replicas ? "2 replicas" : "no replicas", config.period_s, config.duration_s, config.bandwidth,
+			pool.threadcount);
+	printf("#  devices   messages     frames      load frame_col  msg_loss   msgs_per_s payload_bps  wall_s\n");
+
+	int status = 0;
+	for (const char *p = devices; *p != '\0' && status == 0; ) {
+		char *end;
+		config.devices = strtoul(p, &end, 0);
+		if (end == p || config.devices == 0) {
+			fleet_usage();
+			status = 1;
+			break;
+		}
+
+		if (!fleet_simulate(&pool, radios, &config))
+			status = 1;
+
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	fleet_pool_destroy(&pool);
+	free(radios);
+
+	return status;
+}
@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "renard_phy_s2lp_hal.h"
+#include "renard_phy_s2lp.h"
+#include "conf_driver.h"
+
+#include "renard_phy_s2lp_hal_emu.h"
+#include "s2lp_emu.h"
+
+/*
+ * Default emulator configuration: 50MHz XTAL like the hardware presets, 8MHz SPI clock with 2us of chip select and
+ * HAL overhead per transaction and 10us interrupt latency - typical values for a Cortex-M0+ at 32MHz.
+ * Supply currents are the S2-LP's typical values at 3V from the datasheet (TX at +14dBm, SMPS enabled).
+ */
+static const s2lp_emu_config_t DEFAULT_CONFIG = {
+	.xtal_freq = 50000000,
+	.spi_clock = 8000000,
+	.spi_overhead_ns = 2000,
+	.isr_latency_ns = 10000,
+	.current_ua = {
+		[S2LP_EMU_POWER_SHUTDOWN] = 0.0025,
+		[S2LP_EMU_POWER_STANDBY] = 0.5,
+		[S2LP_EMU_POWER_SLEEP] = 0.6,
+		[S2LP_EMU_POWER_READY] = 350,
+		[S2LP_EMU_POWER_LOCK] = 4500,
+		[S2LP_EMU_POWER_RX] = 7000,
+		[S2LP_EMU_POWER_TX] = 21000
+	}
+};
+
+/*
+ * Sample the MCU's interrupt pin and latch configured edges
+ */
+static void renard_phy_s2lp_hal_emu_gpio_sample(renard_phy_s2lp_hal_emu_t *hal)
+{
+	bool level = s2lp_emu_gpio(&hal->emu, RENARD_PHY_S2LP_HAL_EMU_IRQ_GPIO);
+
+	if (hal->gpio_enabled && level != hal->gpio_level && level == hal->gpio_rising)
+		hal->gpio_pending = true;
+
+	hal->gpio_level = level;
+}
+
+/*
+ * Advance virtual time up to the next interrupt, returns false if no interrupt would ever occur on real hardware
+ */
+static bool renard_phy_s2lp_hal_emu_next_interrupt(renard_phy_s2lp_hal_emu_t *hal, bool *is_gpio)
+{
+	while (!hal->gpio_pending) {
+		uint64_t next = s2lp_emu_next_event(&hal->emu);
+
+		if (hal->timeout <= next) {
+			if (hal->timeout == S2LP_EMU_TIME_NEVER)
+				return false;
+
+			s2lp_emu_advance(&hal->emu, hal->timeout);
+			hal->timeout = S2LP_EMU_TIME_NEVER;
+			hal->stats.timeout_interrupts++;
+			*is_gpio = false;
+			return true;
+		}
+
+		s2lp_emu_advance(&hal->emu, next);
+		renard_phy_s2lp_hal_emu_gpio_sample(hal);
+	}
+
+	hal->gpio_pending = false;
+	hal->stats.gpio_interrupts++;
+	s2lp_emu_advance(&hal->emu, hal->emu.now + hal->config.isr_latency_ns);
+	*is_gpio = true;
+
+	return true;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Emulator control interface
+ */
+uint64_t renard_phy_s2lp_hal_emu_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+void renard_phy_s2lp_hal_emu_configure(renard_phy_s2lp_hal_emu_t *hal, const s2lp_emu_config_t *config)
+{
+	hal->config = config != NULL ? *config : DEFAULT_CONFIG;
+}
+
+s2lp_emu_t *renard_phy_s2lp_hal_emu(renard_phy_s2lp_hal_emu_t *hal)
+{
+	return &hal->emu;
+}
+
+const renard_phy_s2lp_hal_emu_stats_t *renard_phy_s2lp_hal_emu_stats(renard_phy_s2lp_hal_emu_t *hal)
+{
+	return &hal->stats;
+}
+
+void renard_phy_s2lp_hal_emu_stats_reset(renard_phy_s2lp_hal_emu_t *hal)
+{
+	memset(&hal->stats, 0, sizeof(hal->stats));
+	memset(&hal->emu.stats, 0, sizeof(hal->emu.stats));
+}
+
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+
+bool renard_phy_s2lp_hal_emu_dispatch(renard_phy_s2lp_hal_emu_t *hal)
+{
+	bool is_gpio;
+
+	if (hal->spi_async_pending) {
+		hal->spi_async_pending = false;
+		renard_phy_s2lp_async_spi_done(hal->phy);
+		return true;
+	}
+
+	if (!hal->async || !renard_phy_s2lp_hal_emu_next_interrupt(hal, &is_gpio))
+		return false;
+
+	renard_phy_s2lp_async_interrupt(hal->phy, is_gpio);
+	return true;
+}
+
+#endif
+
+/**********************************************************************************************************************/
+
+/*
+ * HAL implementation, see renard_phy_s2lp_hal.h
+ */
+static void renard_phy_s2lp_hal_emu_init(void *context, renard_phy_s2lp_t *phy)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+
+	s2lp_emu_init(&hal->emu, &hal->config);
+	memset(&hal->stats, 0, sizeof(hal->stats));
+
+	hal->phy = phy;
+	hal->timeout = S2LP_EMU_TIME_NEVER;
+	hal->gpio_enabled = false;
+	hal->gpio_pending = false;
+	hal->gpio_level = false;
+	hal->async = false;
+	hal->spi_async_pending = false;
+}
+
+static void renard_phy_s2lp_hal_emu_spi(void *context, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+	uint64_t start = renard_phy_s2lp_hal_emu_cycles();
+
+	s2lp_emu_spi(&hal->emu, length, in, out);
+	renard_phy_s2lp_hal_emu_gpio_sample(hal);
+
+	hal->stats.hal_cycles += renard_phy_s2lp_hal_emu_cycles() - start;
+}
+
+static void renard_phy_s2lp_hal_emu_shutdown(void *context, bool shutdown)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+	uint64_t start = renard_phy_s2lp_hal_emu_cycles();
+
+	s2lp_emu_shutdown(&hal->emu, shutdown);
+	renard_phy_s2lp_hal_emu_gpio_sample(hal);
+
+	hal->stats.hal_cycles += renard_phy_s2lp_hal_emu_cycles() - start;
+}
+
+static void renard_phy_s2lp_hal_emu_interrupt_timeout(void *context, uint32_t milliseconds)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+
+	hal->timeout = hal->emu.now + (uint64_t)milliseconds * 1000000;
+}
+
+static void renard_phy_s2lp_hal_emu_interrupt_gpio(void *context, bool risingTrigger)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+
+	hal->gpio_enabled = true;
+	hal->gpio_rising = risingTrigger;
+	hal->gpio_level = s2lp_emu_gpio(&hal->emu, RENARD_PHY_S2LP_HAL_EMU_IRQ_GPIO);
+	hal->gpio_pending = false;
+}
+
+static void renard_phy_s2lp_hal_emu_interrupt_clear(void *context)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+
+	hal->timeout = S2LP_EMU_TIME_NEVER;
+	hal->gpio_enabled = false;
+	hal->gpio_pending = false;
+}
+
+static bool renard_phy_s2lp_hal_emu_interrupt_wait(void *context)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+	uint64_t start = renard_phy_s2lp_hal_emu_cycles();
+	bool is_gpio;
+
+	hal->stats.interrupt_waits++;
+
+	/* Nothing would ever wake up the MCU on real hardware */
+	if (!renard_phy_s2lp_hal_emu_next_interrupt(hal, &is_gpio)) {
+		hal->stats.deadlocks++;
+		is_gpio = false;
+	}
+
+	hal->stats.hal_cycles += renard_phy_s2lp_hal_emu_cycles() - start;
+
+	return is_gpio;
+}
+
+static uint32_t renard_phy_s2lp_hal_emu_timestamp(void *context)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+
+	return hal->emu.now / 1000;
+}
+
+/*
+ * Asynchronous transfers complete right away in virtual time, but completion is only reported on the next call to
+ * renard_phy_s2lp_hal_emu_dispatch, just like a DMA completion interrupt would only fire after the driver returned.
+ */
+static void renard_phy_s2lp_hal_emu_spi_async(void *context, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+	uint64_t start = renard_phy_s2lp_hal_emu_cycles();
+
+	s2lp_emu_spi(&hal->emu, length, in, out);
+	renard_phy_s2lp_hal_emu_gpio_sample(hal);
+	hal->spi_async_pending = true;
+
+	hal->stats.hal_cycles += renard_phy_s2lp_hal_emu_cycles() - start;
+}
+
+static void renard_phy_s2lp_hal_emu_interrupt_async(void *context, bool enable)
+{
+	renard_phy_s2lp_hal_emu_t *hal = context;
+
+	hal->async = enable;
+}
+
+const renard_phy_s2lp_hal_t renard_phy_s2lp_hal_emu_functions = {
+	.init = renard_phy_s2lp_hal_emu_init,
+	.spi = renard_phy_s2lp_hal_emu_spi,
+	.shutdown = renard_phy_s2lp_hal_emu_shutdown,
+	.interrupt_timeout = renard_phy_s2lp_hal_emu_interrupt_timeout,
+	.interrupt_gpio = renard_phy_s2lp_hal_emu_interrupt_gpio,
+	.interrupt_clear = renard_phy_s2lp_hal_emu_interrupt_clear,
+	.interrupt_wait = renard_phy_s2lp_hal_emu_interrupt_wait,
+	.spi_async = renard_phy_s2lp_hal_emu_spi_async,
+	.interrupt_async = renard_phy_s2lp_hal_emu_interrupt_async,
+	.timestamp = renard_phy_s2lp_hal_emu_timestamp
+};
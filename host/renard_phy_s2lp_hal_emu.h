@@ -0,0 +1,79 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "renard_phy_s2lp_hal.h"
+#include "s2lp_emu.h"
+
+/*
+ * renard-phy-s2lp-hal-emu - renard-phy-s2lp HAL backed by the s2lp-emu S2-LP emulator
+ *
+ * Used in place of a hardware HAL (renard-phy-s2lp-hal-*) so that renard-phy-s2lp can run on a host machine.
+ * Timeout interrupts are driven by the emulator's virtual clock, GPIO interrupts by the emulated GPIO3 output.
+ * Every HAL instance (renard_phy_s2lp_hal_emu_t) emulates its own S2-LP with its own virtual clock, pass
+ * renard_phy_s2lp_hal_emu_functions and the instance to renard_phy_s2lp_init.
+ */
+
+#ifndef _RENARD_PHY_S2LP_HAL_EMU_H
+#define _RENARD_PHY_S2LP_HAL_EMU_H
+
+/* GPIO of the S2-LP that is connected to the MCU's interrupt pin */
+#define RENARD_PHY_S2LP_HAL_EMU_IRQ_GPIO 3
+
+typedef struct
+{
+	uint32_t interrupt_waits;
+	uint32_t gpio_interrupts;
+	uint32_t timeout_interrupts;
+
+	/* renard_phy_s2lp_interrupt_wait calls that would have blocked forever on real hardware */
+	uint32_t deadlocks;
+
+	/* host CPU time spent in HAL functions and the emulator, see renard_phy_s2lp_hal_emu_cycles */
+	uint64_t hal_cycles;
+} renard_phy_s2lp_hal_emu_stats_t;
+
+/*
+ * HAL instance, all members are private
+ */
+typedef struct
+{
+	s2lp_emu_config_t config;
+	s2lp_emu_t emu;
+	renard_phy_s2lp_hal_emu_stats_t stats;
+	struct renard_phy_s2lp *phy;
+
+	uint64_t timeout;
+	bool gpio_enabled;
+	bool gpio_rising;
+	bool gpio_level;
+	bool gpio_pending;
+	bool async;
+	bool spi_async_pending;
+} renard_phy_s2lp_hal_emu_t;
+
+extern const renard_phy_s2lp_hal_t renard_phy_s2lp_hal_emu_functions;
+
+/*
+ * renard_phy_s2lp_hal_emu_configure: Set emulator configuration used when renard_phy_s2lp_init initializes the HAL,
+ *   NULL selects the default configuration. Call before renard_phy_s2lp_init.
+ * renard_phy_s2lp_hal_emu: Access emulator instance, e.g. for statistics or to schedule downlink frames
+ */
+void renard_phy_s2lp_hal_emu_configure(renard_phy_s2lp_hal_emu_t *hal, const s2lp_emu_config_t *config);
+s2lp_emu_t *renard_phy_s2lp_hal_emu(renard_phy_s2lp_hal_emu_t *hal);
+
+const renard_phy_s2lp_hal_emu_stats_t *renard_phy_s2lp_hal_emu_stats(renard_phy_s2lp_hal_emu_t *hal);
+void renard_phy_s2lp_hal_emu_stats_reset(renard_phy_s2lp_hal_emu_t *hal);
+
+/*
+ * Host CPU cycle counter for profiling the driver (TSC on x86, nanoseconds on other hosts). Subtract
+ * renard_phy_s2lp_hal_emu_stats(hal)->hal_cycles to obtain the time spent in renard-phy-s2lp itself.
+ */
+uint64_t renard_phy_s2lp_hal_emu_cycles(void);
+
+/*
+ * Asynchronous operation (RENARD_PHY_S2LP_ASYNC): Deliver the next pending asynchronous SPI completion or interrupt
+ * to the driver, as the MCU's interrupt controller would. Returns false if there is nothing left to deliver.
+ */
+bool renard_phy_s2lp_hal_emu_dispatch(renard_phy_s2lp_hal_emu_t *hal);
+
+#endif
@@ -0,0 +1,385 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "renard_phy_s2lp_hal.h"
+#include "renard_phy_s2lp_hal_trace.h"
+
+#include "renard_phy_s2lp_hal_replay.h"
+
+static const char *TRACE_TYPE_NAMES[RENARD_PHY_S2LP_TRACE_TYPE_COUNT] = {
+	[RENARD_PHY_S2LP_TRACE_INIT] = "init",
+	[RENARD_PHY_S2LP_TRACE_SPI] = "spi",
+	[RENARD_PHY_S2LP_TRACE_SHUTDOWN] = "shutdown",
+	[RENARD_PHY_S2LP_TRACE_TIMEOUT] = "timeout",
+	[RENARD_PHY_S2LP_TRACE_GPIO] = "gpio",
+	[RENARD_PHY_S2LP_TRACE_CLEAR] = "clear",
+	[RENARD_PHY_S2LP_TRACE_WAIT] = "wait",
+	[RENARD_PHY_S2LP_TRACE_TIMESTAMP] = "timestamp",
+	[RENARD_PHY_S2LP_TRACE_ASYNC] = "async"
+};
+
+/**********************************************************************************************************************/
+
+/*
+ * Trace reader
+ * renard_phy_s2lp_trace_varint: Decode unsigned LEB128 varint at the current position, false if truncated
+ * renard_phy_s2lp_trace_bytes: Take length bytes from the current position, NULL if truncated
+ */
+static bool renard_phy_s2lp_trace_varint(renard_phy_s2lp_trace_t *trace, uint32_t *value)
+{
+	*value = 0;
+
+	for (uint8_t shift = 0; shift < 35; shift += 7) {
+		if (trace->offset >= trace->size)
+			return false;
+
+		uint8_t byte = trace->data[trace->offset++];
+		*value |= (uint32_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+static const uint8_t *renard_phy_s2lp_trace_bytes(renard_phy_s2lp_trace_t *trace, size_t length)
+{
+	if (trace->size - trace->offset < length)
+		return NULL;
+
+	const uint8_t *bytes = &trace->data[trace->offset];
+	trace->offset += length;
+	return bytes;
+}
+
+bool renard_phy_s2lp_trace_buffer(renard_phy_s2lp_trace_t *trace, const uint8_t *data, size_t size)
+{
+	memset(trace, 0, sizeof(*trace));
+	trace->data = data;
+	trace->size = size;
+
+	if (size < RENARD_PHY_S2LP_TRACE_HEADER_LENGTH || memcmp(data, RENARD_PHY_S2LP_TRACE_MAGIC, 4) != 0 ||
+			data[4] != RENARD_PHY_S2LP_TRACE_VERSION)
+		return false;
+
+	renard_phy_s2lp_trace_rewind(trace);
+	return true;
+}
+
+bool renard_phy_s2lp_trace_open(renard_phy_s2lp_trace_t *trace, const char *path)
+{
+	struct stat info;
+	int fd = open(path, O_RDONLY);
+
+	memset(trace, 0, sizeof(*trace));
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &info) != 0 || info.st_size < RENARD_PHY_S2LP_TRACE_HEADER_LENGTH) {
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	if (!renard_phy_s2lp_trace_buffer(trace, data, info.st_size)) {
+		munmap(data, info.st_size);
+		memset(trace, 0, sizeof(*trace));
+		return false;
+	}
+
+	trace->mapped = true;
+	return true;
+}
+
+void renard_phy_s2lp_trace_close(renard_phy_s2lp_trace_t *trace)
+{
+	if (trace->mapped)
+		munmap((void *)trace->data, trace->size);
+
+	memset(trace, 0, sizeof(*trace));
+}
+
+void renard_phy_s2lp_trace_rewind(renard_phy_s2lp_trace_t *trace)
+{
+	trace->offset = RENARD_PHY_S2LP_TRACE_HEADER_LENGTH;
+	trace->time = 0;
+	trace->index = 0;
+	trace->malformed = false;
+}
+
+bool renard_phy_s2lp_trace_next(renard_phy_s2lp_trace_t *trace, renard_phy_s2lp_trace_record_t *record)
+{
+	uint32_t delta;
+
+	if (trace->malformed || trace->offset >= trace->size)
+		return false;
+
+	memset(record, 0, sizeof(*record));
+	record->offset = trace->offset;
+
+	uint8_t type = trace->data[trace->offset++];
+	record->type = type & RENARD_PHY_S2LP_TRACE_TYPE_MASK;
+
+	trace->malformed = record->type >= RENARD_PHY_S2LP_TRACE_TYPE_COUNT ||
+			!renard_phy_s2lp_trace_varint(trace, &delta);
+	if (trace->malformed)
+		return false;
+
+	trace->time += delta;
+	record->time = trace->time;
+
+	switch (record->type) {
+		case RENARD_PHY_S2LP_TRACE_SPI:
+		{
+			const uint8_t *length = renard_phy_s2lp_trace_bytes(trace, 1);
+			record->length = length != NULL ? *length : 0;
+			record->mosi = length != NULL ? renard_phy_s2lp_trace_bytes(trace, record->length) : NULL;
+			if (record->mosi != NULL && (type & RENARD_PHY_S2LP_TRACE_MISO) != 0)
+				record->miso = renard_phy_s2lp_trace_bytes(trace, record->length);
+
+			trace->malformed = record->mosi == NULL || ((type & RENARD_PHY_S2LP_TRACE_MISO) != 0 &&
+					record->miso == NULL);
+			break;
+		}
+
+		case RENARD_PHY_S2LP_TRACE_SHUTDOWN:
+		case RENARD_PHY_S2LP_TRACE_GPIO:
+		case RENARD_PHY_S2LP_TRACE_WAIT:
+		{
+			const uint8_t *value = renard_phy_s2lp_trace_bytes(trace, 1);
+			record->value = value != NULL ? *value : 0;
+			trace->malformed = value == NULL;
+			break;
+		}
+
+		case RENARD_PHY_S2LP_TRACE_TIMEOUT:
+			trace->malformed = !renard_phy_s2lp_trace_varint(trace, &record->value);
+			break;
+
+		default:
+			break;
+	}
+
+	if (trace->malformed)
+		return false;
+
+	trace->index++;
+	return true;
+}
+
+const char *renard_phy_s2lp_trace_type_name(renard_phy_s2lp_trace_type_t type)
+{
+	return type < RENARD_PHY_S2LP_TRACE_TYPE_COUNT ? TRACE_TYPE_NAMES[type] : "unknown";
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Replay control interface
+ */
+bool renard_phy_s2lp_hal_replay_open(renard_phy_s2lp_hal_replay_t *replay, const char *path)
+{
+	memset(replay, 0, sizeof(*replay));
+	return renard_phy_s2lp_trace_open(&replay->trace, path);
+}
+
+const char *renard_phy_s2lp_hal_replay_finish(renard_phy_s2lp_hal_replay_t *replay)
+{
+	renard_phy_s2lp_trace_record_t record;
+
+	if (!replay->diverged && renard_phy_s2lp_trace_next(&replay->trace, &record)) {
+		snprintf(replay->error, sizeof(replay->error), "record %u (offset %zu): trace continues with %s",
+				replay->trace.index - 1, record.offset, renard_phy_s2lp_trace_type_name(record.type));
+		replay->diverged = true;
+	}
+
+	if (!replay->diverged && replay->trace.malformed) {
+		snprintf(replay->error, sizeof(replay->error), "record %u (offset %zu): malformed trace",
+				replay->trace.index, replay->trace.offset);
+		replay->diverged = true;
+	}
+
+	renard_phy_s2lp_trace_close(&replay->trace);
+
+	return replay->diverged ? replay->error : NULL;
+}
+
+/*
+ * Divergence detection:
+ * renard_phy_s2lp_hal_replay_take: Take the record for a HAL call of the given type from the trace, returns false if
+ *   the trace holds anything else or the driver has diverged before
+ * renard_phy_s2lp_hal_replay_check: Report divergence unless the call's argument (what) matches the record
+ */
+static bool renard_phy_s2lp_hal_replay_take(renard_phy_s2lp_hal_replay_t *replay, renard_phy_s2lp_trace_type_t type,
+		renard_phy_s2lp_trace_record_t *record)
+{
+	if (replay->diverged)
+		return false;
+
+	if (!renard_phy_s2lp_trace_next(&replay->trace, record)) {
+		snprintf(replay->error, sizeof(replay->error), "record %u (offset %zu): driver called %s after %s",
+				replay->trace.index, replay->trace.offset, renard_phy_s2lp_trace_type_name(type),
+				replay->trace.malformed ? "malformed record" : "end of trace");
+		replay->diverged = true;
+		return false;
+	}
+
+	if (record->type != type) {
+		snprintf(replay->error, sizeof(replay->error), "record %u (offset %zu): driver called %s, trace has %s",
+				replay->trace.index - 1, record->offset, renard_phy_s2lp_trace_type_name(type),
+				renard_phy_s2lp_trace_type_name(record->type));
+		replay->diverged = true;
+		return false;
+	}
+
+	replay->time = record->time;
+	return true;
+}
+
+static bool renard_phy_s2lp_hal_replay_check(renard_phy_s2lp_hal_replay_t *replay,
+		const renard_phy_s2lp_trace_record_t *record, bool matches, const char *what)
+{
+	if (!matches) {
+		snprintf(replay->error, sizeof(replay->error), "record %u (offset %zu): %s %s differs from trace",
+				replay->trace.index - 1, record->offset, renard_phy_s2lp_trace_type_name(record->type), what);
+		replay->diverged = true;
+	}
+
+	return matches;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * HAL implementation, see renard_phy_s2lp_hal.h
+ */
+static void renard_phy_s2lp_hal_replay_init(void *context, struct renard_phy_s2lp *phy)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+	(void)phy;
+
+	renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_INIT, &record);
+}
+
+static void renard_phy_s2lp_hal_replay_spi(void *context, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+
+	if (out != NULL)
+		memset(out, 0, length);
+
+	if (!renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_SPI, &record) ||
+			!renard_phy_s2lp_hal_replay_check(replay, &record, record.length == length, "length") ||
+			!renard_phy_s2lp_hal_replay_check(replay, &record, memcmp(record.mosi, in, length) == 0, "MOSI") ||
+			!renard_phy_s2lp_hal_replay_check(replay, &record, (record.miso != NULL) == (out != NULL), "MISO read"))
+		return;
+
+	if (out != NULL)
+		memcpy(out, record.miso, length);
+}
+
+static void renard_phy_s2lp_hal_replay_shutdown(void *context, bool shutdown)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+
+	if (renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_SHUTDOWN, &record))
+		renard_phy_s2lp_hal_replay_check(replay, &record, record.value == shutdown, "state");
+}
+
+static void renard_phy_s2lp_hal_replay_interrupt_timeout(void *context, uint32_t milliseconds)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+
+	if (renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_TIMEOUT, &record))
+		renard_phy_s2lp_hal_replay_check(replay, &record, record.value == milliseconds, "duration");
+}
+
+static void renard_phy_s2lp_hal_replay_interrupt_gpio(void *context, bool risingTrigger)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+
+	if (renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_GPIO, &record))
+		renard_phy_s2lp_hal_replay_check(replay, &record, record.value == risingTrigger, "trigger");
+}
+
+static void renard_phy_s2lp_hal_replay_interrupt_clear(void *context)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+
+	renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_CLEAR, &record);
+}
+
+static bool renard_phy_s2lp_hal_replay_interrupt_wait(void *context)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+
+	return renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_WAIT, &record) && record.value != 0;
+}
+
+static uint32_t renard_phy_s2lp_hal_replay_timestamp(void *context)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+
+	renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_TIMESTAMP, &record);
+	return replay->time;
+}
+
+/*
+ * Asynchronous operation is not recorded, so it cannot be replayed either
+ */
+static void renard_phy_s2lp_hal_replay_spi_async(void *context, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+	(void)length;
+	(void)in;
+	(void)out;
+
+	if (renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_ASYNC, &record))
+		renard_phy_s2lp_hal_replay_check(replay, &record, false, "asynchronous SPI");
+}
+
+static void renard_phy_s2lp_hal_replay_interrupt_async(void *context, bool enable)
+{
+	renard_phy_s2lp_hal_replay_t *replay = context;
+	renard_phy_s2lp_trace_record_t record;
+	(void)enable;
+
+	if (renard_phy_s2lp_hal_replay_take(replay, RENARD_PHY_S2LP_TRACE_ASYNC, &record))
+		renard_phy_s2lp_hal_replay_check(replay, &record, false, "asynchronous interrupt");
+}
+
+const renard_phy_s2lp_hal_t renard_phy_s2lp_hal_replay_functions = {
+	.init = renard_phy_s2lp_hal_replay_init,
+	.spi = renard_phy_s2lp_hal_replay_spi,
+	.shutdown = renard_phy_s2lp_hal_replay_shutdown,
+	.interrupt_timeout = renard_phy_s2lp_hal_replay_interrupt_timeout,
+	.interrupt_gpio = renard_phy_s2lp_hal_replay_interrupt_gpio,
+	.interrupt_clear = renard_phy_s2lp_hal_replay_interrupt_clear,
+	.interrupt_wait = renard_phy_s2lp_hal_replay_interrupt_wait,
+	.spi_async = renard_phy_s2lp_hal_replay_spi_async,
+	.interrupt_async = renard_phy_s2lp_hal_replay_interrupt_async,
+	.timestamp = renard_phy_s2lp_hal_replay_timestamp
+};
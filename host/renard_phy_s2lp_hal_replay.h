@@ -0,0 +1,96 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "renard_phy_s2lp_hal.h"
+#include "renard_phy_s2lp_hal_trace.h"
+
+/*
+ * renard-phy-s2lp-hal-replay - Trace reader and HAL that replays a recorded trace to renard-phy-s2lp
+ *
+ * Traces recorded by renard-phy-s2lp-hal-trace (see renard_phy_s2lp_hal_trace.h for the format) are memory-mapped and
+ * parsed in place, one record at a time, so that even long field captures can be read without copying them.
+ *
+ * The replay HAL serves a trace back to the driver without hardware: Every HAL call has to match the next record
+ * (same call, same arguments, same MOSI bytes), SPI reads return the recorded MISO bytes, interrupt waits the recorded
+ * result and timestamps the recorded time. The first call that does not match is reported as divergence, after which
+ * SPI reads return zeros and interrupt waits report timeouts, so that the driver returns as soon as possible.
+ * Replaying the same sequence of driver calls that was recorded must consume the whole trace without divergence.
+ */
+
+#ifndef _RENARD_PHY_S2LP_HAL_REPLAY_H
+#define _RENARD_PHY_S2LP_HAL_REPLAY_H
+
+/*
+ * Single decoded record, pointers point into the trace
+ * time: Absolute time in us (wrapped HAL's timestamp)
+ * value: SHUTDOWN / GPIO / WAIT: payload byte, TIMEOUT: milliseconds
+ * miso: NULL if the driver did not read MISO
+ * offset: Position of the record in the trace
+ */
+typedef struct
+{
+	renard_phy_s2lp_trace_type_t type;
+	uint32_t time;
+	uint32_t value;
+	uint8_t length;
+	const uint8_t *mosi;
+	const uint8_t *miso;
+	size_t offset;
+} renard_phy_s2lp_trace_record_t;
+
+/*
+ * Trace reader, all members are private except for index (number of records read so far) and malformed (set if the
+ * trace ended in the middle of a record or contains an unknown record type)
+ */
+typedef struct
+{
+	const uint8_t *data;
+	size_t size;
+	bool mapped;
+
+	size_t offset;
+	uint32_t time;
+	uint32_t index;
+	bool malformed;
+} renard_phy_s2lp_trace_t;
+
+/*
+ * renard_phy_s2lp_trace_open: Memory-map trace file, returns false if it cannot be read or has no valid header
+ * renard_phy_s2lp_trace_buffer: Read trace from memory instead, data must remain valid until the trace is closed
+ * renard_phy_s2lp_trace_close: Unmap trace file
+ * renard_phy_s2lp_trace_rewind: Continue reading from the first record
+ * renard_phy_s2lp_trace_next: Decode next record, returns false at the end of the trace or if it is malformed
+ * renard_phy_s2lp_trace_type_name: Name of record type, e.g. for printing
+ */
+bool renard_phy_s2lp_trace_open(renard_phy_s2lp_trace_t *trace, const char *path);
+bool renard_phy_s2lp_trace_buffer(renard_phy_s2lp_trace_t *trace, const uint8_t *data, size_t size);
+void renard_phy_s2lp_trace_close(renard_phy_s2lp_trace_t *trace);
+void renard_phy_s2lp_trace_rewind(renard_phy_s2lp_trace_t *trace);
+bool renard_phy_s2lp_trace_next(renard_phy_s2lp_trace_t *trace, renard_phy_s2lp_trace_record_t *record);
+const char *renard_phy_s2lp_trace_type_name(renard_phy_s2lp_trace_type_t type);
+
+/*
+ * Replay HAL instance, all members are private
+ */
+typedef struct
+{
+	renard_phy_s2lp_trace_t trace;
+	uint32_t time;
+
+	bool diverged;
+	char error[128];
+} renard_phy_s2lp_hal_replay_t;
+
+extern const renard_phy_s2lp_hal_t renard_phy_s2lp_hal_replay_functions;
+
+/*
+ * renard_phy_s2lp_hal_replay_open: Open trace file to replay, pass renard_phy_s2lp_hal_replay_functions and the
+ *   instance to renard_phy_s2lp_init. Returns false if the trace cannot be opened.
+ * renard_phy_s2lp_hal_replay_finish: Check that the driver has consumed the whole trace, returns NULL if it did and
+ *   never diverged, a description of the first divergence otherwise. Closes the trace.
+ */
+bool renard_phy_s2lp_hal_replay_open(renard_phy_s2lp_hal_replay_t *replay, const char *path);
+const char *renard_phy_s2lp_hal_replay_finish(renard_phy_s2lp_hal_replay_t *replay);
+
+#endif
@@ -0,0 +1,606 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "s2lp_registers.h"
+#include "s2lp_emu.h"
+
+/*
+ * SPI header bytes, see datasheet "6.3 SPI interface"
+ */
+#define SPI_HEADER_WRITE 0x00
+#define SPI_HEADER_READ 0x01
+#define SPI_HEADER_COMMAND 0x80
+
+/*
+ * Registers from MC_STATE1 upwards are status registers, writes to them are ignored (except for the FIFO)
+ */
+#define STATUS_REGISTERS_ADDR MC_STATE1_ADDR
+
+/*
+ * IRQ numbers (bit positions in IRQ_MASK3..0 / IRQ_STATUS3..0), see datasheet "7.4 Interrupts" - Table 50
+ */
+#define IRQ_RX_DATA_READY 0
+#define IRQ_TX_FIFO_ERROR 5
+#define IRQ_RX_TIMEOUT 28
+
+/*
+ * GPIO_SELECT values for digital outputs, see datasheet "7.3 GPIOs" - Table 48
+ */
+#define GPIO_SELECT_NIRQ 0
+#define GPIO_SELECT_TX_FIFO_ALMOST_EMPTY 6
+
+/*
+ * RC oscillator that clocks the wake-up timer in LDC mode, PROTOCOL1 / PROTOCOL2 bits, see datasheet "5.7 Timers"
+ */
+#define RCO_FREQ 33333
+#define PROTOCOL1_LDC_MODE 0x80
+#define PROTOCOL2_CS_TIMEOUT_MASK 0x80
+
+/*
+ * RSSI_TH and RSSI_LEVEL report RSSI in dBm with an offset of 146
+ */
+#define RSSI_OFFSET 146
+
+/*
+ * Reset values of the registers renard-phy-s2lp touches, see datasheet "10 Register Contents" - Table 62.
+ * All other registers are reset to 0.
+ */
+static const uint8_t por_values[][2] = {
+	{GPIO0_CONF_ADDR, 0x0a}, {GPIO1_CONF_ADDR, 0xa2}, {GPIO2_CONF_ADDR, 0xa2}, {GPIO3_CONF_ADDR, 0xa2},
+	{SYNT3_ADDR, 0x42}, {SYNT2_ADDR, 0x16}, {SYNT1_ADDR, 0x27}, {SYNT0_ADDR, 0x62},
+	{MOD4_ADDR, 0x83}, {MOD3_ADDR, 0x2b}, {MOD2_ADDR, 0x77}, {MOD1_ADDR, 0x03}, {MOD0_ADDR, 0x93},
+	{CHFLT_ADDR, 0x23}, {AFC2_ADDR, 0xc8}, {RSSI_TH_ADDR, 0x28}, {CLOCKREC2_ADDR, 0xc0}, {CLOCKREC1_ADDR, 0x58},
+	{PCKTCTRL6_ADDR, 0x80}, {PCKTCTRL3_ADDR, 0x20}, {PCKTCTRL1_ADDR, 0x30}, {PCKTLEN0_ADDR, 0x14},
+	{SYNC3_ADDR, 0x88}, {SYNC2_ADDR, 0x88}, {SYNC1_ADDR, 0x88}, {SYNC0_ADDR, 0x88},
+	{FIFO_CONFIG3_ADDR, 0x30}, {FIFO_CONFIG2_ADDR, 0x30}, {FIFO_CONFIG1_ADDR, 0x30}, {FIFO_CONFIG0_ADDR, 0x30},
+	{PA_POWER0_ADDR, 0x47}, {PA_CONFIG1_ADDR, 0x03}, {PA_CONFIG0_ADDR, 0x8a}, {SYNTH_CONFIG2_ADDR, 0xd0},
+	{XO_RCO_CONF1_ADDR, 0x45}, {XO_RCO_CONF0_ADDR, 0x30},
+	{DEVICE_INFO1_ADDR, 0x03}, {DEVICE_INFO0_ADDR, 0xc1}
+};
+
+/**********************************************************************************************************************/
+
+/*
+ * Private helper functions
+ */
+static void s2lp_emu_por(s2lp_emu_t *emu)
+{
+	memset(emu->regs, 0, sizeof(emu->regs));
+	for (size_t i = 0; i < sizeof(por_values) / sizeof(por_values[0]); i++)
+		emu->regs[por_values[i][0]] = por_values[i][1];
+
+	emu->state = S2LP_EMU_STATE_READY;
+	emu->tx_fifo_head = emu->tx_fifo_level = 0;
+	emu->rx_fifo_head = emu->rx_fifo_level = 0;
+	emu->rx_timeout = S2LP_EMU_TIME_NEVER;
+	emu->ldc_wakeup = S2LP_EMU_TIME_NEVER;
+}
+
+static void s2lp_emu_irq(s2lp_emu_t *emu, uint8_t irq)
+{
+	/* IRQ_STATUS only latches events that are enabled in IRQ_MASK */
+	uint8_t offset = 3 - irq / 8;
+	uint8_t bit = 1 << (irq % 8);
+
+	if (emu->regs[IRQ_MASK3_ADDR + offset] & bit)
+		emu->regs[IRQ_STATUS3_ADDR + offset] |= bit;
+}
+
+/*
+ * Digital domain clock: f_XO, or f_XO / 2 unless the divider is disabled in XO_RCO_CONF1
+ */
+static double s2lp_emu_f_dig(const s2lp_emu_t *emu)
+{
+	return emu->config.xtal_freq / ((emu->regs[XO_RCO_CONF1_ADDR] & 0x10) ? 1.0 : 2.0);
+}
+
+/*
+ * DataRate = f_dig * (2^16 + DATARATE_M) * 2^DATARATE_E / 2^33 (datasheet "5.4.5 Data rate" - Eq. 14)
+ */
+static double s2lp_emu_datarate(const s2lp_emu_t *emu)
+{
+	uint16_t rate_m = (emu->regs[MOD4_ADDR] << 8) | emu->regs[MOD3_ADDR];
+	uint8_t rate_e = emu->regs[MOD2_ADDR] & 0x0f;
+	double f_dig = s2lp_emu_f_dig(emu);
+
+	if (rate_e == 0)
+		return f_dig * rate_m / 4294967296.0;
+
+	return f_dig * (65536.0 + rate_m) * (double)(1 << rate_e) / 8589934592.0;
+}
+
+/*
+ * Byte couple sample period in direct polar mode: Byte couples are sampled at 8 times the data rate
+ */
+static double s2lp_emu_sample_period(const s2lp_emu_t *emu)
+{
+	return 1e9 / (8 * s2lp_emu_datarate(emu));
+}
+
+static uint64_t s2lp_emu_next_sample(const s2lp_emu_t *emu, uint32_t samples)
+{
+	return emu->tx_start + (uint64_t)((emu->tx_samples + samples) * emu->tx_sample_period);
+}
+
+/*
+ * Sample at which the TX FIFO level drops to the almost empty threshold or, below the threshold, the FIFO runs dry.
+ * Samples before it only consume byte couples, so nothing that the MCU can see (GPIOs, IRQ status) changes.
+ */
+static uint64_t s2lp_emu_next_tx_event(const s2lp_emu_t *emu)
+{
+	uint8_t threshold = emu->regs[FIFO_CONFIG0_ADDR];
+
+	if (emu->tx_fifo_level > threshold)
+		return s2lp_emu_next_sample(emu, (emu->tx_fifo_level - threshold + 1) / 2);
+
+	return s2lp_emu_next_sample(emu, emu->tx_fifo_level / 2 + 1);
+}
+
+static void s2lp_emu_tx_sample(s2lp_emu_t *emu)
+{
+	if (emu->tx_fifo_level >= 2) {
+		s2lp_emu_capture_t *capture = emu->tx_capture;
+		if (capture != NULL && capture->length + 2 <= capture->size) {
+			capture->buffer[capture->length++] = emu->tx_fifo[emu->tx_fifo_head];
+			capture->buffer[capture->length++] = emu->tx_fifo[(emu->tx_fifo_head + 1) % S2LP_EMU_FIFO_SIZE];
+		}
+
+		/* Only bursts whose TX command was recorded, i.e. not beyond S2LP_EMU_CAPTURE_BURSTS */
+		if (capture != NULL && capture->bursts > 0 && capture->burst_time[capture->bursts - 1] == emu->tx_start)
+			capture->burst_end[capture->bursts - 1] = s2lp_emu_next_sample(emu, 1);
+
+		emu->tx_fifo_head = (emu->tx_fifo_head + 2) % S2LP_EMU_FIFO_SIZE;
+		emu->tx_fifo_level -= 2;
+		emu->stats.tx_fifo_bytes += 2;
+	} else {
+		/*
+		 * The FIFO ran dry while the modulator still needed a byte couple. renard-phy-s2lp lowers the almost empty
+		 * threshold to zero before it lets the FIFO drain at the end of a frame, only count underruns before that.
+		 */
+		s2lp_emu_irq(emu, IRQ_TX_FIFO_ERROR);
+		if (emu->regs[FIFO_CONFIG0_ADDR] != 0)
+			emu->stats.tx_fifo_underruns++;
+	}
+
+	emu->tx_samples++;
+}
+
+/*
+ * Time at which the frame's SYNC word started, 0 if the frame has no timing information (preamble_ns = 0)
+ */
+static uint64_t s2lp_emu_sync_start(const s2lp_emu_t *emu, const s2lp_emu_rx_frame_t *frame)
+{
+	if (frame->preamble_ns == 0)
+		return 0;
+
+	uint64_t duration = (uint64_t)((2 + frame->length) * 8 * 1e9 / s2lp_emu_datarate(emu));
+	return frame->time > duration ? frame->time - duration : 0;
+}
+
+/*
+ * Carrier sense: Whether the preamble of a frame with an RSSI of at least RSSI_TH was on air while RX was active
+ */
+static bool s2lp_emu_carrier(const s2lp_emu_t *emu)
+{
+	for (uint8_t i = 0; i < emu->rx_queue_length; i++) {
+		const s2lp_emu_rx_frame_t *frame = &emu->rx_queue[i];
+		uint64_t sync_start = s2lp_emu_sync_start(emu, frame);
+
+		if (frame->preamble_ns == 0 || frame->rssi + RSSI_OFFSET < emu->regs[RSSI_TH_ADDR])
+			continue;
+
+		if (sync_start <= emu->now + frame->preamble_ns && sync_start >= emu->rx_since)
+			return true;
+	}
+
+	return false;
+}
+
+static void s2lp_emu_rx_frame(s2lp_emu_t *emu, const s2lp_emu_rx_frame_t *frame)
+{
+	uint32_t frequency = s2lp_emu_frequency(emu);
+	uint32_t offset = frequency > frame->frequency ? frequency - frame->frequency : frame->frequency - frequency;
+
+	if (frame->frequency != 0 && offset > 1000) {
+		emu->stats.rx_missed++;
+		return;
+	}
+
+	/* Frame was already (partially) on air when RX started: SYNC word missed */
+	if (frame->time < emu->rx_since || (frame->preamble_ns != 0 && s2lp_emu_sync_start(emu, frame) < emu->rx_since)) {
+		emu->stats.rx_missed++;
+		return;
+	}
+
+	/* Direct through FIFO mode is not used for RX, so exactly PCKTLEN bytes end up in the FIFO */
+	uint16_t length = (emu->regs[PCKTLEN1_ADDR] << 8) | emu->regs[PCKTLEN0_ADDR];
+	if (length > frame->length)
+		length = frame->length;
+
+	for (uint16_t i = 0; i < length && emu->rx_fifo_level < S2LP_EMU_FIFO_SIZE; i++) {
+		emu->rx_fifo[(emu->rx_fifo_head + emu->rx_fifo_level) % S2LP_EMU_FIFO_SIZE] = frame->frame[i];
+		emu->rx_fifo_level++;
+	}
+
+	int16_t rssi_level = frame->rssi + RSSI_OFFSET;
+	emu->regs[RSSI_LEVEL_ADDR] = rssi_level < 0 ? 0 : (rssi_level > 255 ? 255 : rssi_level);
+	emu->regs[RX_FIFO_STATUS_ADDR] = emu->rx_fifo_level;
+
+	s2lp_emu_irq(emu, IRQ_RX_DATA_READY);
+	emu->state = S2LP_EMU_STATE_READY;
+	emu->rx_timeout = S2LP_EMU_TIME_NEVER;
+	emu->ldc_wakeup = S2LP_EMU_TIME_NEVER;
+	emu->stats.rx_frames++;
+}
+
+/*
+ * RX timer: Expires RX_TIMER_CNTR * (RX_TIMER_PRESC + 1) * 1210 / f_dig after RX has started, RX_TIMER_CNTR = 0
+ * disables it (datasheet "5.7.2 RX timer"). Frames are only modelled as a whole, so a frame that is completely
+ * received before the timer expires always stops it, as if the SYNC word stop condition were configured. With the
+ * carrier sense stop condition (PROTOCOL2), the timer is also stopped if a carrier was present while listening.
+ * In LDC mode, the S2-LP goes to SLEEP after the RX timer has expired and the wake-up timer restarts RX after
+ * (LDC_TIMER_PRESC + 1) * (LDC_TIMER_CNTR + 1) / f_RCO, counted from the previous start.
+ */
+static void s2lp_emu_rx_start(s2lp_emu_t *emu)
+{
+	uint32_t ticks = (uint32_t)emu->regs[TIMERS5_ADDR] * (emu->regs[TIMERS4_ADDR] + 1);
+
+	emu->state = S2LP_EMU_STATE_RX;
+	emu->rx_since = emu->now;
+	emu->rx_timeout = S2LP_EMU_TIME_NEVER;
+	if (ticks != 0)
+		emu->rx_timeout = emu->now + (uint64_t)(ticks * 1210 * 1e9 / s2lp_emu_f_dig(emu));
+
+	if (emu->regs[PROTOCOL1_ADDR] & PROTOCOL1_LDC_MODE) {
+		uint32_t period = (uint32_t)(emu->regs[TIMERS3_ADDR] + 1) * (emu->regs[TIMERS2_ADDR] + 1);
+		emu->ldc_wakeup = emu->now + (uint64_t)period * 1000000000 / RCO_FREQ;
+	}
+}
+
+static void s2lp_emu_rx_timer_expired(s2lp_emu_t *emu)
+{
+	if ((emu->regs[PROTOCOL2_ADDR] & PROTOCOL2_CS_TIMEOUT_MASK) && s2lp_emu_carrier(emu)) {
+		emu->rx_timeout = S2LP_EMU_TIME_NEVER;
+		return;
+	}
+
+	s2lp_emu_irq(emu, IRQ_RX_TIMEOUT);
+	emu->state = emu->ldc_wakeup != S2LP_EMU_TIME_NEVER ? S2LP_EMU_STATE_SLEEP : S2LP_EMU_STATE_READY;
+	emu->rx_timeout = S2LP_EMU_TIME_NEVER;
+}
+
+static void s2lp_emu_command(s2lp_emu_t *emu, uint8_t cmd)
+{
+	emu->stats.commands++;
+
+	/* Every command but the FIFO flushes ends reception and LDC mode */
+	if (cmd != CMD_FLUSHRXFIFO && cmd != CMD_FLUSHTXFIFO) {
+		emu->rx_timeout = S2LP_EMU_TIME_NEVER;
+		emu->ldc_wakeup = S2LP_EMU_TIME_NEVER;
+	}
+
+	switch (cmd) {
+		case CMD_TX:
+			emu->state = S2LP_EMU_STATE_TX;
+			emu->tx_start = emu->now;
+			emu->tx_samples = 0;
+			emu->tx_sample_period = s2lp_emu_sample_period(emu);
+			if (emu->tx_capture != NULL && emu->tx_capture->bursts < S2LP_EMU_CAPTURE_BURSTS) {
+				s2lp_emu_capture_t *capture = emu->tx_capture;
+				capture->burst_start[capture->bursts] = capture->length;
+				capture->burst_time[capture->bursts] = emu->now;
+				capture->burst_end[capture->bursts] = emu->now;
+				capture->burst_frequency[capture->bursts] = s2lp_emu_frequency(emu);
+				capture->bursts++;
+			}
+			break;
+
+		case CMD_RX:
+			s2lp_emu_rx_start(emu);
+			break;
+
+		case CMD_READY:
+		case CMD_SABORT:
+			emu->state = S2LP_EMU_STATE_READY;
+			break;
+
+		case CMD_STANDBY:
+			if (emu->state == S2LP_EMU_STATE_READY)
+				emu->state = S2LP_EMU_STATE_STANDBY;
+			break;
+
+		case CMD_SLEEP:
+			if (emu->state == S2LP_EMU_STATE_READY)
+				emu->state = S2LP_EMU_STATE_SLEEP;
+			break;
+
+		case CMD_LOCKRX:
+		case CMD_LOCKTX:
+			emu->state = S2LP_EMU_STATE_LOCK;
+			break;
+
+		case CMD_SRES:
+			s2lp_emu_por(emu);
+			break;
+
+		case CMD_FLUSHRXFIFO:
+			emu->rx_fifo_head = emu->rx_fifo_level = 0;
+			break;
+
+		case CMD_FLUSHTXFIFO:
+			emu->tx_fifo_head = emu->tx_fifo_level = 0;
+			break;
+	}
+}
+
+static void s2lp_emu_write(s2lp_emu_t *emu, uint8_t address, uint8_t value)
+{
+	if (address == FIFO_ADDR) {
+		if (emu->tx_fifo_level == S2LP_EMU_FIFO_SIZE) {
+			emu->stats.tx_fifo_overflows++;
+			return;
+		}
+
+		emu->tx_fifo[(emu->tx_fifo_head + emu->tx_fifo_level) % S2LP_EMU_FIFO_SIZE] = value;
+		emu->tx_fifo_level++;
+	} else if (address < STATUS_REGISTERS_ADDR) {
+		emu->regs[address] = value;
+	}
+}
+
+static uint8_t s2lp_emu_read(s2lp_emu_t *emu, uint8_t address)
+{
+	uint8_t value;
+
+	switch (address) {
+		case FIFO_ADDR:
+			if (emu->rx_fifo_level == 0)
+				return 0x00;
+
+			value = emu->rx_fifo[emu->rx_fifo_head];
+			emu->rx_fifo_head = (emu->rx_fifo_head + 1) % S2LP_EMU_FIFO_SIZE;
+			emu->rx_fifo_level--;
+			return value;
+
+		case MC_STATE0_ADDR:
+			/* XO_ON: The crystal oscillator is off in STANDBY and SLEEP */
+			return (emu->state << 1) |
+					(emu->state == S2LP_EMU_STATE_STANDBY || emu->state == S2LP_EMU_STATE_SLEEP ? 0x00 : 0x01);
+
+		case TX_FIFO_STATUS_ADDR:
+			return emu->tx_fifo_level;
+
+		case RX_FIFO_STATUS_ADDR:
+			return emu->rx_fifo_level;
+
+		case IRQ_STATUS3_ADDR:
+		case IRQ_STATUS2_ADDR:
+		case IRQ_STATUS1_ADDR:
+		case IRQ_STATUS0_ADDR:
+			value = emu->regs[address];
+			emu->regs[address] = 0;
+			return value;
+
+		default:
+			return emu->regs[address];
+	}
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Public interface
+ */
+void s2lp_emu_init(s2lp_emu_t *emu, const s2lp_emu_config_t *config)
+{
+	memset(emu, 0, sizeof(*emu));
+	emu->config = *config;
+	emu->state = S2LP_EMU_STATE_SHUTDOWN;
+	emu->rx_timeout = S2LP_EMU_TIME_NEVER;
+	emu->ldc_wakeup = S2LP_EMU_TIME_NEVER;
+}
+
+void s2lp_emu_shutdown(s2lp_emu_t *emu, bool shutdown)
+{
+	if (shutdown) {
+		emu->state = S2LP_EMU_STATE_SHUTDOWN;
+		emu->rx_timeout = S2LP_EMU_TIME_NEVER;
+		emu->ldc_wakeup = S2LP_EMU_TIME_NEVER;
+	} else if (emu->state == S2LP_EMU_STATE_SHUTDOWN) {
+		s2lp_emu_por(emu);
+	}
+}
+
+void s2lp_emu_spi(s2lp_emu_t *emu, uint8_t length, const uint8_t *mosi, uint8_t *miso)
+{
+	uint64_t duration = emu->config.spi_overhead_ns;
+	if (emu->config.spi_clock != 0)
+		duration += (uint64_t)length * 8 * 1000000000 / emu->config.spi_clock;
+
+	/* The transaction only takes effect once chip select is released */
+	s2lp_emu_advance(emu, emu->now + duration);
+	emu->stats.spi_transactions++;
+	emu->stats.spi_bytes += length;
+
+	uint8_t status[2] = {emu->state == S2LP_EMU_STATE_SHUTDOWN ? 0x00 : s2lp_emu_read(emu, MC_STATE1_ADDR),
+			emu->state == S2LP_EMU_STATE_SHUTDOWN ? 0x00 : s2lp_emu_read(emu, MC_STATE0_ADDR)};
+
+	if (miso != NULL)
+		memset(miso, 0, length);
+
+	if (emu->state == S2LP_EMU_STATE_SHUTDOWN || length < 2)
+		return;
+
+	if (miso != NULL) {
+		miso[0] = status[0];
+		miso[1] = status[1];
+	}
+
+	if (mosi[0] == SPI_HEADER_COMMAND) {
+		s2lp_emu_command(emu, mosi[1]);
+		return;
+	}
+
+	/* Burst accesses auto-increment the register address, except for the FIFO */
+	uint8_t address = mosi[1];
+	for (uint8_t i = 2; i < length; i++) {
+		if (mosi[0] == SPI_HEADER_WRITE)
+			s2lp_emu_write(emu, address, mosi[i]);
+		else if (mosi[0] == SPI_HEADER_READ && miso != NULL)
+			miso[i] = s2lp_emu_read(emu, address);
+
+		if (address != FIFO_ADDR)
+			address++;
+	}
+}
+
+/*
+ * Time of the next state change, every single modulator sample while transmitting
+ */
+static uint64_t s2lp_emu_next_step(const s2lp_emu_t *emu)
+{
+	if (emu->state == S2LP_EMU_STATE_TX)
+		return s2lp_emu_next_sample(emu, 1);
+
+	return s2lp_emu_next_event(emu);
+}
+
+void s2lp_emu_advance(s2lp_emu_t *emu, uint64_t time)
+{
+	uint64_t next;
+
+	while ((next = s2lp_emu_next_step(emu)) <= time) {
+		emu->stats.state_ns[s2lp_emu_power(emu)] += next - emu->now;
+		emu->now = next;
+
+		if (emu->state == S2LP_EMU_STATE_TX) {
+			s2lp_emu_tx_sample(emu);
+		} else if (emu->state == S2LP_EMU_STATE_SLEEP) {
+			s2lp_emu_rx_start(emu);
+		} else if (emu->rx_queue_length == 0 || emu->rx_queue[0].time > emu->rx_timeout) {
+			s2lp_emu_rx_timer_expired(emu);
+		} else {
+			s2lp_emu_rx_frame(emu, &emu->rx_queue[0]);
+			emu->rx_queue_length--;
+			memmove(&emu->rx_queue[0], &emu->rx_queue[1], emu->rx_queue_length * sizeof(emu->rx_queue[0]));
+		}
+	}
+
+	/* Downlink frames that arrive while the S2-LP is not listening are lost */
+	while (emu->rx_queue_length > 0 && emu->rx_queue[0].time <= time) {
+		emu->stats.rx_missed++;
+		emu->rx_queue_length--;
+		memmove(&emu->rx_queue[0], &emu->rx_queue[1], emu->rx_queue_length * sizeof(emu->rx_queue[0]));
+	}
+
+	if (time > emu->now) {
+		emu->stats.state_ns[s2lp_emu_power(emu)] += time - emu->now;
+		emu->now = time;
+	}
+}
+
+uint64_t s2lp_emu_next_event(const s2lp_emu_t *emu)
+{
+	if (emu->state == S2LP_EMU_STATE_TX)
+		return s2lp_emu_next_tx_event(emu);
+
+	if (emu->state == S2LP_EMU_STATE_SLEEP)
+		return emu->ldc_wakeup;
+
+	if (emu->state != S2LP_EMU_STATE_RX)
+		return S2LP_EMU_TIME_NEVER;
+
+	uint64_t frame = S2LP_EMU_TIME_NEVER;
+	if (emu->rx_queue_length > 0)
+		frame = emu->rx_queue[0].time < emu->now ? emu->now : emu->rx_queue[0].time;
+
+	return frame < emu->rx_timeout ? frame : emu->rx_timeout;
+}
+
+bool s2lp_emu_gpio(const s2lp_emu_t *emu, uint8_t gpio)
+{
+	if (emu->state == S2LP_EMU_STATE_SHUTDOWN)
+		return false;
+
+	uint8_t conf = emu->regs[GPIO0_CONF_ADDR + gpio];
+	bool irq;
+
+	switch (conf >> 3) {
+		case GPIO_SELECT_NIRQ:
+			/* nIRQ is active low */
+			irq = (emu->regs[IRQ_STATUS3_ADDR] & emu->regs[IRQ_MASK3_ADDR]) ||
+					(emu->regs[IRQ_STATUS2_ADDR] & emu->regs[IRQ_MASK2_ADDR]) ||
+					(emu->regs[IRQ_STATUS1_ADDR] & emu->regs[IRQ_MASK1_ADDR]) ||
+					(emu->regs[IRQ_STATUS0_ADDR] & emu->regs[IRQ_MASK0_ADDR]);
+			return !irq;
+
+		case GPIO_SELECT_TX_FIFO_ALMOST_EMPTY:
+			return emu->tx_fifo_level <= emu->regs[FIFO_CONFIG0_ADDR];
+
+		default:
+			return false;
+	}
+}
+
+/*
+ * Carrier frequency according to datasheet "5.3.1 RF channel frequency settings" (Eq. 7) with B = 4, D = 1, CHNUM = 0
+ */
+uint32_t s2lp_emu_frequency(const s2lp_emu_t *emu)
+{
+	uint32_t synth = ((uint32_t)(emu->regs[SYNT3_ADDR] & 0x0f) << 24) | ((uint32_t)emu->regs[SYNT2_ADDR] << 16) |
+			((uint32_t)emu->regs[SYNT1_ADDR] << 8) | emu->regs[SYNT0_ADDR];
+
+	return (uint64_t)synth * emu->config.xtal_freq / ((uint64_t)1 << 21);
+}
+
+bool s2lp_emu_rx_schedule(s2lp_emu_t *emu, const s2lp_emu_rx_frame_t *frame)
+{
+	if (emu->rx_queue_length == S2LP_EMU_RX_QUEUE_LENGTH)
+		return false;
+
+	/* Keep queue sorted by reception time */
+	uint8_t i = emu->rx_queue_length;
+	while (i > 0 && emu->rx_queue[i - 1].time > frame->time) {
+		emu->rx_queue[i] = emu->rx_queue[i - 1];
+		i--;
+	}
+
+	emu->rx_queue[i] = *frame;
+	emu->rx_queue_length++;
+
+	return true;
+}
+
+s2lp_emu_power_t s2lp_emu_power(const s2lp_emu_t *emu)
+{
+	switch (emu->state) {
+		case S2LP_EMU_STATE_SHUTDOWN:
+			return S2LP_EMU_POWER_SHUTDOWN;
+		case S2LP_EMU_STATE_STANDBY:
+			return S2LP_EMU_POWER_STANDBY;
+		case S2LP_EMU_STATE_SLEEP:
+			return S2LP_EMU_POWER_SLEEP;
+		case S2LP_EMU_STATE_LOCK:
+			return S2LP_EMU_POWER_LOCK;
+		case S2LP_EMU_STATE_RX:
+			return S2LP_EMU_POWER_RX;
+		case S2LP_EMU_STATE_TX:
+			return S2LP_EMU_POWER_TX;
+		default:
+			return S2LP_EMU_POWER_READY;
+	}
+}
+
+double s2lp_emu_charge(const s2lp_emu_t *emu, s2lp_emu_power_t power)
+{
+	double charge = 0;
+
+	/* ns * uA = 1e-9 uC */
+	for (uint8_t i = 0; i < S2LP_EMU_POWER_COUNT; i++) {
+		if (power == S2LP_EMU_POWER_COUNT || power == i)
+			charge += emu->stats.state_ns[i] * emu->config.current_ua[i] / 1e9;
+	}
+
+	return charge;
+}
@@ -0,0 +1,182 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * s2lp-emu - Host-side S2-LP emulator
+ *
+ * Emulates just enough of the S2-LP for renard-phy-s2lp to run on a host machine without hardware:
+ * --> the 256-entry register file with auto-increment burst access
+ * --> the 128-byte TX FIFO, drained in direct polar mode at the byte couple rate configured in MOD4..MOD2
+ * --> the 128-byte RX FIFO, filled by downlink frames that the user schedules in advance
+ * --> IRQ_MASK / IRQ_STATUS semantics (clear on read) and the GPIO3 output (FIFO almost empty flag or nIRQ)
+ * --> the RX timer (TIMERS5..4), which ends reception unless a frame is received before it expires or, with the carrier
+ *     sense stop condition, a carrier above RSSI_TH is present
+ * --> low duty cycle (LDC) mode: the wake-up timer (TIMERS3..2) restarts RX periodically from SLEEP, so that together
+ *     with the RX timer and carrier sense the receiver only sniffs for downlinks
+ * --> optional capture of the modulator output (frequency and power byte couples), e.g. for demodulating uplinks
+ * --> the commands issued by renard-phy-s2lp (TX, RX, READY, STANDBY, SLEEP, SABORT, SRES, FLUSHRXFIFO, FLUSHTXFIFO)
+ *
+ * Time is virtual and measured in nanoseconds. It only advances when the HAL asks the emulator to (SPI transactions,
+ * interrupt waits), so that results do not depend on the speed of the host machine. The time spent in every power
+ * state is accounted for, so that together with the configured supply currents the S2-LP's charge consumption can be
+ * estimated.
+ */
+
+#ifndef _S2LP_EMU_H
+#define _S2LP_EMU_H
+
+#define S2LP_EMU_FIFO_SIZE 128
+#define S2LP_EMU_RX_QUEUE_LENGTH 8
+#define S2LP_EMU_TIME_NEVER UINT64_MAX
+
+/* Main controller states, values as reported in MC_STATE0 (see datasheet "6.2 State diagram") */
+typedef enum
+{
+	S2LP_EMU_STATE_READY = 0x00,
+	S2LP_EMU_STATE_SLEEP = 0x01,
+	S2LP_EMU_STATE_STANDBY = 0x02,
+	S2LP_EMU_STATE_LOCK = 0x0c,
+	S2LP_EMU_STATE_RX = 0x30,
+	S2LP_EMU_STATE_TX = 0x5c,
+	S2LP_EMU_STATE_SHUTDOWN = 0xff
+} s2lp_emu_state_t;
+
+/* Power states for energy accounting, see s2lp_emu_config_t.current_ua and s2lp_emu_stats_t.state_ns */
+typedef enum
+{
+	S2LP_EMU_POWER_SHUTDOWN = 0,
+	S2LP_EMU_POWER_STANDBY,
+	S2LP_EMU_POWER_SLEEP,
+	S2LP_EMU_POWER_READY,
+	S2LP_EMU_POWER_LOCK,
+	S2LP_EMU_POWER_RX,
+	S2LP_EMU_POWER_TX,
+	S2LP_EMU_POWER_COUNT
+} s2lp_emu_power_t;
+
+typedef struct
+{
+	/* S2-LP crystal frequency in Hz */
+	uint32_t xtal_freq;
+
+	/* SPI clock in Hz and fixed cost per transaction (chip select, HAL), 0 means SPI takes no time at all */
+	uint32_t spi_clock;
+	uint32_t spi_overhead_ns;
+
+	/* Time between a GPIO edge and the driver running again after renard_phy_s2lp_interrupt_wait */
+	uint32_t isr_latency_ns;
+
+	/* Supply current in uA per power state, only used by s2lp_emu_charge */
+	double current_ua[S2LP_EMU_POWER_COUNT];
+} s2lp_emu_config_t;
+
+typedef struct
+{
+	uint32_t spi_transactions;
+	uint32_t spi_bytes;
+	uint32_t commands;
+	uint32_t tx_fifo_bytes;
+	uint32_t tx_fifo_underruns;
+	uint32_t tx_fifo_overflows;
+	uint32_t rx_frames;
+	uint32_t rx_missed;
+
+	/* Virtual time spent in each power state */
+	uint64_t state_ns[S2LP_EMU_POWER_COUNT];
+} s2lp_emu_stats_t;
+
+/*
+ * Downlink frame scheduled for reception:
+ * time: virtual time at which the S2-LP has received the frame completely (RX_DATA_READY)
+ * frequency: carrier frequency in Hz, 0 matches any synthesizer setting
+ * rssi: RSSI in dBm reported through RSSI_LEVEL
+ * preamble_ns: duration of the preamble before the SYNC word. If not 0, the frame is only received if RX was already
+ *   active when its SYNC word started (SYNC word and frame are sent at the configured RX datarate) and the preamble
+ *   can be detected by carrier sense. If 0, the frame is received if the S2-LP is in RX at time.
+ */
+typedef struct
+{
+	uint64_t time;
+	uint32_t frequency;
+	int16_t rssi;
+	uint8_t length;
+	uint8_t frame[S2LP_EMU_FIFO_SIZE];
+	uint32_t preamble_ns;
+} s2lp_emu_rx_frame_t;
+
+/*
+ * Capture of the modulator output, see s2lp_emu_t.tx_capture: Every byte couple (frequency, power) that the S2-LP
+ * transmits in direct polar mode is appended to buffer until size bytes are used up. For each of the first
+ * S2LP_EMU_CAPTURE_BURSTS TX commands, burst_start is the buffer offset at which it started, burst_time and burst_end
+ * the virtual time of the TX command and of the end of its last byte couple, burst_frequency its carrier frequency.
+ * With size 0 (buffer may be NULL), only bursts are recorded. Clear length and bursts to start over.
+ */
+#define S2LP_EMU_CAPTURE_BURSTS 8
+
+typedef struct
+{
+	uint8_t *buffer;
+	uint32_t size;
+	uint32_t length;
+	uint32_t burst_start[S2LP_EMU_CAPTURE_BURSTS];
+	uint64_t burst_time[S2LP_EMU_CAPTURE_BURSTS];
+	uint64_t burst_end[S2LP_EMU_CAPTURE_BURSTS];
+	uint32_t burst_frequency[S2LP_EMU_CAPTURE_BURSTS];
+	uint8_t bursts;
+} s2lp_emu_capture_t;
+
+typedef struct
+{
+	s2lp_emu_config_t config;
+	s2lp_emu_stats_t stats;
+	uint64_t now;
+	s2lp_emu_state_t state;
+
+	uint8_t regs[256];
+
+	uint8_t tx_fifo[S2LP_EMU_FIFO_SIZE];
+	uint8_t tx_fifo_head;
+	uint8_t tx_fifo_level;
+	uint64_t tx_start;
+	uint64_t tx_samples;
+	double tx_sample_period;
+
+	/* Modulator output capture, NULL (disabled) after s2lp_emu_init */
+	s2lp_emu_capture_t *tx_capture;
+
+	uint8_t rx_fifo[S2LP_EMU_FIFO_SIZE];
+	uint8_t rx_fifo_head;
+	uint8_t rx_fifo_level;
+	s2lp_emu_rx_frame_t rx_queue[S2LP_EMU_RX_QUEUE_LENGTH];
+	uint8_t rx_queue_length;
+	uint64_t rx_since;
+	uint64_t rx_timeout;
+	uint64_t ldc_wakeup;
+} s2lp_emu_t;
+
+void s2lp_emu_init(s2lp_emu_t *emu, const s2lp_emu_config_t *config);
+void s2lp_emu_shutdown(s2lp_emu_t *emu, bool shutdown);
+void s2lp_emu_spi(s2lp_emu_t *emu, uint8_t length, const uint8_t *mosi, uint8_t *miso);
+
+/*
+ * s2lp_emu_advance: Advance virtual time, processing every modulator sample, RX timer expiry, ... until then
+ * s2lp_emu_next_event: Time of the next event that the MCU can observe (GPIO or IRQ status change), so that a HAL can
+ *   jump straight to it instead of stepping through virtual time. While transmitting, that is the TX FIFO reaching
+ *   the almost empty threshold or running dry, not every sample.
+ */
+void s2lp_emu_advance(s2lp_emu_t *emu, uint64_t time);
+uint64_t s2lp_emu_next_event(const s2lp_emu_t *emu);
+
+bool s2lp_emu_gpio(const s2lp_emu_t *emu, uint8_t gpio);
+uint32_t s2lp_emu_frequency(const s2lp_emu_t *emu);
+bool s2lp_emu_rx_schedule(s2lp_emu_t *emu, const s2lp_emu_rx_frame_t *frame);
+
+/*
+ * s2lp_emu_power: Power state that the S2-LP is currently in
+ * s2lp_emu_charge: Charge in uC drawn by the S2-LP in the given power state (S2LP_EMU_POWER_COUNT: all states) since
+ *   the statistics were last cleared, based on stats.state_ns and config.current_ua
+ */
+s2lp_emu_power_t s2lp_emu_power(const s2lp_emu_t *emu);
+double s2lp_emu_charge(const s2lp_emu_t *emu, s2lp_emu_power_t power);
+
+#endif
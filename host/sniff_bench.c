@@ -0,0 +1,157 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "renard_phy_s2lp_hal.h"
+#include "renard_phy_s2lp.h"
+#include "conf_driver.h"
+
+#include "renard_phy_s2lp_hal_emu.h"
+#include "s2lp_emu.h"
+
+/*
+ * sniff-bench - Miss rate and receive current of renard_phy_s2lp_rx in sniff mode
+ *
+ * Runs renard_phy_s2lp_rx against the emulator HAL, once with continuous reception and once for every sniff
+ * configuration (wake-up period, listening time, carrier sense threshold). For every configuration and downlink RSSI,
+ * SNIFF_BENCH_FRAMES downlinks, each with a Sigfox preamble, arrive at random times within the receive window. A
+ * downlink is missed if renard_phy_s2lp_rx does not return it before the HAL timeout.
+ *
+ * Output is CSV, one line per configuration and RSSI: miss rate, average S2-LP current while waiting for and receiving
+ * the downlink and the current saved compared to continuous reception at the same RSSI. All values are deterministic.
+ *
+ * Usage: sniff-bench (requires RENARD_PHY_S2LP_RX_SNIFF)
+ */
+
+#if (RENARD_PHY_S2LP_RX_SNIFF != 1)
+#error "sniff-bench requires RENARD_PHY_S2LP_RX_SNIFF"
+#endif
+
+#define SNIFF_BENCH_FRAMES 200
+#define SNIFF_BENCH_FREQUENCY 869525000
+#define SNIFF_BENCH_TIMEOUT_MS 2000
+
+/* Frame arrival (end of frame) within the window, late enough for the preamble and the frame to start after RX */
+#define SNIFF_BENCH_ARRIVAL_MIN_MS 500
+#define SNIFF_BENCH_ARRIVAL_MAX_MS 1500
+
+/* Sigfox downlink: 91 bit preamble at 600bps */
+#define SNIFF_BENCH_PREAMBLE_NS (91 * 1000000000ULL / 600)
+
+#define SNIFF_BENCH_FIELDS "mode,period_ms,listen_us,threshold_dbm,rssi_dbm,frames,missed,miss_rate,avg_current_ua," \
+		"saving_percent"
+
+static const renard_phy_s2lp_sniff_t SNIFF_BENCH_CONFIGS[] = {
+	{100, 4000, -125},
+	{100, 2000, -125},
+	{140, 4000, -125},
+	{50, 2000, -125},
+	{100, 4000, -115}
+};
+
+static const int16_t SNIFF_BENCH_RSSI[] = {-100, -110, -120, -125, -130};
+
+static uint32_t m_random = 0x5eed;
+static renard_phy_s2lp_hal_emu_t m_hal;
+static renard_phy_s2lp_t m_phy;
+
+/**********************************************************************************************************************/
+
+static uint32_t sniff_bench_random(uint32_t min, uint32_t max)
+{
+	m_random = m_random * 1103515245 + 12345;
+	return min + (m_random >> 8) % (max - min + 1);
+}
+
+/*
+ * Receive SNIFF_BENCH_FRAMES downlinks with the given RSSI, sniff NULL means continuous reception. Returns the number
+ * of missed downlinks, current is set to the average S2-LP current in uA.
+ */
+static uint32_t sniff_bench_run(const renard_phy_s2lp_sniff_t *sniff, int16_t rssi, double *current)
+{
+	s2lp_emu_t *emu = renard_phy_s2lp_hal_emu(&m_hal);
+	uint64_t virtual_ns = 0;
+	double charge = 0;
+	uint32_t missed = 0;
+
+	renard_phy_s2lp_rx_sniff(&m_phy, sniff);
+
+	for (uint32_t i = 0; i < SNIFF_BENCH_FRAMES; i++) {
+		s2lp_emu_rx_frame_t downlink;
+		uint8_t frame[15];
+		int16_t frame_rssi;
+
+		memset(&downlink, 0, sizeof(downlink));
+		downlink.time = emu->now + sniff_bench_random(SNIFF_BENCH_ARRIVAL_MIN_MS * 1000, SNIFF_BENCH_ARRIVAL_MAX_MS *
+				1000) * 1000ULL;
+		downlink.rssi = rssi;
+		downlink.length = sizeof(frame);
+		downlink.frame[0] = i;
+		downlink.preamble_ns = SNIFF_BENCH_PREAMBLE_NS;
+
+		renard_phy_s2lp_mode(&m_phy, S2LP_MODE_RX);
+		s2lp_emu_rx_schedule(emu, &downlink);
+
+		renard_phy_s2lp_hal_emu_stats_reset(&m_hal);
+		uint64_t now = emu->now;
+
+		renard_phy_s2lp_interrupt_timeout(&m_phy, SNIFF_BENCH_TIMEOUT_MS);
+		if (!renard_phy_s2lp_rx(&m_phy, frame, &frame_rssi) || frame[0] != (uint8_t)i)
+			missed++;
+		renard_phy_s2lp_interrupt_clear(&m_phy);
+
+		virtual_ns += emu->now - now;
+		charge += s2lp_emu_charge(emu, S2LP_EMU_POWER_COUNT);
+
+		/* Drop downlink if it was missed and has not arrived yet */
+		emu->rx_queue_length = 0;
+	}
+
+	*current = virtual_ns == 0 ? 0 : charge / ((double)virtual_ns / 1e9);
+	return missed;
+}
+
+/**********************************************************************************************************************/
+
+int main(int argc, char **argv)
+{
+	(void)argv;
+
+	if (argc > 1) {
+		fprintf(stderr, "Usage: sniff-bench\n");
+		return 1;
+	}
+
+	renard_phy_s2lp_hal_emu_configure(&m_hal, NULL);
+	if (!renard_phy_s2lp_init(&m_phy, &renard_phy_s2lp_hal_emu_functions, &m_hal)) {
+		fprintf(stderr, "sniff-bench: renard_phy_s2lp_init failed\n");
+		return 1;
+	}
+	renard_phy_s2lp_frequency(&m_phy, SNIFF_BENCH_FREQUENCY);
+
+	printf("# " SNIFF_BENCH_FIELDS "\n");
+
+	double continuous[sizeof(SNIFF_BENCH_RSSI) / sizeof(SNIFF_BENCH_RSSI[0])];
+	for (size_t r = 0; r < sizeof(SNIFF_BENCH_RSSI) / sizeof(SNIFF_BENCH_RSSI[0]); r++) {
+		uint32_t missed = sniff_bench_run(NULL, SNIFF_BENCH_RSSI[r], &continuous[r]);
+		printf("continuous,-,-,-,%d,%u,%u,%.3f,%.1f,0.0\n", SNIFF_BENCH_RSSI[r], SNIFF_BENCH_FRAMES, missed,
+				(double)missed / SNIFF_BENCH_FRAMES, continuous[r]);
+	}
+
+	for (size_t c = 0; c < sizeof(SNIFF_BENCH_CONFIGS) / sizeof(SNIFF_BENCH_CONFIGS[0]); c++) {
+		const renard_phy_s2lp_sniff_t *sniff = &SNIFF_BENCH_CONFIGS[c];
+
+		for (size_t r = 0; r < sizeof(SNIFF_BENCH_RSSI) / sizeof(SNIFF_BENCH_RSSI[0]); r++) {
+			double current;
+			uint32_t missed = sniff_bench_run(sniff, SNIFF_BENCH_RSSI[r], &current);
+			printf("sniff,%u,%u,%d,%d,%u,%u,%.3f,%.1f,%.1f\n", sniff->period_ms, sniff->listen_us, sniff->rssi_dbm,
+					SNIFF_BENCH_RSSI[r], SNIFF_BENCH_FRAMES, missed, (double)missed / SNIFF_BENCH_FRAMES, current,
+					continuous[r] == 0 ? 0 : 100 * (1 - current / continuous[r]));
+		}
+	}
+
+	renard_phy_s2lp_stop(&m_phy);
+	return 0;
+}
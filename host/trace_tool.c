@@ -0,0 +1,345 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "renard_phy_s2lp_hal.h"
+#include "renard_phy_s2lp.h"
+#include "renard_phy_s2lp_protocol.h"
+#include "renard_phy_s2lp_hal_trace.h"
+
+#include "renard_phy_s2lp_hal_emu.h"
+#include "renard_phy_s2lp_hal_replay.h"
+#include "s2lp_emu.h"
+
+/*
+ * trace-tool - Record, replay, dump and compare renard-phy-s2lp HAL traces
+ *
+ * record: Run a fixed session of transfers (uplink with downlink request, uplinks at both datarates and RC profiles)
+ *   against the emulator HAL and record it through renard-phy-s2lp-hal-trace.
+ * replay: Run the same session against the replay HAL, fails unless the driver consumes the whole trace without
+ *   divergence. A trace recorded by one driver version and replayed by another shows whether SPI traffic and
+ *   interrupt handling are still exactly the same, a field capture replayed by a fixed driver reproduces the field
+ *   failure on the host as long as the driver makes the same HAL calls.
+ * dump: Print trace as CSV, one line per record.
+ * diff: Compare two traces (e.g. of two driver versions or of the field and the emulator), prints number of records,
+ *   SPI transactions, SPI bytes, interrupt waits and duration of both, the first record that differs in content and
+ *   the largest timing difference between the records before it. Fails if the traces differ in content. TIMESTAMP
+ *   records are skipped, since the driver only reads timestamps with statistics or energy accounting enabled.
+ *
+ * Usage: trace-tool record|replay|dump <trace>
+ *        trace-tool diff <trace> <trace>
+ */
+
+#define TRACE_TOOL_SEED 0x1234
+#define TRACE_TOOL_DEVID 0x0012abcd
+
+/* Session: RC profile, datarate, replicas, downlink request */
+static const struct
+{
+	renard_phy_s2lp_rc_t rc_profile;
+	renard_phy_s2lp_ul_datarate_t datarate;
+	bool replicas;
+	bool request_downlink;
+} TRACE_TOOL_SESSION[] = {
+	{PROFILE_RC1, UL_DATARATE_100BPS, true, true},
+	{PROFILE_RC1, UL_DATARATE_600BPS, false, false},
+	{PROFILE_RC2, UL_DATARATE_600BPS, true, false}
+};
+
+typedef struct
+{
+	uint32_t records;
+	uint32_t spi_transactions;
+	uint64_t spi_bytes;
+	uint32_t interrupt_waits;
+	uint32_t first_time;
+	uint32_t last_time;
+} trace_tool_summary_t;
+
+/**********************************************************************************************************************/
+
+/*
+ * Session, the same sequence of driver calls for recording and replaying. hal_emu is the emulator HAL instance that
+ * downlink candidates are scheduled on, NULL when replaying.
+ */
+static bool trace_tool_session(const renard_phy_s2lp_hal_t *hal, void *context, renard_phy_s2lp_hal_emu_t *hal_emu)
+{
+	static renard_phy_s2lp_t phy;
+	static renard_phy_s2lp_protocol_t protocol;
+	sfx_commoninfo common;
+
+	memset(&common, 0, sizeof(common));
+	common.devid = TRACE_TOOL_DEVID;
+
+	if (!renard_phy_s2lp_init(&phy, hal, context)) {
+		fprintf(stderr, "trace-tool: renard_phy_s2lp_init failed\n");
+		return false;
+	}
+	renard_phy_s2lp_protocol_init(&protocol, &phy, TRACE_TOOL_SEED);
+
+	for (size_t i = 0; i < sizeof(TRACE_TOOL_SESSION) / sizeof(TRACE_TOOL_SESSION[0]); i++) {
+		sfx_ul_plain uplink;
+		sfx_dl_plain downlink;
+		int16_t rssi;
+
+		memset(&uplink, 0, sizeof(uplink));
+		uplink.msg[0] = 0x42;
+		uplink.msg[1] = i;
+		uplink.msglen = 2;
+		uplink.replicas = TRACE_TOOL_SESSION[i].replicas;
+		uplink.request_downlink = TRACE_TOOL_SESSION[i].request_downlink;
+
+		/* Candidate that fails CRC check half-way through the downlink window, the transfer then times out */
+		if (hal_emu != NULL && uplink.request_downlink) {
+			s2lp_emu_t *emu = renard_phy_s2lp_hal_emu(hal_emu);
+			s2lp_emu_rx_frame_t junk = {emu->now + 32000000000ULL, 0, -120, 15, {0x00}, 0};
+			s2lp_emu_rx_schedule(emu, &junk);
+		}
+
+		renard_phy_s2lp_protocol_error_t error = renard_phy_s2lp_protocol_transfer(&protocol, &common, &uplink,
+				&downlink, TRACE_TOOL_SESSION[i].rc_profile, TRACE_TOOL_SESSION[i].datarate, &rssi);
+		printf("trace-tool: transfer %zu: error %d\n", i, error);
+		common.seqnum++;
+	}
+
+	renard_phy_s2lp_stop(&phy);
+	return true;
+}
+
+static void trace_tool_write(void *context, const uint8_t *data, uint16_t length)
+{
+	fwrite(data, 1, length, context);
+}
+
+static int trace_tool_record(const char *path)
+{
+	static renard_phy_s2lp_hal_emu_t hal_emu;
+	renard_phy_s2lp_hal_trace_t trace;
+	FILE *file = fopen(path, "wb");
+
+	if (file == NULL) {
+		fprintf(stderr, "trace-tool: cannot write %s\n", path);
+		return 1;
+	}
+
+	renard_phy_s2lp_hal_emu_configure(&hal_emu, NULL);
+	renard_phy_s2lp_hal_trace_setup(&trace, &renard_phy_s2lp_hal_emu_functions, &hal_emu, trace_tool_write, file);
+	bool ok = trace_tool_session(&renard_phy_s2lp_hal_trace_functions, &trace, &hal_emu);
+
+	if (fclose(file) != 0) {
+		fprintf(stderr, "trace-tool: cannot write %s\n", path);
+		return 1;
+	}
+
+	return ok ? 0 : 1;
+}
+
+static int trace_tool_replay(const char *path)
+{
+	renard_phy_s2lp_hal_replay_t replay;
+
+	if (!renard_phy_s2lp_hal_replay_open(&replay, path)) {
+		fprintf(stderr, "trace-tool: cannot read trace %s\n", path);
+		return 1;
+	}
+
+	bool ok = trace_tool_session(&renard_phy_s2lp_hal_replay_functions, &replay, NULL);
+	const char *error = renard_phy_s2lp_hal_replay_finish(&replay);
+	if (error != NULL) {
+		fprintf(stderr, "trace-tool: replay diverged at %s\n", error);
+		return 1;
+	}
+
+	printf("trace-tool: replayed %s\n", path);
+	return ok ? 0 : 1;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Analysis
+ * trace_tool_hex: Print bytes as hex string, nothing if data is NULL
+ * trace_tool_equal: Whether two records describe the same HAL call with the same data, regardless of time
+ * trace_tool_count: Add record to summary
+ * trace_tool_next: Next record that diff compares, skipping TIMESTAMP records
+ */
+static void trace_tool_hex(const uint8_t *data, uint8_t length)
+{
+	for (uint8_t i = 0; data != NULL && i < length; i++)
+		printf("%02x", data[i]);
+}
+
+static bool trace_tool_equal(const renard_phy_s2lp_trace_record_t *a, const renard_phy_s2lp_trace_record_t *b)
+{
+	if (a->type != b->type || a->value != b->value || a->length != b->length || (a->miso == NULL) != (b->miso == NULL))
+		return false;
+
+	if (a->type != RENARD_PHY_S2LP_TRACE_SPI)
+		return true;
+
+	return memcmp(a->mosi, b->mosi, a->length) == 0 && (a->miso == NULL || memcmp(a->miso, b->miso, a->length) == 0);
+}
+
+static void trace_tool_count(trace_tool_summary_t *summary, const renard_phy_s2lp_trace_record_t *record)
+{
+	if (summary->records++ == 0)
+		summary->first_time = record->time;
+	summary->last_time = record->time;
+
+	if (record->type == RENARD_PHY_S2LP_TRACE_SPI) {
+		summary->spi_transactions++;
+		summary->spi_bytes += record->length;
+	}
+
+	if (record->type == RENARD_PHY_S2LP_TRACE_WAIT)
+		summary->interrupt_waits++;
+}
+
+static bool trace_tool_next(renard_phy_s2lp_trace_t *trace, renard_phy_s2lp_trace_record_t *record)
+{
+	while (renard_phy_s2lp_trace_next(trace, record)) {
+		if (record->type != RENARD_PHY_S2LP_TRACE_TIMESTAMP)
+			return true;
+	}
+
+	return false;
+}
+
+static void trace_tool_print(const char *label, const char *path, const trace_tool_summary_t *summary)
+{
+	printf("%s: %s: %u record(s), %u SPI transaction(s), %llu SPI byte(s), %u interrupt wait(s), %uus\n", label, path,
+			summary->records, summary->spi_transactions, (unsigned long long)summary->spi_bytes,
+			summary->interrupt_waits, summary->last_time - summary->first_time);
+}
+
+static void trace_tool_print_record(const char *label, const renard_phy_s2lp_trace_record_t *record)
+{
+	printf("%s: offset %zu, %uus, %s, value %u, mosi ", label, record->offset, record->time,
+			renard_phy_s2lp_trace_type_name(record->type), record->value);
+	trace_tool_hex(record->mosi, record->length);
+	printf(", miso ");
+	trace_tool_hex(record->miso, record->length);
+	printf("\n");
+}
+
+static int trace_tool_dump(const char *path)
+{
+	renard_phy_s2lp_trace_t trace;
+	renard_phy_s2lp_trace_record_t record;
+
+	if (!renard_phy_s2lp_trace_open(&trace, path)) {
+		fprintf(stderr, "trace-tool: cannot read trace %s\n", path);
+		return 1;
+	}
+
+	printf("# record,offset,time_us,type,value,length,mosi,miso\n");
+	while (renard_phy_s2lp_trace_next(&trace, &record)) {
+		printf("%u,%zu,%u,%s,%u,%u,", trace.index - 1, record.offset, record.time,
+				renard_phy_s2lp_trace_type_name(record.type), record.value, record.length);
+		trace_tool_hex(record.mosi, record.length);
+		printf(",");
+		trace_tool_hex(record.miso, record.length);
+		printf("\n");
+	}
+
+	bool malformed = trace.malformed;
+	renard_phy_s2lp_trace_close(&trace);
+
+	if (malformed) {
+		fprintf(stderr, "trace-tool: %s: malformed record\n", path);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int trace_tool_diff(const char *path_a, const char *path_b)
+{
+	renard_phy_s2lp_trace_t a, b;
+	renard_phy_s2lp_trace_record_t record_a, record_b;
+	trace_tool_summary_t summary_a, summary_b;
+	bool differ = false;
+	int64_t max_deviation = 0;
+	uint32_t max_deviation_record = 0;
+
+	if (!renard_phy_s2lp_trace_open(&a, path_a) || !renard_phy_s2lp_trace_open(&b, path_b)) {
+		fprintf(stderr, "trace-tool: cannot read traces %s and %s\n", path_a, path_b);
+		renard_phy_s2lp_trace_close(&a);
+		return 1;
+	}
+
+	memset(&summary_a, 0, sizeof(summary_a));
+	memset(&summary_b, 0, sizeof(summary_b));
+
+	while (true) {
+		bool has_a = trace_tool_next(&a, &record_a);
+		bool has_b = trace_tool_next(&b, &record_b);
+
+		if (has_a)
+			trace_tool_count(&summary_a, &record_a);
+		if (has_b)
+			trace_tool_count(&summary_b, &record_b);
+
+		if (!has_a && !has_b)
+			break;
+
+		if (differ)
+			continue;
+
+		if (!has_a || !has_b || !trace_tool_equal(&record_a, &record_b)) {
+			differ = true;
+			printf("diff: traces differ at record %u\n", has_a ? summary_a.records - 1 : summary_b.records - 1);
+			if (has_a)
+				trace_tool_print_record("a", &record_a);
+			if (has_b)
+				trace_tool_print_record("b", &record_b);
+			continue;
+		}
+
+		/* Timing relative to the first record, so that traces with different time bases can be compared */
+		int64_t deviation = (int64_t)(record_b.time - summary_b.first_time) - (record_a.time - summary_a.first_time);
+		if (llabs(deviation) > llabs(max_deviation)) {
+			max_deviation = deviation;
+			max_deviation_record = summary_a.records - 1;
+		}
+	}
+
+	trace_tool_print("a", path_a, &summary_a);
+	trace_tool_print("b", path_b, &summary_b);
+	printf("diff: largest timing difference %lldus at record %u\n", (long long)max_deviation, max_deviation_record);
+
+	if (a.malformed || b.malformed) {
+		fprintf(stderr, "trace-tool: %s: malformed record\n", a.malformed ? path_a : path_b);
+		differ = true;
+	}
+
+	renard_phy_s2lp_trace_close(&a);
+	renard_phy_s2lp_trace_close(&b);
+
+	if (!differ)
+		printf("diff: traces are identical in content\n");
+
+	return differ ? 1 : 0;
+}
+
+/**********************************************************************************************************************/
+
+int main(int argc, char **argv)
+{
+	if (argc == 3 && strcmp(argv[1], "record") == 0)
+		return trace_tool_record(argv[2]);
+
+	if (argc == 3 && strcmp(argv[1], "replay") == 0)
+		return trace_tool_replay(argv[2]);
+
+	if (argc == 3 && strcmp(argv[1], "dump") == 0)
+		return trace_tool_dump(argv[2]);
+
+	if (argc == 4 && strcmp(argv[1], "diff") == 0)
+		return trace_tool_diff(argv[2], argv[3]);
+
+	fprintf(stderr, "Usage: trace-tool record|replay|dump <trace>\n       trace-tool diff <trace> <trace>\n");
+	return 1;
+}
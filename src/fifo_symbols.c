@@ -8,116 +8,186 @@
  * FIFO direct polar mode symbol definitions. See datasheet "5.4.3 Direct polar mode" for more information.
  * Each Sigfox symbol consists of 40 FIFO byte couples, where for every byte couple the first byte controls
  * the instantaneous frequency and the second byte controls the instantaneous power.
- * Write command (0x00) and write address of FIFO (0xff) are directly included in the ramps so that the ramps
- * don't need to be copied to prepend these values when outputting them.
+ * Every waveform is output as a single SPI transfer, starting with write command (0x00) and write address of FIFO
+ * (0xff).
  *
- * FIFO_POLAR_ZERO_FDEV_NEG     = Sigfox binary '0' = 180° phase change symbol, phase shift through short negative
+ * FIFO_SYMBOL_ZERO_FDEV_NEG    = Sigfox binary '0' = 180° phase change symbol, phase shift through short negative
  *                                frequency deviation.
- * FIFO_POLAR_ZERO_FDEV_POS     = Sigfox binary '0' = 180° phase change symbol, phase shift through short positive
+ * FIFO_SYMBOL_ZERO_FDEV_POS    = Sigfox binary '0' = 180° phase change symbol, phase shift through short positive
  *                                frequency deviation.
- * FIFO_POLAR_ONE               = Sigfox binary '1' = 0° phase change symbol, constant maximum TX power
- * FIFO_POLAR_BEFOREFRAME_1     = Ramp-up before every uplink, part 1
- * FIFO_POLAR_BEFOREFRAME_2     = Ramp-up before every uplink, part 2
- * FIFO_POLAR_AFTERFRAME_1      = Ramp-down after every uplink, part 1
- * FIFO_POLAR_AFTERFRAME_2      = Ramp-down after every uplink, part 2
+ * FIFO_SYMBOL_ONE              = Sigfox binary '1' = 0° phase change symbol, constant maximum TX power
+ * FIFO_SYMBOL_BEFOREFRAME_1    = Ramp-up before every uplink, part 1
+ * FIFO_SYMBOL_BEFOREFRAME_2    = Ramp-up before every uplink, part 2
+ * FIFO_SYMBOL_AFTERFRAME_1     = Ramp-down after every uplink, part 1
+ * FIFO_SYMBOL_AFTERFRAME_2     = Ramp-down after every uplink, part 2
+ *
+ * Instead of storing all waveforms, they are generated from the waveform parameters in conf_hardware.h:
+ * --> Frequency bytes are zero, except for the single byte couple of a '0' symbol that shifts the phase by 180°.
+ * --> '0' symbols are symmetric around the phase change: Power drops along RENARD_PHY_S2LP_WAVEFORM_SYMBOL_RAMP from
+ *     RENARD_PHY_S2LP_WAVEFORM_FLOOR (full power) to RENARD_PHY_S2LP_WAVEFORM_PEAK, which is held for the byte couple
+ *     before the phase change and the phase change itself, and rises again along the mirrored ramp.
+ * --> The ramp-up (both parts) follows RENARD_PHY_S2LP_WAVEFORM_FRAME_RAMP down to full power, the ramp-down is the
+ *     ramp-up's mirror image, preceded by byte couples at full power.
+ * Expansion writes all byte couples at full power first and then only patches the ramps and the phase change, so that
+ * the driver can expand every symbol right into the refill buffer (see RENARD_PHY_S2LP_TX_SYMBOL_CACHE).
  */
 #define SPI_WRITE 0x00
 #define FDEV_POS 0x7f
 #define FDEV_NEG 0x81
 
+/* Byte couple of a '0' symbol that shifts the phase, byte couples of ramp-up and ramp-down */
+#define SYMBOL_PHASE_CHANGE 24
+#define BEFOREFRAME_COUPLES 72
+#define AFTERFRAME_COUPLES 80
 
+static const uint8_t SYMBOL_RAMP[] = {RENARD_PHY_S2LP_WAVEFORM_SYMBOL_RAMP};
+static const uint8_t FRAME_RAMP[] = {RENARD_PHY_S2LP_WAVEFORM_FRAME_RAMP};
 
-#if (RENARD_PHY_S2LP_HAVE_FEM == 0)
-/*
- * Symbol / pre-frame / after-frame waveforms for operation *WITHOUT* front-end-module
- */
-const uint8_t FIFO_POLAR_ZERO_FDEV_NEG[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 2, 0, 2, 0, 3, 0, 4, 0, 6, 0, 8, 0, 11, 0, 15, 0, 20,
-	0, 24, 0, 30, 0, 39, 0, 54, 0, 220, FDEV_NEG, 220, 0, 54, 0, 39, 0, 30, 0, 24, 0, 20, 0, 15, 0, 11, 0, 8, 0, 6,
-	0, 4, 0, 3, 0, 2, 0, 2, 0, 1, 0, 1
-};
-const uint8_t FIFO_POLAR_ZERO_FDEV_POS[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 2, 0, 2, 0, 3, 0, 4, 0, 6, 0, 8, 0, 11, 0, 15, 0, 20,
-	0, 24, 0, 30, 0, 39, 0, 54, 0, 220, FDEV_POS, 220, 0, 54, 0, 39, 0, 30, 0, 24, 0, 20, 0, 15, 0, 11, 0, 8, 0, 6,
-	0, 4, 0, 3, 0, 2, 0, 2, 0, 1, 0, 1
-};
-const uint8_t FIFO_POLAR_ONE[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
-	1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1,
-	0, 1
-};
-const uint8_t FIFO_POLAR_BEFOREFRAME_1[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 80, 0, 70, 0, 67, 0, 60, 0, 51, 0, 45, 0, 40, 0, 35, 0, 31, 0, 26, 0, 24, 0, 22, 0, 20, 0, 18, 0, 17, 0, 16, 0,
-	15, 0, 13, 0, 13, 0, 11, 0, 11, 0, 10, 0, 10, 0, 9, 0, 9, 0, 8, 0, 8, 0, 7, 0, 7, 0, 7, 0, 7, 0, 6, 0, 6, 0, 6, 0,
-	6, 0, 6, 0, 5, 0, 5, 0, 5, 0, 5
-};
-const uint8_t FIFO_POLAR_BEFOREFRAME_2[FIFO_CMD_LENGTH + 64] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 5, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 3, 0, 3, 0, 3, 0, 3, 0, 3, 0, 3, 0, 3, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0,
-	2, 0, 2, 0, 2, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1
-};
-const uint8_t FIFO_POLAR_AFTERFRAME_1[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 2, 0,
-	2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 3, 0, 3, 0, 3, 0, 3, 0, 3, 0, 3, 0, 3, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4,
-	0, 5
-};
-const uint8_t FIFO_POLAR_AFTERFRAME_2[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 5, 0, 5, 0, 5, 0, 5, 0, 6, 0, 6, 0, 6, 0, 6, 0, 6, 0, 7, 0, 7, 0, 7, 0, 7, 0, 8, 0, 8, 0, 9,	0, 9, 0, 10, 0, 10,
-	0, 11, 0, 11, 0, 13, 0, 13, 0, 15, 0, 16, 0, 17, 0, 18, 0, 20, 0, 22, 0, 24, 0, 26, 0, 31, 0, 35, 0, 40, 0, 45, 0,
-	51, 0, 60, 0, 67, 0, 70, 0, 80
+#define SYMBOL_RAMP_START (SYMBOL_PHASE_CHANGE - 1 - (int)sizeof(SYMBOL_RAMP))
+
+/* Compile-time check: Ramps from conf_hardware.h must fit into their symbols */
+typedef char fifo_symbols_symbol_ramp_fits[SYMBOL_RAMP_START >= 0 ? 1 : -1];
+typedef char fifo_symbols_frame_ramp_fits[sizeof(FRAME_RAMP) <= BEFOREFRAME_COUPLES ? 1 : -1];
+
+const uint8_t FIFO_SYMBOL_LENGTHS[FIFO_SYMBOL_COUNT] = {
+	FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH,
+	FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH,
+	FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH,
+	FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH,
+	FIFO_CMD_LENGTH + 2 * BEFOREFRAME_COUPLES - FIFO_SYMBOL_LENGTH,
+	FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH,
+	FIFO_CMD_LENGTH + 2 * AFTERFRAME_COUPLES - FIFO_SYMBOL_LENGTH
 };
 
-#else
+/**********************************************************************************************************************/
 
 /*
- * Symbol / pre-frame / after-frame waveforms for operation *WITH* front-end-module
+ * Waveform generation:
+ * fifo_symbol_frame_ramp: Power level of byte couple number couple of the ramp-up before a frame
+ * fifo_symbol_power: Power level of byte couple number couple of the given symbol
+ * fifo_symbol_ramp: Range of byte couples [first, last) of the given symbol whose power level may differ from
+ *   RENARD_PHY_S2LP_WAVEFORM_FLOOR, all others are at full power
  */
-const uint8_t FIFO_POLAR_ZERO_FDEV_NEG[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 36, 0, 36, 0, 37, 0, 38, 0, 40, 0, 42, 0,
-	45, 0, 48, 0, 53, 0, 57, 0, 61, 0, 65, 0, 78, 0, 220, FDEV_NEG, 220, 0, 78, 0, 65, 0, 61, 0, 57, 0, 53, 0, 48,
-	0, 45, 0, 42, 0, 40, 0, 38, 0, 37, 0, 36, 0, 36, 0, 35, 0, 35
-};
-const uint8_t FIFO_POLAR_ZERO_FDEV_POS[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 36, 0, 36, 0, 37, 0, 38, 0, 40, 0, 42, 0,
-	45, 0, 48, 0, 53, 0, 57, 0, 61, 0, 65, 0, 78, 0, 220, FDEV_POS, 220, 0, 78, 0, 65, 0, 61, 0, 57, 0, 53, 0, 48,
-	0, 45, 0, 42, 0, 40, 0, 38, 0, 37, 0, 36, 0, 36, 0, 35, 0, 35
-};
-const uint8_t FIFO_POLAR_ONE[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0,
-	35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35,
-	0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35
-};
-const uint8_t FIFO_POLAR_BEFOREFRAME_1[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 114, 0, 104, 0, 101, 0, 94, 0, 85, 0, 79, 0, 74, 0, 69, 0, 65, 0, 60, 0, 58, 0, 56, 0, 54, 0, 52, 0, 51, 0, 50,
-	0, 49, 0, 47, 0, 47, 0, 45, 0, 45, 0, 44, 0, 44, 0, 43, 0, 43, 0, 42, 0, 42, 0, 41, 0, 41, 0, 41, 0, 41, 0, 40, 0,
-	40, 0, 40, 0, 40, 0, 40, 0, 39, 0, 39, 0, 39, 0, 39
-};
-const uint8_t FIFO_POLAR_BEFOREFRAME_2[FIFO_CMD_LENGTH + 64] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 39, 0, 38, 0, 38, 0, 38, 0, 38, 0, 38, 0, 38, 0, 37, 0, 37, 0, 37, 0, 37, 0, 37, 0, 37, 0, 37, 0, 36, 0, 36, 0,
-	36, 0, 36, 0, 36, 0, 36, 0, 36, 0, 36, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35
-};
-const uint8_t FIFO_POLAR_AFTERFRAME_1[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0, 35, 0,
-	35, 0, 35, 0, 36, 0, 36, 0, 36, 0, 36, 0, 36, 0, 36, 0, 36, 0, 36, 0, 37, 0, 37, 0, 37, 0, 37, 0, 37, 0, 37, 0, 37,
-	0, 38, 0, 38, 0, 38, 0, 38, 0, 38, 0, 38, 0, 39
-};
-const uint8_t FIFO_POLAR_AFTERFRAME_2[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH] = {
-	SPI_WRITE, FIFO_ADDR,
-	0, 39, 0, 39, 0, 39, 0, 39, 0, 40, 0, 40, 0, 40, 0, 40, 0, 40, 0, 41, 0, 41, 0, 41, 0, 41, 0, 42, 0, 42, 0, 43, 0,
-	43, 0, 44, 0, 44, 0, 45, 0, 45, 0, 47, 0, 47, 0, 49, 0, 50, 0, 51, 0, 52, 0, 54, 0, 56, 0, 58, 0, 60, 0, 65, 0, 69,
-	0, 74, 0, 79, 0, 85, 0, 94, 0, 101, 0, 104, 0, 114
-};
+static uint8_t fifo_symbol_frame_ramp(uint8_t couple)
+{
+	return RENARD_PHY_S2LP_WAVEFORM_FLOOR + (couple < sizeof(FRAME_RAMP) ? FRAME_RAMP[couple] : 0);
+}
+
+static uint8_t fifo_symbol_power(fifo_symbol_t symbol, uint8_t couple)
+{
+	switch (symbol) {
+		case FIFO_SYMBOL_ZERO_FDEV_NEG:
+		case FIFO_SYMBOL_ZERO_FDEV_POS:
+		{
+			int8_t distance = couple < SYMBOL_PHASE_CHANGE ? couple : 2 * SYMBOL_PHASE_CHANGE - 1 - couple;
+			if (distance == SYMBOL_PHASE_CHANGE - 1)
+				return RENARD_PHY_S2LP_WAVEFORM_PEAK;
+			if (distance < SYMBOL_RAMP_START)
+				return RENARD_PHY_S2LP_WAVEFORM_FLOOR;
+			return RENARD_PHY_S2LP_WAVEFORM_FLOOR + SYMBOL_RAMP[distance - SYMBOL_RAMP_START];
+		}
+
+		case FIFO_SYMBOL_BEFOREFRAME_1:
+			return fifo_symbol_frame_ramp(couple);
+
+		case FIFO_SYMBOL_BEFOREFRAME_2:
+			return fifo_symbol_frame_ramp(FIFO_SYMBOL_LENGTH / 2 + couple);
+
+		case FIFO_SYMBOL_AFTERFRAME_1:
+			return fifo_symbol_frame_ramp(AFTERFRAME_COUPLES - 1 - couple);
+
+		case FIFO_SYMBOL_AFTERFRAME_2:
+			return fifo_symbol_frame_ramp(AFTERFRAME_COUPLES - 1 - FIFO_SYMBOL_LENGTH / 2 - couple);
+
+		default:
+			return RENARD_PHY_S2LP_WAVEFORM_FLOOR;
+	}
+}
+
+static void fifo_symbol_ramp(fifo_symbol_t symbol, uint8_t *first, uint8_t *last)
+{
+	uint8_t couples = (FIFO_SYMBOL_LENGTHS[symbol] - FIFO_CMD_LENGTH) / 2;
+
+	*first = 0;
+	*last = 0;
+
+	switch (symbol) {
+		case FIFO_SYMBOL_ZERO_FDEV_NEG:
+		case FIFO_SYMBOL_ZERO_FDEV_POS:
+			*first = SYMBOL_RAMP_START;
+			*last = 2 * SYMBOL_PHASE_CHANGE - SYMBOL_RAMP_START;
+			break;
+
+		case FIFO_SYMBOL_BEFOREFRAME_1:
+			*last = sizeof(FRAME_RAMP);
+			break;
+
+		case FIFO_SYMBOL_BEFOREFRAME_2:
+			*last = sizeof(FRAME_RAMP) > FIFO_SYMBOL_LENGTH / 2 ? sizeof(FRAME_RAMP) - FIFO_SYMBOL_LENGTH / 2 : 0;
+			break;
+
+		case FIFO_SYMBOL_AFTERFRAME_1:
+			*first = AFTERFRAME_COUPLES > sizeof(FRAME_RAMP) ? AFTERFRAME_COUPLES - sizeof(FRAME_RAMP) : 0;
+			*last = couples;
+			break;
+
+		case FIFO_SYMBOL_AFTERFRAME_2:
+			*first = AFTERFRAME_COUPLES - FIFO_SYMBOL_LENGTH / 2 > sizeof(FRAME_RAMP) ?
+					AFTERFRAME_COUPLES - FIFO_SYMBOL_LENGTH / 2 - sizeof(FRAME_RAMP) : 0;
+			*last = couples;
+			break;
+
+		default:
+			break;
+	}
+
+	if (*last > couples)
+		*last = couples;
+	if (*first > *last)
+		*first = *last;
+}
+
+void fifo_symbol_expand(fifo_symbol_t symbol, int8_t adjustment, uint8_t offset, uint8_t count, uint8_t *buffer)
+{
+	uint8_t end = offset + count;
+	uint8_t floor = RENARD_PHY_S2LP_WAVEFORM_FLOOR - adjustment;
+	uint8_t *out = buffer;
+	uint8_t first, last;
+	uint8_t i = offset;
+
+	/* FIFO write command, then byte couples at full power without frequency deviation, couple by couple */
+	for (; i < end && i < FIFO_CMD_LENGTH; i++)
+		*out++ = i == 0 ? SPI_WRITE : FIFO_ADDR;
+
+	if (i < end && (i - FIFO_CMD_LENGTH) % 2 == 1) {
+		*out++ = floor;
+		i++;
+	}
+
+	for (; i + 1 < end; i += 2) {
+		*out++ = 0;
+		*out++ = floor;
+	}
+
+	if (i < end)
+		*out = 0;
+
+	/* Patch power levels of the ramps, limited to the couples whose power byte is in [offset, end) */
+	fifo_symbol_ramp(symbol, &first, &last);
+	if (offset > FIFO_CMD_LENGTH && first < (offset - FIFO_CMD_LENGTH) / 2)
+		first = (offset - FIFO_CMD_LENGTH) / 2;
+	if (end < FIFO_CMD_LENGTH)
+		last = 0;
+	else if (last > (end - FIFO_CMD_LENGTH) / 2)
+		last = (end - FIFO_CMD_LENGTH) / 2;
+
+	for (uint8_t couple = first; couple < last; couple++)
+		buffer[FIFO_CMD_LENGTH + 2 * couple + 1 - offset] = fifo_symbol_power(symbol, couple) - adjustment;
 
-#endif
+	/* Patch frequency deviation of the byte couple that shifts the phase */
+	if (symbol == FIFO_SYMBOL_ZERO_FDEV_NEG || symbol == FIFO_SYMBOL_ZERO_FDEV_POS) {
+		i = FIFO_CMD_LENGTH + 2 * SYMBOL_PHASE_CHANGE;
+		if (i >= offset && i < end)
+			buffer[i - offset] = symbol == FIFO_SYMBOL_ZERO_FDEV_NEG ? FDEV_NEG : FDEV_POS;
+	}
+}
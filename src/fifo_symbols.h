@@ -4,12 +4,25 @@
 #define FIFO_CMD_LENGTH 2
 #define FIFO_SYMBOL_LENGTH 80
 
-extern const uint8_t FIFO_POLAR_ZERO_FDEV_NEG[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
-extern const uint8_t FIFO_POLAR_ZERO_FDEV_POS[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
-extern const uint8_t FIFO_POLAR_ONE[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
-extern const uint8_t FIFO_POLAR_BEFOREFRAME_1[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
-extern const uint8_t FIFO_POLAR_BEFOREFRAME_2[FIFO_CMD_LENGTH + 64];
-extern const uint8_t FIFO_POLAR_AFTERFRAME_1[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
-extern const uint8_t FIFO_POLAR_AFTERFRAME_2[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
+typedef enum
+{
+	FIFO_SYMBOL_ZERO_FDEV_NEG = 0,
+	FIFO_SYMBOL_ZERO_FDEV_POS,
+	FIFO_SYMBOL_ONE,
+	FIFO_SYMBOL_BEFOREFRAME_1,
+	FIFO_SYMBOL_BEFOREFRAME_2,
+	FIFO_SYMBOL_AFTERFRAME_1,
+	FIFO_SYMBOL_AFTERFRAME_2,
+	FIFO_SYMBOL_COUNT
+} fifo_symbol_t;
+
+/* Length of every waveform's SPI transfer, including FIFO write command */
+extern const uint8_t FIFO_SYMBOL_LENGTHS[FIFO_SYMBOL_COUNT];
+
+/*
+ * Write bytes offset to offset + count - 1 of the symbol's SPI transfer (FIFO write command followed by byte couples)
+ * to buffer. All power levels are lowered by adjustment, i.e. output power is increased.
+ */
+void fifo_symbol_expand(fifo_symbol_t symbol, int8_t adjustment, uint8_t offset, uint8_t count, uint8_t *buffer);
 
 #endif
@@ -0,0 +1,209 @@
+#include <stdint.h>
+
+#include "s2lp_registers.h"
+#include "register_images.h"
+#include "conf_hardware.h"
+#include "conf_driver.h"
+
+/*
+ * Register images for TX / RX mode setup, computed at compile time from the hardware configuration.
+ * Every image covers a range of contiguous registers and is written using a single S2-LP burst write, which auto-
+ * increments the register address. Like the FIFO symbol waveforms, images directly include the write command (0x00)
+ * and the address of the first register, so that they can be sent to the S2-LP as-is.
+ */
+#define SPI_WRITE 0x00
+
+/*
+ * Modulation type, see register table in datasheet:
+ * --> 0x6 is direct polar mode (used to generate DBPSK) for uplink
+ * --> 0x2 is 2-GFSK BT = 2 for downlink
+ */
+#define UPLINK_MOD_TYPE                 0x6
+#define DOWNLINK_MOD_TYPE               0x2
+
+/*
+ * PLL_PFD_SPLIT_EN (SYNTH_CONFIG2 bit 2) must be set if the digital domain clock divider is disabled, taken from
+ * X-CUBE-SFXS2LP1, see datasheet section 5.3 and table 37: "Charge pump words"
+ */
+#define PLL_PFD_SPLIT_EN                ((DISABLE_CLKDIV) ? 0x04 : 0x00)
+
+/**********************************************************************************************************************/
+
+/*
+ * TX mode
+ * These values as well as the read-modify-write of PA_CONFIG1_ADDR are directly taken from STM32's original S2-LP
+ * Sigfox demo application, they have probably been optimized for minimal power consumption / reliability.
+ *
+ * PA_POWER0 .. SYNTH_CONFIG2: Configure power levels, PA configuration and charge pump
+ */
+const uint8_t REGISTER_IMAGE_TX_PA[REGISTER_IMAGE_HEADER_LENGTH + 4] = {
+	SPI_WRITE, PA_POWER0_ADDR,
+	0x07, // PA_POWER0
+	0x01, // PA_CONFIG1
+	0xc8, // PA_CONFIG0
+	0xd3 | PLL_PFD_SPLIT_EN // SYNTH_CONFIG2
+};
+
+/*
+ * PM_CONF3 .. PM_CONF2: Configure SMPS switching frequency
+ * KRM = 0x1c28 = 7208, fdig = 25MHz: FSW = 7208 * fdig / 2**15 = 5.5MHz
+ */
+const uint8_t REGISTER_IMAGE_TX_PM[REGISTER_IMAGE_HEADER_LENGTH + 2] = {
+	SPI_WRITE, PM_CONF3_ADDR,
+	0x9c, // PM_CONF3
+	0x28  // PM_CONF2
+};
+
+/*
+ * MOD4 .. MOD0: Configure datarate, modulation type, frequency deviation, enable PA power interpolator
+ */
+const uint8_t REGISTER_IMAGE_TX_MOD_100BPS[REGISTER_IMAGE_HEADER_LENGTH + 5] = {
+	SPI_WRITE, MOD4_ADDR,
+	(UPLINK_100BPS_DATARATE_M >> 8) & 0xff,
+	(UPLINK_100BPS_DATARATE_M >> 0) & 0xff,
+	UPLINK_100BPS_DATARATE_E | (UPLINK_MOD_TYPE << 4),
+	UPLINK_100BPS_FDEV_E | 0x80,
+	UPLINK_100BPS_FDEV_M
+};
+
+const uint8_t REGISTER_IMAGE_TX_MOD_600BPS[REGISTER_IMAGE_HEADER_LENGTH + 5] = {
+	SPI_WRITE, MOD4_ADDR,
+	(UPLINK_600BPS_DATARATE_M >> 8) & 0xff,
+	(UPLINK_600BPS_DATARATE_M >> 0) & 0xff,
+	UPLINK_600BPS_DATARATE_E | (UPLINK_MOD_TYPE << 4),
+	UPLINK_600BPS_FDEV_E | 0x80,
+	UPLINK_600BPS_FDEV_M
+};
+
+/**********************************************************************************************************************/
+
+/*
+ * RX mode
+ *
+ * MOD4 .. AFC2: Configure data rate, frequency deviation and reception RF settings:
+ * CHFLT_M = 8, CHFLT_E = 8 --> RX filter bandwidth 2.1kHz (see "5.5.4 RX channel filter bandwidth" table 44)
+ * AFC_ENABLED = 0 --> disable automatic frequency correction
+ *
+ * Values taken from ST's original S2-LP Sigfox demo.
+ */
+const uint8_t REGISTER_IMAGE_RX_MOD[REGISTER_IMAGE_HEADER_LENGTH + 7] = {
+	SPI_WRITE, MOD4_ADDR,
+	(DOWNLINK_DATARATE_M >> 8) & 0xff,
+	(DOWNLINK_DATARATE_M >> 0) & 0xff,
+	(DOWNLINK_MOD_TYPE << 4) | DOWNLINK_DATARATE_E,
+	DOWNLINK_FDEV_E,
+	DOWNLINK_FDEV_M,
+	0x88, // CHFLT
+	0x00  // AFC2
+};
+
+/*
+ * PCKTCTRL3 .. PCKTLEN0: Disable automatic packet decoding (CRC, FEC, Encoding, ...) + set 15-byte packet length
+ */
+const uint8_t REGISTER_IMAGE_RX_PCKT[REGISTER_IMAGE_HEADER_LENGTH + 5] = {
+	SPI_WRITE, PCKTCTRL3_ADDR,
+	0,                    // PCKTCTRL3
+	0,                    // PCKTCTRL2
+	0,                    // PCKTCTRL1
+	0,                    // PCKTLEN1
+	DOWNLINK_FRAME_LENGTH // PCKTLEN0
+};
+
+/*
+ * SYNC1 .. SYNC0: Sync word = SYNC1 .. SYNC0 = 0xb227 (Sigfox Downlink SYNC word)
+ */
+const uint8_t REGISTER_IMAGE_RX_SYNC[REGISTER_IMAGE_HEADER_LENGTH + 2] = {
+	SPI_WRITE, SYNC1_ADDR,
+	0x27, // SYNC1
+	0xb2  // SYNC0
+};
+
+/*
+ * ANT_SELECT_CONF .. CLOCKREC1: Configure reception thresholds and clock recovery:
+ * EQU_CTRL = 0b00 --> disable inter-symbol interference cancellation
+ * CS_BLANKING = 0 --> disable minimum RSSI for data reception
+ * CLK_REC_P_GAIN_SLOW = 1 --> Clock recovery slow loop gain
+ * CLK_REC_P_GAIN_FAST = 3 --> Clock recovery fast loop gain
+ * PSTFLT_LEN = 1 --> 16 symbols post filter length
+ */
+const uint8_t REGISTER_IMAGE_RX_CLOCKREC[REGISTER_IMAGE_HEADER_LENGTH + 3] = {
+	SPI_WRITE, ANT_SELECT_CONF_ADDR,
+	0x00, // ANT_SELECT_CONF
+	0x20, // CLOCKREC2
+	0x70  // CLOCKREC1
+};
+
+/*
+ * PA_POWER0 .. SYNTH_CONFIG2: Reset values, restores the registers that tx_rf_init changed when switching from TX to
+ * RX mode without Power-On-Reset. Only the charge pump configuration (PLL_PFD_SPLIT_EN) differs from reset values.
+ */
+const uint8_t REGISTER_IMAGE_RX_PA[REGISTER_IMAGE_HEADER_LENGTH + 4] = {
+	SPI_WRITE, PA_POWER0_ADDR,
+	0x47, // PA_POWER0
+	0x03, // PA_CONFIG1
+	0x8a, // PA_CONFIG0
+	0xd0 | PLL_PFD_SPLIT_EN // SYNTH_CONFIG2
+};
+
+/*
+ * PM_CONF3 .. PM_CONF2: Configure SMPS switching frequency
+ * KRM = 0x0800 = 2048, fdig = 25MHz: FSW = 2048 * fdig / 2**15 = 1.563MHz
+ */
+const uint8_t REGISTER_IMAGE_RX_PM[REGISTER_IMAGE_HEADER_LENGTH + 2] = {
+	SPI_WRITE, PM_CONF3_ADDR,
+	0x88, // PM_CONF3
+	0x00  // PM_CONF2
+};
+
+/*
+ * IRQ_MASK3 .. IRQ_MASK0: Disable all IRQs except for RX DATA READY (and RX TIMEOUT if the hardware RX timeout is used)
+ */
+const uint8_t REGISTER_IMAGE_RX_IRQ_MASK[REGISTER_IMAGE_HEADER_LENGTH + 4] = {
+	SPI_WRITE, IRQ_MASK3_ADDR,
+	RENARD_PHY_S2LP_RX_HW_TIMEOUT ? IRQ3_RX_TIMEOUT : 0x00, // IRQ_MASK3
+	0x00, // IRQ_MASK2
+	0x00, // IRQ_MASK1
+	0x01  // IRQ_MASK0
+};
+
+/**********************************************************************************************************************/
+
+/*
+ * Front-End Module (FEM) control, for S2-LP's GPIOs 0-2 connected to SKY66420-11:
+ * GPIO0_CONF .. GPIO2_CONF, where every GPIO is driven high or low depending on which FEM input it is connected to.
+ */
+#if (RENARD_PHY_S2LP_HAVE_FEM == 1)
+
+#if (RENARD_PHY_S2LP_FEM_CSD_GPIO > 2) || (RENARD_PHY_S2LP_FEM_CTX_GPIO > 2) || \
+		(RENARD_PHY_S2LP_FEM_CPS_GPIO > 2) || (RENARD_PHY_S2LP_FEM_CSD_GPIO == RENARD_PHY_S2LP_FEM_CTX_GPIO) || \
+		(RENARD_PHY_S2LP_FEM_CSD_GPIO == RENARD_PHY_S2LP_FEM_CPS_GPIO) || \
+		(RENARD_PHY_S2LP_FEM_CTX_GPIO == RENARD_PHY_S2LP_FEM_CPS_GPIO)
+#error "[renard-phy-s2lp] FEM must be connected to S2-LP's GPIO0, GPIO1 and GPIO2"
+#endif
+
+#define S2_LP_GPIO_HIGH 0x9a
+#define S2_LP_GPIO_LOW 0xa2
+
+#define FEM_GPIO(gpio, csd, ctx, cps) \
+	((gpio) == RENARD_PHY_S2LP_FEM_CSD_GPIO ? (csd) : ((gpio) == RENARD_PHY_S2LP_FEM_CTX_GPIO ? (ctx) : (cps)))
+
+#define FEM_IMAGE(csd, ctx, cps) { \
+	SPI_WRITE, GPIO0_CONF_ADDR, \
+	FEM_GPIO(0, csd, ctx, cps), \
+	FEM_GPIO(1, csd, ctx, cps), \
+	FEM_GPIO(2, csd, ctx, cps) \
+}
+
+const uint8_t REGISTER_IMAGE_FEM_SHUTDOWN[REGISTER_IMAGE_HEADER_LENGTH + 3] =
+	FEM_IMAGE(S2_LP_GPIO_LOW, S2_LP_GPIO_LOW, S2_LP_GPIO_LOW);
+
+const uint8_t REGISTER_IMAGE_FEM_RX[REGISTER_IMAGE_HEADER_LENGTH + 3] =
+	FEM_IMAGE(S2_LP_GPIO_HIGH, S2_LP_GPIO_LOW, S2_LP_GPIO_LOW);
+
+const uint8_t REGISTER_IMAGE_FEM_TX_BYPASS[REGISTER_IMAGE_HEADER_LENGTH + 3] =
+	FEM_IMAGE(S2_LP_GPIO_HIGH, S2_LP_GPIO_HIGH, S2_LP_GPIO_LOW);
+
+const uint8_t REGISTER_IMAGE_FEM_TX[REGISTER_IMAGE_HEADER_LENGTH + 3] =
+	FEM_IMAGE(S2_LP_GPIO_HIGH, S2_LP_GPIO_HIGH, S2_LP_GPIO_HIGH);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _REGISTER_IMAGES_H
+#define _REGISTER_IMAGES_H
+
+#include "conf_hardware.h"
+
+#define REGISTER_IMAGE_HEADER_LENGTH 2
+
+/* Length of Sigfox downlink frames (excluding SYNC word) as configured in PCKTLEN */
+#define DOWNLINK_FRAME_LENGTH 15
+
+/* TX mode */
+extern const uint8_t REGISTER_IMAGE_TX_PA[REGISTER_IMAGE_HEADER_LENGTH + 4];
+extern const uint8_t REGISTER_IMAGE_TX_PM[REGISTER_IMAGE_HEADER_LENGTH + 2];
+extern const uint8_t REGISTER_IMAGE_TX_MOD_100BPS[REGISTER_IMAGE_HEADER_LENGTH + 5];
+extern const uint8_t REGISTER_IMAGE_TX_MOD_600BPS[REGISTER_IMAGE_HEADER_LENGTH + 5];
+
+/* RX mode */
+extern const uint8_t REGISTER_IMAGE_RX_MOD[REGISTER_IMAGE_HEADER_LENGTH + 7];
+extern const uint8_t REGISTER_IMAGE_RX_PCKT[REGISTER_IMAGE_HEADER_LENGTH + 5];
+extern const uint8_t REGISTER_IMAGE_RX_SYNC[REGISTER_IMAGE_HEADER_LENGTH + 2];
+extern const uint8_t REGISTER_IMAGE_RX_CLOCKREC[REGISTER_IMAGE_HEADER_LENGTH + 3];
+extern const uint8_t REGISTER_IMAGE_RX_PA[REGISTER_IMAGE_HEADER_LENGTH + 4];
+extern const uint8_t REGISTER_IMAGE_RX_PM[REGISTER_IMAGE_HEADER_LENGTH + 2];
+extern const uint8_t REGISTER_IMAGE_RX_IRQ_MASK[REGISTER_IMAGE_HEADER_LENGTH + 4];
+
+/* Front-end module control through GPIO0..GPIO2 */
+#if (RENARD_PHY_S2LP_HAVE_FEM == 1)
+extern const uint8_t REGISTER_IMAGE_FEM_SHUTDOWN[REGISTER_IMAGE_HEADER_LENGTH + 3];
+extern const uint8_t REGISTER_IMAGE_FEM_RX[REGISTER_IMAGE_HEADER_LENGTH + 3];
+extern const uint8_t REGISTER_IMAGE_FEM_TX_BYPASS[REGISTER_IMAGE_HEADER_LENGTH + 3];
+extern const uint8_t REGISTER_IMAGE_FEM_TX[REGISTER_IMAGE_HEADER_LENGTH + 3];
+#endif
+
+#endif
@@ -9,15 +9,260 @@
 #include "renard_phy_s2lp.h"
 #include "s2lp_registers.h"
 #include "conf_hardware.h"
+#include "conf_driver.h"
 #include "fifo_symbols.h"
+#include "register_images.h"
+
+/* Compile-time check: Sizes in the driver context (see renard_phy_s2lp.h) must match the S2-LP's register map */
+typedef char renard_phy_s2lp_shadow_size[RENARD_PHY_S2LP_SHADOW_SIZE == MC_STATE1_ADDR ? 1 : -1];
+typedef char renard_phy_s2lp_image_header[REGISTER_IMAGE_HEADER_LENGTH == 2 ? 1 : -1];
+
+/**********************************************************************************************************************/
+
+/*
+ * HAL of the driver context, see renard_phy_s2lp_hal.h
+ */
+static void renard_phy_s2lp_hal_init(renard_phy_s2lp_t *phy)
+{
+	phy->hal->init(phy->hal_context, phy);
+}
+
+static void renard_phy_s2lp_hal_spi(renard_phy_s2lp_t *phy, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	phy->hal->spi(phy->hal_context, length, in, out);
+}
+
+static void renard_phy_s2lp_hal_shutdown(renard_phy_s2lp_t *phy, bool shutdown)
+{
+	phy->hal->shutdown(phy->hal_context, shutdown);
+}
+
+static void renard_phy_s2lp_interrupt_gpio(renard_phy_s2lp_t *phy, bool risingTrigger)
+{
+	phy->hal->interrupt_gpio(phy->hal_context, risingTrigger);
+}
+
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+static void renard_phy_s2lp_hal_spi_async(renard_phy_s2lp_t *phy, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	phy->hal->spi_async(phy->hal_context, length, in, out);
+}
+#endif
+
+void renard_phy_s2lp_interrupt_timeout(renard_phy_s2lp_t *phy, uint32_t milliseconds)
+{
+	phy->hal->interrupt_timeout(phy->hal_context, milliseconds);
+}
+
+void renard_phy_s2lp_interrupt_clear(renard_phy_s2lp_t *phy)
+{
+	phy->hal->interrupt_clear(phy->hal_context);
+}
+
+bool renard_phy_s2lp_interrupt_wait(renard_phy_s2lp_t *phy)
+{
+	return phy->hal->interrupt_wait(phy->hal_context);
+}
+
+void renard_phy_s2lp_interrupt_async(renard_phy_s2lp_t *phy, bool enable)
+{
+	phy->hal->interrupt_async(phy->hal_context, enable);
+}
+
+uint32_t renard_phy_s2lp_timestamp(renard_phy_s2lp_t *phy)
+{
+	return phy->hal->timestamp(phy->hal_context);
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Register shadow cache, see conf_driver.h
+ * Only configuration registers (below MC_STATE1_ADDR) are cached, status registers and the FIFO always go to the S2-LP.
+ */
+#if (RENARD_PHY_S2LP_SHADOW_REGISTERS == 1)
+
+#define SHADOW_SIZE MC_STATE1_ADDR
+
+static void renard_phy_s2lp_shadow_invalidate(renard_phy_s2lp_t *phy)
+{
+	memset(phy->shadow_valid, 0, sizeof(phy->shadow_valid));
+}
+
+static bool renard_phy_s2lp_shadow_get(renard_phy_s2lp_t *phy, uint8_t address, uint8_t *value)
+{
+	if (address >= SHADOW_SIZE || !(phy->shadow_valid[address / 8] & (1 << (address % 8))))
+		return false;
+
+	*value = phy->shadow[address];
+	return true;
+}
+
+static void renard_phy_s2lp_shadow_set(renard_phy_s2lp_t *phy, uint8_t address, uint8_t value)
+{
+	if (address >= SHADOW_SIZE)
+		return;
+
+	phy->shadow[address] = value;
+	phy->shadow_valid[address / 8] |= 1 << (address % 8);
+}
+
+#else
+
+static void renard_phy_s2lp_shadow_invalidate(renard_phy_s2lp_t *phy)
+{
+	(void)phy;
+}
+
+/* Still defines value, so that callers need no initialization just to keep the compiler's flow analysis happy */
+static bool renard_phy_s2lp_shadow_get(renard_phy_s2lp_t *phy, uint8_t address, uint8_t *value)
+{
+	(void)phy;
+	(void)address;
+	*value = 0;
+	return false;
+}
+
+static void renard_phy_s2lp_shadow_set(renard_phy_s2lp_t *phy, uint8_t address, uint8_t value)
+{
+	(void)phy;
+	(void)address;
+	(void)value;
+}
+
+#endif
+
+/**********************************************************************************************************************/
+
+/*
+ * Statistics, see conf_driver.h
+ * renard_phy_s2lp_spi / renard_phy_s2lp_spi_async: renard_phy_s2lp_hal_spi / _spi_async, counting transactions and
+ *	 bytes
+ * renard_phy_s2lp_stats_tx_start: Transmission was started, start measuring time until first refill
+ * renard_phy_s2lp_stats_refill: TX FIFO refill of given length, measure gap since previous refill
+ */
+#if (RENARD_PHY_S2LP_STATS == 1)
+
+static void renard_phy_s2lp_spi(renard_phy_s2lp_t *phy, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	phy->stats.spi_transactions++;
+	phy->stats.spi_bytes += length;
+	renard_phy_s2lp_hal_spi(phy, length, in, out);
+}
+
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+static void renard_phy_s2lp_spi_async(renard_phy_s2lp_t *phy, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	phy->stats.spi_transactions++;
+	phy->stats.spi_bytes += length;
+	renard_phy_s2lp_hal_spi_async(phy, length, in, out);
+}
+#endif
+
+static void renard_phy_s2lp_stats_tx_start(renard_phy_s2lp_t *phy)
+{
+	phy->stats_last_refill = renard_phy_s2lp_timestamp(phy);
+}
+
+static void renard_phy_s2lp_stats_refill(renard_phy_s2lp_t *phy, uint8_t length)
+{
+	uint32_t now = renard_phy_s2lp_timestamp(phy);
+
+	if (now - phy->stats_last_refill > phy->stats.max_refill_gap_us)
+		phy->stats.max_refill_gap_us = now - phy->stats_last_refill;
+
+	phy->stats_last_refill = now;
+	phy->stats.fifo_refills++;
+	(void)length;
+	RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_FIFO_REFILL, length);
+}
+
+#else
+
+static void renard_phy_s2lp_spi(renard_phy_s2lp_t *phy, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	renard_phy_s2lp_hal_spi(phy, length, in, out);
+}
+
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+static void renard_phy_s2lp_spi_async(renard_phy_s2lp_t *phy, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	renard_phy_s2lp_hal_spi_async(phy, length, in, out);
+}
+#endif
+
+static void renard_phy_s2lp_stats_tx_start(renard_phy_s2lp_t *phy)
+{
+	(void)phy;
+}
+
+static void renard_phy_s2lp_stats_refill(renard_phy_s2lp_t *phy, uint8_t length)
+{
+	(void)phy;
+	(void)length;
+	RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_FIFO_REFILL, length);
+}
+
+#endif
+
+/**********************************************************************************************************************/
 
 /*
- * Modulation type, see register table in datasheet:
- * --> 0x6 is direct polar mode (used to generate DBPSK) for uplink
- * --> 0x2 is 2-GFSK BT = 2 for downlink
+ * Energy accounting, see conf_driver.h
+ * renard_phy_s2lp_energy_enter: S2-LP enters the given state, add time since the previous state change to that state
+ * renard_phy_s2lp_energy_tx: S2-LP starts transmitting an uplink with the given datarate and RC profile
  */
-#define UPLINK_MOD_TYPE                 0x6
-#define DOWNLINK_MOD_TYPE               0x2
+#if (RENARD_PHY_S2LP_ENERGY == 1)
+
+static const uint32_t ENERGY_CURRENT_NA[S2LP_ENERGY_COUNT] = {
+	[S2LP_ENERGY_SHUTDOWN] = RENARD_PHY_S2LP_CURRENT_SHUTDOWN_NA,
+	[S2LP_ENERGY_RESET] = RENARD_PHY_S2LP_CURRENT_RESET_NA,
+	[S2LP_ENERGY_SLEEP] = RENARD_PHY_S2LP_CURRENT_SLEEP_NA,
+	[S2LP_ENERGY_IDLE] = RENARD_PHY_S2LP_CURRENT_IDLE_NA,
+	[S2LP_ENERGY_RX] = RENARD_PHY_S2LP_CURRENT_RX_NA,
+	[S2LP_ENERGY_TX_100BPS] = RENARD_PHY_S2LP_CURRENT_TX_100BPS_NA,
+	[S2LP_ENERGY_TX_600BPS] = RENARD_PHY_S2LP_CURRENT_TX_600BPS_NA,
+	[S2LP_ENERGY_TX_100BPS_BOOST] = RENARD_PHY_S2LP_CURRENT_TX_100BPS_BOOST_NA,
+	[S2LP_ENERGY_TX_600BPS_BOOST] = RENARD_PHY_S2LP_CURRENT_TX_600BPS_BOOST_NA
+};
+
+static void renard_phy_s2lp_energy_enter(renard_phy_s2lp_t *phy, renard_phy_s2lp_energy_state_t state)
+{
+	uint32_t now = renard_phy_s2lp_timestamp(phy);
+
+	phy->energy.time_us[phy->energy_state] += now - phy->energy_since;
+	phy->energy_since = now;
+	phy->energy_state = state;
+}
+
+static void renard_phy_s2lp_energy_tx(renard_phy_s2lp_t *phy, renard_phy_s2lp_ul_datarate_t datarate,
+		renard_phy_s2lp_rc_t rc_profile)
+{
+	bool boost = RENARD_PHY_S2LP_HAVE_FEM == 1 && !renard_phy_s2lp_bypass_fem_by_rc[rc_profile];
+
+	if (datarate == UL_DATARATE_600BPS)
+		renard_phy_s2lp_energy_enter(phy, boost ? S2LP_ENERGY_TX_600BPS_BOOST : S2LP_ENERGY_TX_600BPS);
+	else
+		renard_phy_s2lp_energy_enter(phy, boost ? S2LP_ENERGY_TX_100BPS_BOOST : S2LP_ENERGY_TX_100BPS);
+}
+
+#else
+
+static void renard_phy_s2lp_energy_enter(renard_phy_s2lp_t *phy, renard_phy_s2lp_energy_state_t state)
+{
+	(void)phy;
+	(void)state;
+}
+
+static void renard_phy_s2lp_energy_tx(renard_phy_s2lp_t *phy, renard_phy_s2lp_ul_datarate_t datarate,
+		renard_phy_s2lp_rc_t rc_profile)
+{
+	(void)phy;
+	(void)datarate;
+	(void)rc_profile;
+}
+
+#endif
 
 /**********************************************************************************************************************/
 
@@ -25,58 +270,105 @@
  * Private, low-level SPI read / write functions
  * renard_phy_s2lp_cmd: Write command to S2-LP (datasheet: "6.1 Command List")
  * renard_phy_s2lp_write: Set value of S2-LP register
+ * renard_phy_s2lp_write_image: Set values of contiguous S2-LP registers from register image (see register_images.c)
+ * renard_phy_s2lp_shadow_image: Enter register image into shadow cache, true if the S2-LP already holds all its values
  * renard_phy_s2lp_read: Read value of S2-LP register
+ * renard_phy_s2lp_read_burst: Read values of contiguous S2-LP registers, or multiple bytes from FIFO if address is
+ *	 FIFO_ADDR (the only address that the S2-LP does not auto-increment), using a single SPI transaction
  */
-static void renard_phy_s2lp_cmd(uint8_t cmd)
+#define READ_BURST_MAX_LENGTH 32
+
+static void renard_phy_s2lp_cmd(renard_phy_s2lp_t *phy, uint8_t cmd)
 {
 	uint8_t out_buffer[2];
 
 	out_buffer[0] = 0x80;
 	out_buffer[1] = cmd;
 
-	renard_phy_s2lp_hal_spi(2, out_buffer, NULL);
+	renard_phy_s2lp_spi(phy, 2, out_buffer, NULL);
 }
 
-static void renard_phy_s2lp_symbol(const uint8_t *symbol, uint8_t length, renard_phy_s2lp_rc_t rc_profile)
+static void renard_phy_s2lp_write(renard_phy_s2lp_t *phy, uint8_t address, uint8_t value)
 {
-	uint8_t symbol_poweradjusted[FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
+	uint8_t out_buffer[3];
+	uint8_t current;
 
-	memcpy(symbol_poweradjusted, symbol, length);
+	if (renard_phy_s2lp_shadow_get(phy, address, &current) && current == value) {
+		phy->shadow_saved++;
+		return;
+	}
 
-#if (RENARD_PHY_S2LP_HAVE_FEM == 1)
-	// If using special symbol waveforms for FEM, adjust power according to provided value (depends on RC profile and
-	// on whether we want to bypass the FEM or let it amplify the TX signal).
-	for (uint8_t i = FIFO_CMD_LENGTH + 1; i < length; i += 2)
-		symbol_poweradjusted[i] = symbol_poweradjusted[i] - renard_phy_s2lp_fem_power_adjustment_by_rc[rc_profile];
-#endif
+	renard_phy_s2lp_shadow_set(phy, address, value);
+
+	out_buffer[0] = 0x00;
+	out_buffer[1] = address;
+	out_buffer[2] = value;
 
-	renard_phy_s2lp_hal_spi(length, symbol_poweradjusted, NULL);
+	renard_phy_s2lp_spi(phy, 3, out_buffer, NULL);
 }
 
-static void renard_phy_s2lp_write(uint8_t address, uint8_t value)
+static bool renard_phy_s2lp_shadow_image(renard_phy_s2lp_t *phy, const uint8_t *image, uint8_t length)
 {
-	uint8_t out_buffer[3];
+	uint8_t address = image[1];
+	bool unchanged = true;
+	uint8_t current;
+
+	for (uint8_t i = REGISTER_IMAGE_HEADER_LENGTH; i < length; i++) {
+		uint8_t register_address = address + i - REGISTER_IMAGE_HEADER_LENGTH;
+		if (!renard_phy_s2lp_shadow_get(phy, register_address, &current) || current != image[i])
+			unchanged = false;
+		renard_phy_s2lp_shadow_set(phy, register_address, image[i]);
+	}
 
-	out_buffer[0] = 0x00;
-	out_buffer[1] = address;
-	out_buffer[2] = value;
+	if (unchanged)
+		phy->shadow_saved++;
 
-	renard_phy_s2lp_hal_spi(3, out_buffer, NULL);
+	return unchanged;
 }
 
-static uint8_t renard_phy_s2lp_read(uint8_t address)
+static void renard_phy_s2lp_write_image(renard_phy_s2lp_t *phy, const uint8_t *image, uint8_t length)
+{
+	/* Skip image if all registers already hold the desired values, otherwise write it as a whole */
+	if (!renard_phy_s2lp_shadow_image(phy, image, length))
+		renard_phy_s2lp_spi(phy, length, (uint8_t *)image, NULL);
+}
+
+static uint8_t renard_phy_s2lp_read(renard_phy_s2lp_t *phy, uint8_t address)
 {
 	uint8_t in_buffer[3], out_buffer[3];
 
+	if (renard_phy_s2lp_shadow_get(phy, address, &in_buffer[2])) {
+		phy->shadow_saved++;
+		return in_buffer[2];
+	}
+
 	out_buffer[0] = 0x01;
 	out_buffer[1] = address;
 	out_buffer[2] = 0xff;
 
-	renard_phy_s2lp_hal_spi(3, out_buffer, in_buffer);
+	renard_phy_s2lp_spi(phy, 3, out_buffer, in_buffer);
+	renard_phy_s2lp_shadow_set(phy, address, in_buffer[2]);
 
 	return in_buffer[2];
 }
 
+static void renard_phy_s2lp_read_burst(renard_phy_s2lp_t *phy, uint8_t address, uint8_t *values, uint8_t length)
+{
+	uint8_t in_buffer[2 + READ_BURST_MAX_LENGTH], out_buffer[2 + READ_BURST_MAX_LENGTH];
+
+	out_buffer[0] = 0x01;
+	out_buffer[1] = address;
+	memset(&out_buffer[2], 0xff, length);
+
+	renard_phy_s2lp_spi(phy, 2 + length, out_buffer, in_buffer);
+	memcpy(values, &in_buffer[2], length);
+
+	if (address != FIFO_ADDR) {
+		for (uint8_t i = 0; i < length; i++)
+			renard_phy_s2lp_shadow_set(phy, address + i, values[i]);
+	}
+}
+
 /**********************************************************************************************************************/
 
 /*
@@ -93,35 +385,24 @@ typedef enum
   S2LP_FEM_MODE_RX
 } renard_phy_s2lp_fem_mode_t;
 
-#define S2_LP_GPIO_HIGH 0x9a
-#define S2_LP_GPIO_LOW 0xa2
-
-static void fem_mode(renard_phy_s2lp_fem_mode_t mode)
+static void fem_mode(renard_phy_s2lp_t *phy, renard_phy_s2lp_fem_mode_t mode)
 {
 	switch (mode)
 	{
 		case S2LP_FEM_MODE_SHUTDOWN:
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CSD_GPIO, S2_LP_GPIO_LOW);
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CTX_GPIO, S2_LP_GPIO_LOW);
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CPS_GPIO, S2_LP_GPIO_LOW);
+			renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_FEM_SHUTDOWN, sizeof(REGISTER_IMAGE_FEM_SHUTDOWN));
 			break;
 
 		case S2LP_FEM_MODE_RX:
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CSD_GPIO, S2_LP_GPIO_HIGH);
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CTX_GPIO, S2_LP_GPIO_LOW);
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CPS_GPIO, S2_LP_GPIO_LOW);
+			renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_FEM_RX, sizeof(REGISTER_IMAGE_FEM_RX));
 			break;
 
 		case S2LP_FEM_MODE_TX_BYPASS:
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CSD_GPIO, S2_LP_GPIO_HIGH);
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CTX_GPIO, S2_LP_GPIO_HIGH);
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CPS_GPIO, S2_LP_GPIO_LOW);
+			renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_FEM_TX_BYPASS, sizeof(REGISTER_IMAGE_FEM_TX_BYPASS));
 			break;
 
 		case S2LP_FEM_MODE_TX:
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CSD_GPIO, S2_LP_GPIO_HIGH);
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CTX_GPIO, S2_LP_GPIO_HIGH);
-			renard_phy_s2lp_write(GPIOx_CONF_ADDR_OFFSET + RENARD_PHY_S2LP_FEM_CPS_GPIO, S2_LP_GPIO_HIGH);
+			renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_FEM_TX, sizeof(REGISTER_IMAGE_FEM_TX));
 			break;
 	}
 }
@@ -133,42 +414,27 @@ static void fem_mode(renard_phy_s2lp_fem_mode_t mode)
 /*
  * Private RX / TX mode initialization functions
  */
-static void renard_phy_s2lp_tx_rf_init(void)
+static void renard_phy_s2lp_tx_rf_init(renard_phy_s2lp_t *phy)
 {
-	/* Switch to "Direct through FIFO mode" and configure power levels */
-	renard_phy_s2lp_write(PCKTCTRL1_ADDR, 0x04);
-	renard_phy_s2lp_write(PA_POWER0_ADDR, 0x07);
-
-	renard_phy_s2lp_write(PA_CONFIG1_ADDR, 0x01);
+	/* Switch to "Direct through FIFO mode" */
+	renard_phy_s2lp_write(phy, PCKTCTRL1_ADDR, 0x04);
 
 	/*
-	 * Configure SMPS switching frequency and setup PA configuration:
-	 * KRM = 0x1c28 = 7208, fdig = 25MHz: FSW = 7208 * fdig / 2**15 = 5.5MHz
-	 * These values as well as those for PA_CONFIG1_ADDR and SYNTH_CONFIG2_ADDR are directly taken from STM32's original
-	 * S2-LP Sigfox demo application, they have probably been optimized for minimal power consumption / reliability.
+	 * Configure power levels, PA configuration, charge pump and SMPS switching frequency, see register_images.c.
+	 * Clearing FIR_EN in PA_CONFIG1_ADDR is directly taken from STM32's original S2-LP Sigfox demo application.
 	 */
-	renard_phy_s2lp_write(PM_CONF3_ADDR, 0x9c);
-	renard_phy_s2lp_write(PM_CONF2_ADDR, 0x28);
-	renard_phy_s2lp_write(PA_CONFIG1_ADDR, renard_phy_s2lp_read(PA_CONFIG1_ADDR) & 0xfd);
-	renard_phy_s2lp_write(PA_CONFIG0_ADDR, 0xc8);
-	renard_phy_s2lp_write(SYNTH_CONFIG2_ADDR, 0xd3);
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_TX_PA, sizeof(REGISTER_IMAGE_TX_PA));
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_TX_PM, sizeof(REGISTER_IMAGE_TX_PM));
+	renard_phy_s2lp_write(phy, PA_CONFIG1_ADDR, renard_phy_s2lp_read(phy, PA_CONFIG1_ADDR) & 0xfd);
 }
 
-static void renard_phy_s2lp_rx_rf_init(void)
+static void renard_phy_s2lp_rx_rf_init(renard_phy_s2lp_t *phy)
 {
-	/* Configure data rate and frequency deviation */
-	renard_phy_s2lp_write(MOD4_ADDR, (DOWNLINK_DATARATE_M >> 8) & 0xff);
-	renard_phy_s2lp_write(MOD3_ADDR, (DOWNLINK_DATARATE_M >> 0) & 0xff);
-	renard_phy_s2lp_write(MOD2_ADDR, (DOWNLINK_MOD_TYPE << 4) | DOWNLINK_DATARATE_E);
-	renard_phy_s2lp_write(MOD1_ADDR, DOWNLINK_FDEV_E);
-	renard_phy_s2lp_write(MOD0_ADDR, DOWNLINK_FDEV_M);
+	/* Configure data rate, frequency deviation, RX filter bandwidth and AFC, see register_images.c */
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_RX_MOD, sizeof(REGISTER_IMAGE_RX_MOD));
 
 	/* Disable automatic packet decoding (CRC, FEC, Encoding, ...) + set 15-byte packet length */
-	renard_phy_s2lp_write(PCKTCTRL3_ADDR, 0);
-	renard_phy_s2lp_write(PCKTCTRL2_ADDR, 0);
-	renard_phy_s2lp_write(PCKTCTRL1_ADDR, 0);
-	renard_phy_s2lp_write(PCKTLEN1_ADDR, 0);
-	renard_phy_s2lp_write(PCKTLEN0_ADDR, 15);
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_RX_PCKT, sizeof(REGISTER_IMAGE_RX_PCKT));
 
 	/*
 	 * Configure frame synchronization word:
@@ -176,269 +442,1141 @@ static void renard_phy_s2lp_rx_rf_init(void)
 	 * Sync word = SYNC1 .. SYNC0 = 0xb227 (Sigfox Downlink SYNC word)
 	 * Preamble-based synchronization is *not* used.
 	 */
-	renard_phy_s2lp_write(PCKTCTRL6_ADDR, 0x40);
-	renard_phy_s2lp_write(SYNC0_ADDR, 0xb2);
-	renard_phy_s2lp_write(SYNC1_ADDR, 0x27);
+	renard_phy_s2lp_write(phy, PCKTCTRL6_ADDR, 0x40);
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_RX_SYNC, sizeof(REGISTER_IMAGE_RX_SYNC));
 
 	/*
-	 * Configure reception RF settings and thresholds:
-	 * AFC_ENABLED = 0 --> disable automatic frequency correction
-	 * EQU_CTRL = 0b00 --> disable inter-symbol interference cancellation
-	 * CS_BLANKING = 0 --> disable minimum RSSI for data reception
+	 * Configure reception thresholds and clock recovery, see register_images.c
 	 * RSSI_TH = 7 --> Minimum RSSI detection threshold -140dBm
-	 * CLK_REC_P_GAIN_SLOW = 1 --> Clock recovery slow loop gain
-	 * CLK_REC_P_GAIN_FAST = 3 --> Clock recovery fast loop gain
-	 * PSTFLT_LEN = 1 --> 16 symbols post filter length
-	 * CHFLT_M = 8, CHFLT_E = 8 --> RX filter bandwidth 2.1kHz (see "5.5.4 RX channel filter bandwidth" table 44)
-	 *
-	 * Values taken from ST's original S2-LP Sigfox demo.
 	 */
-	renard_phy_s2lp_write(AFC2_ADDR, 0x00);
-	renard_phy_s2lp_write(ANT_SELECT_CONF_ADDR, 0x00);
-	renard_phy_s2lp_write(RSSI_TH_ADDR, 0x07);
-	renard_phy_s2lp_write(CLOCKREC2_ADDR, 0x20);
-	renard_phy_s2lp_write(CLOCKREC1_ADDR, 0x70);
-	renard_phy_s2lp_write(CHFLT_ADDR, 0x88);
+	renard_phy_s2lp_write(phy, RSSI_TH_ADDR, 0x07);
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_RX_CLOCKREC, sizeof(REGISTER_IMAGE_RX_CLOCKREC));
 
-	/*
-	 * Configure SMPS switching frequency
-	 * KRM = 0x0800 = 2048, fdig = 25MHz: FSW = 2048 * fdig / 2**15 = 1.563MHz
-	 * Values taken from ST's original S2-LP Sigfox demo.
-	 */
-	renard_phy_s2lp_write(PM_CONF3_ADDR, 0x88);
-	renard_phy_s2lp_write(PM_CONF2_ADDR, 0x00);
+	/* Configure SMPS switching frequency */
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_RX_PM, sizeof(REGISTER_IMAGE_RX_PM));
+
+	/* Restore PA configuration to reset values in case S2-LP was in TX mode before, configure charge pump */
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_RX_PA, sizeof(REGISTER_IMAGE_RX_PA));
+
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+	/* RX timer stop condition: Stop RX timer once the SYNC word has been detected */
+	renard_phy_s2lp_write(phy, PROTOCOL2_ADDR, PROTOCOL2_SQI_TIMEOUT_MASK);
+#endif
 }
 
 /**********************************************************************************************************************/
 
 /*
- * Other private functions
+ * Private TX symbol sequencing, shared by blocking and asynchronous transmission:
+ * renard_phy_s2lp_tx_sequence: Get next symbol to transmit, FIFO_SYMBOL_COUNT once frame is complete
+ * renard_phy_s2lp_tx_symbols: Set power adjustment of symbol waveforms, with the symbol cache expand them into the
+ *	 driver context if it has changed
+ * renard_phy_s2lp_tx_waveform: Write part of a symbol's waveform (SPI transfer including FIFO write command) to buffer
+ * renard_phy_s2lp_tx_symbol: Get a symbol's complete waveform, expanded into one of the refill buffers (slot) unless
+ *	 the symbol cache is enabled
+ * renard_phy_s2lp_tx_next: Get next FIFO refill: Either the next symbol (sent straight from the symbol cache if
+ *	 enabled) or, with packed refills, as much of the remaining symbols as fits into the FIFO, written to one of the
+ *	 refill buffers (slot). Refill data is NULL once frame is complete.
+ * renard_phy_s2lp_tx_refill: Write refill to FIFO, called whenever FIFO is almost empty
+ * renard_phy_s2lp_tx_prepare: Configure S2-LP for uplink, fill FIFO with "Extra Symbol Before Frame" (part 1)
+ * renard_phy_s2lp_tx_finish: Stop transmission once FIFO has run empty
+ * The sequencing state, report and refill buffers are part of the driver context (see renard_phy_s2lp.h).
  */
-static void renard_phy_s2lp_reset(void)
-{
-	/* Power-On-Reset S2-LP (see datasheet "5.2 Power-On-Reset") */
-	renard_phy_s2lp_hal_shutdown(true);
-	renard_phy_s2lp_hal_interrupt_timeout(2);
-	renard_phy_s2lp_hal_interrupt_wait();
-	renard_phy_s2lp_hal_shutdown(false);
-	renard_phy_s2lp_hal_interrupt_timeout(2);
-	renard_phy_s2lp_hal_interrupt_wait();
-	renard_phy_s2lp_hal_interrupt_clear();
-}
-
-/**********************************************************************************************************************/
+#if (RENARD_PHY_S2LP_TX_PACKED_REFILL == 1)
 
 /*
- * Public interface
+ * The FIFO almost empty threshold has to cover everything that the S2-LP transmits while a refill is pending.
+ * Every symbol consists of 80 FIFO bytes, so the FIFO drains at 80 * datarate bytes per second (8000 bytes/s at 100bps,
+ * 48000 bytes/s at 600bps). Round up to whole byte couples and add one byte couple of margin. The threshold is limited
+ * to half the FIFO size so that every refill still writes at least as much data as the threshold.
  */
-bool renard_phy_s2lp_init(void)
+static uint8_t renard_phy_s2lp_tx_threshold(renard_phy_s2lp_ul_datarate_t datarate)
 {
-	renard_phy_s2lp_hal_init();
-	renard_phy_s2lp_reset();
+	uint32_t bytes_per_second = FIFO_SYMBOL_LENGTH * (datarate == UL_DATARATE_600BPS ? 600 : 100);
+	uint32_t threshold = ((uint32_t)RENARD_PHY_S2LP_REFILL_LATENCY_US * bytes_per_second + 999999) / 1000000;
 
-	uint8_t partnum = renard_phy_s2lp_read(DEVICE_INFO1_ADDR);
-	uint8_t version = renard_phy_s2lp_read(DEVICE_INFO0_ADDR);
+	threshold = (threshold + 1) / 2 * 2 + 2;
 
-	/* Check if S2-LP responds to SPI commands by verifying PARTNUM and VERSION information */
-	return (partnum == 0x03) && (version == 0xc1 || version == 0x91);
+	return threshold > RENARD_PHY_S2LP_FIFO_SIZE / 2 ? RENARD_PHY_S2LP_FIFO_SIZE / 2 : threshold;
 }
 
+#endif
 
-void renard_phy_s2lp_mode(renard_phy_s2lp_mode_t mode)
+/*
+ * Symbol cache, see conf_driver.h
+ * With FEM, the adjustment only changes when switching RC profiles, without FEM the cached waveforms are only expanded
+ * once at init.
+ */
+static void renard_phy_s2lp_tx_symbols(renard_phy_s2lp_t *phy, int8_t adjustment)
 {
-	renard_phy_s2lp_reset();
+	if (adjustment == phy->symbols_adjustment)
+		return;
 
-	/*
-	 * Choose correct digital domain clock: f_XO or f_XO / 2
-	 * Also, I have verified that writing writing 0x2e to XO_RCO_CONF1_ADDR massively reduces frequency drift.
-	 * This is something that is also done by STMicro's original S2-LP Sigfox Middleware (X-CUBE-SFXS2LP1), but it is
-	 * currently not documented in the datasheet.
-	 */
-	renard_phy_s2lp_write(XO_RCO_CONF1_ADDR, 0x2e | ((DISABLE_CLKDIV << 4) & 0x10));
+#if (RENARD_PHY_S2LP_TX_SYMBOL_CACHE == 1)
+	for (fifo_symbol_t symbol = 0; symbol < FIFO_SYMBOL_COUNT; symbol++)
+		fifo_symbol_expand(symbol, adjustment, 0, FIFO_SYMBOL_LENGTHS[symbol], phy->symbols[symbol]);
+#endif
 
-	if (mode == S2LP_MODE_TX)
-		renard_phy_s2lp_tx_rf_init();
-	else
-		renard_phy_s2lp_rx_rf_init();
+	phy->symbols_adjustment = adjustment;
 }
 
-void renard_phy_s2lp_stop(void)
+#if (RENARD_PHY_S2LP_TX_PACKED_REFILL == 1)
+
+static void renard_phy_s2lp_tx_waveform(renard_phy_s2lp_t *phy, fifo_symbol_t symbol, uint8_t offset, uint8_t count,
+		uint8_t *buffer)
 {
-	renard_phy_s2lp_cmd(CMD_SABORT);
-	renard_phy_s2lp_hal_shutdown(true);
+#if (RENARD_PHY_S2LP_TX_SYMBOL_CACHE == 1)
+	memcpy(buffer, &phy->symbols[symbol][offset], count);
+#else
+	fifo_symbol_expand(symbol, phy->symbols_adjustment, offset, count, buffer);
+#endif
 }
 
-void renard_phy_s2lp_tx(uint8_t *stream, uint8_t size, renard_phy_s2lp_ul_datarate_t datarate,
-		renard_phy_s2lp_rc_t rc_profile)
+#else
+
+static const uint8_t *renard_phy_s2lp_tx_symbol(renard_phy_s2lp_t *phy, fifo_symbol_t symbol, uint8_t slot)
 {
-#if RENARD_PHY_S2LP_HAVE_FEM == 1
-	/*
-	 * Optional, if present: Configure front-end module
-	 */
-	fem_mode(renard_phy_s2lp_bypass_fem_by_rc[rc_profile] ? S2LP_FEM_MODE_TX_BYPASS : S2LP_FEM_MODE_TX);
+#if (RENARD_PHY_S2LP_TX_SYMBOL_CACHE == 1)
+	(void)slot;
+	return phy->symbols[symbol];
+#else
+	fifo_symbol_expand(symbol, phy->symbols_adjustment, 0, FIFO_SYMBOL_LENGTHS[symbol], phy->tx_buffers[slot]);
+	return phy->tx_buffers[slot];
 #endif
+}
 
-	/* Configure S2-LP data rate (100bps, 600bps) */
-	uint8_t rate_e = (datarate == UL_DATARATE_600BPS) ? UPLINK_600BPS_DATARATE_E : UPLINK_100BPS_DATARATE_E;
-	uint16_t rate_m = (datarate == UL_DATARATE_600BPS) ? UPLINK_600BPS_DATARATE_M : UPLINK_100BPS_DATARATE_M;
-	uint8_t fdev_e = (datarate == UL_DATARATE_600BPS) ? UPLINK_600BPS_FDEV_E : UPLINK_100BPS_FDEV_E;
-	uint8_t fdev_m = (datarate == UL_DATARATE_600BPS) ? UPLINK_600BPS_FDEV_M : UPLINK_100BPS_FDEV_M;
-
-	/* Configure datarate, modulation type, frequency deviation, enable PA power interpolator */
-	renard_phy_s2lp_write(MOD4_ADDR, (rate_m >> 8) & 0xff);
-	renard_phy_s2lp_write(MOD3_ADDR, (rate_m >> 0) & 0xff);
-	renard_phy_s2lp_write(MOD2_ADDR, rate_e | (UPLINK_MOD_TYPE << 4));
-	renard_phy_s2lp_write(MOD1_ADDR, fdev_e | 0x80);
-	renard_phy_s2lp_write(MOD0_ADDR, fdev_m);
+#endif
 
-	/*
-	 * Configure "FIFO almost empty" GPIO interrupt:
-	 * --> S2-LP Conf: Set "almost empty" treshold down to 48 bytes:
-	 *	 FIFO size is 128 bytes, max. symbol size is 80 bytes: 128 - 80 = 48 bytes.
-	 * --> S2-LP GPIO: Output FIFO almost empty flag on GPIO3
-	 * --> MCU GPIO: Enable interrupt with renard_phy_s2lp_hal_interrupt_gpio
-	 */
-	renard_phy_s2lp_write(FIFO_CONFIG0_ADDR, 48);
-	renard_phy_s2lp_write(GPIO3_CONF_ADDR, 0x32);
-	renard_phy_s2lp_hal_interrupt_gpio(true);
-
-	/* Transmit "Extra Symbol Before Frame": First fill FIFO, then tell S2-LP to transmit FIFO contents */
-	renard_phy_s2lp_cmd(CMD_FLUSHTXFIFO);
-	renard_phy_s2lp_symbol(FIFO_POLAR_BEFOREFRAME_1, sizeof(FIFO_POLAR_BEFOREFRAME_1), rc_profile);
-	renard_phy_s2lp_cmd(CMD_TX);
-	renard_phy_s2lp_hal_interrupt_wait();
-	renard_phy_s2lp_symbol(FIFO_POLAR_BEFOREFRAME_2, sizeof(FIFO_POLAR_BEFOREFRAME_2), rc_profile);
-
-	/* Transmit actual DBPSK bits */
-	uint8_t byte_index = 0;
-	uint8_t bit_index = 7;
-
-	while (byte_index < size)
-	{
-		/* Fetch current bit */
-		uint8_t bit = (stream[byte_index] >> bit_index) & 0x01;
-
-		/* Transmit bit: Always switch between +180° and -180° phase shifts (bit_index % 2 == 0) */
-		renard_phy_s2lp_hal_interrupt_wait();
-		if (bit == 0) {
-			if (bit_index % 2 == 0) {
-				renard_phy_s2lp_symbol(FIFO_POLAR_ZERO_FDEV_NEG, sizeof(FIFO_POLAR_ZERO_FDEV_NEG), rc_profile);
+static fifo_symbol_t renard_phy_s2lp_tx_sequence(renard_phy_s2lp_t *phy)
+{
+	switch (phy->tx.stage) {
+		case TX_STAGE_BEFOREFRAME:
+			phy->tx.stage = phy->tx.size > 0 ? TX_STAGE_BITS : TX_STAGE_AFTERFRAME_1;
+			return FIFO_SYMBOL_BEFOREFRAME_2;
+
+		case TX_STAGE_BITS:
+		{
+			/* Fetch current bit */
+			uint8_t bit = (phy->tx.stream[phy->tx.byte_index] >> phy->tx.bit_index) & 0x01;
+
+			/* Transmit bit: Always switch between +180° and -180° phase shifts (bit_index % 2 == 0) */
+			fifo_symbol_t symbol = FIFO_SYMBOL_ONE;
+			if (bit == 0)
+				symbol = (phy->tx.bit_index % 2 == 0) ? FIFO_SYMBOL_ZERO_FDEV_NEG : FIFO_SYMBOL_ZERO_FDEV_POS;
+
+			/* Go to next bit */
+			if (phy->tx.bit_index == 0) {
+				phy->tx.bit_index = 7;
+				phy->tx.byte_index++;
 			} else {
-				renard_phy_s2lp_symbol(FIFO_POLAR_ZERO_FDEV_POS, sizeof(FIFO_POLAR_ZERO_FDEV_POS), rc_profile);
+				phy->tx.bit_index--;
 			}
-		} else {
-			renard_phy_s2lp_symbol(FIFO_POLAR_ONE, sizeof(FIFO_POLAR_ONE), rc_profile);
+
+			if (phy->tx.byte_index == phy->tx.size)
+				phy->tx.stage = TX_STAGE_AFTERFRAME_1;
+
+			return symbol;
 		}
 
-		/* Go to next bit */
-		if (bit_index == 0) {
-			bit_index = 7;
-			byte_index++;
-		} else {
-			bit_index--;
+		case TX_STAGE_AFTERFRAME_1:
+			phy->tx.stage = TX_STAGE_AFTERFRAME_2;
+			return FIFO_SYMBOL_AFTERFRAME_1;
+
+		case TX_STAGE_AFTERFRAME_2:
+			phy->tx.stage = TX_STAGE_DONE;
+			return FIFO_SYMBOL_AFTERFRAME_2;
+
+		default:
+			return FIFO_SYMBOL_COUNT;
+	}
+}
+
+#if (RENARD_PHY_S2LP_TX_PACKED_REFILL == 1)
+
+/*
+ * Packed refill: Copy symbol waveforms into refill buffer until the free FIFO space is used up, continuing across
+ * symbol boundaries. phy->tx.symbol / phy->tx.offset track how much of the current symbol has already been written.
+ */
+static void renard_phy_s2lp_tx_next(renard_phy_s2lp_t *phy, renard_phy_s2lp_tx_refill_t *refill, uint8_t slot)
+{
+	uint8_t *buffer = phy->tx_buffers[slot];
+	uint8_t length = FIFO_CMD_LENGTH;
+
+	buffer[0] = 0x00;
+	buffer[1] = FIFO_ADDR;
+
+	while (phy->tx.symbol != FIFO_SYMBOL_COUNT && length < FIFO_CMD_LENGTH + phy->tx.space) {
+		uint8_t count = FIFO_SYMBOL_LENGTHS[phy->tx.symbol] - phy->tx.offset;
+		if (count > FIFO_CMD_LENGTH + phy->tx.space - length)
+			count = FIFO_CMD_LENGTH + phy->tx.space - length;
+
+		renard_phy_s2lp_tx_waveform(phy, phy->tx.symbol, phy->tx.offset, count, &buffer[length]);
+		length += count;
+		phy->tx.offset += count;
+
+		if (phy->tx.offset == FIFO_SYMBOL_LENGTHS[phy->tx.symbol]) {
+			phy->tx.symbol = renard_phy_s2lp_tx_sequence(phy);
+			phy->tx.offset = FIFO_CMD_LENGTH;
 		}
 	}
 
-	/* Transmit first part of "Extra Symbol After Frame" */
-	renard_phy_s2lp_hal_interrupt_wait();
-	renard_phy_s2lp_symbol(FIFO_POLAR_AFTERFRAME_1, sizeof(FIFO_POLAR_AFTERFRAME_1), rc_profile);
-	renard_phy_s2lp_hal_interrupt_wait();
+	refill->data = length > FIFO_CMD_LENGTH ? buffer : NULL;
+	refill->length = length;
+	refill->last = phy->tx.symbol == FIFO_SYMBOL_COUNT;
+}
 
-	/* Transmit final part of "Extra Symbol After Frame" - set FIFO almost empty threshold to zero so that
-	   complete FIFO contents get transmitted */
-	renard_phy_s2lp_write(FIFO_CONFIG0_ADDR, 0x00);
-	renard_phy_s2lp_symbol(FIFO_POLAR_AFTERFRAME_2, sizeof(FIFO_POLAR_AFTERFRAME_2), rc_profile);
-	renard_phy_s2lp_hal_interrupt_wait();
+#else
 
-	/* Stop S2-LP transmission */
-	renard_phy_s2lp_cmd(CMD_SABORT);
-	renard_phy_s2lp_cmd(CMD_FLUSHTXFIFO);
-	renard_phy_s2lp_hal_interrupt_clear();
-#if RENARD_PHY_S2LP_HAVE_FEM == 1
-	fem_mode(S2LP_FEM_MODE_SHUTDOWN);
+static void renard_phy_s2lp_tx_next(renard_phy_s2lp_t *phy, renard_phy_s2lp_tx_refill_t *refill, uint8_t slot)
+{
+	fifo_symbol_t symbol = renard_phy_s2lp_tx_sequence(phy);
+
+	if (symbol == FIFO_SYMBOL_COUNT) {
+		refill->data = NULL;
+		return;
+	}
+
+	refill->data = renard_phy_s2lp_tx_symbol(phy, symbol, slot);
+	refill->length = FIFO_SYMBOL_LENGTHS[symbol];
+	refill->last = symbol == FIFO_SYMBOL_AFTERFRAME_2;
+}
+
+#endif
+
+/*
+ * Refill bookkeeping, shared by blocking and asynchronous transmission:
+ * renard_phy_s2lp_tx_level: TX FIFO level right before a refill if RENARD_PHY_S2LP_TX_FIFO_MONITOR is enabled, 0xff
+ *	 otherwise
+ * renard_phy_s2lp_tx_refilled: Refill has been written to the FIFO, update statistics and TX report with the FIFO level
+ *	 before the refill and, for the final refill, IRQ_STATUS0. The S2-LP latches TX FIFO underflows in IRQ_STATUS0. The
+ *	 FIFO also runs empty at the end of every frame, so IRQ_STATUS0 is read right after the final refill has been
+ *	 written, when that cannot have happened yet.
+ */
+static uint8_t renard_phy_s2lp_tx_level(renard_phy_s2lp_t *phy)
+{
+#if (RENARD_PHY_S2LP_TX_FIFO_MONITOR == 1)
+	return renard_phy_s2lp_read(phy, TX_FIFO_STATUS_ADDR);
+#else
+	(void)phy;
+	return 0xff;
 #endif
 }
 
-void renard_phy_s2lp_frequency(uint32_t frequency)
+static void renard_phy_s2lp_tx_refilled(renard_phy_s2lp_t *phy, const renard_phy_s2lp_tx_refill_t *refill,
+		uint8_t level, uint8_t irq_status0)
 {
-	/*
-	 * Frequency selection is explained in datasheet section 5.3.1, equations 6 / 7 / 8 / 9:
-	 * Since CHNUM = 0, f_c = f_base here, so equation 7 effectively defines frequency selection:
-	 * --> synth = 2^19 * B * D * f_base / f_xo
-	 * --> where B = 4 since we are in the 826-1055MHz band.
-	 * --> where D = 1 since REFDIV XO_RCO_CONFIG0 is 0 (has nothing to do with digital domain clock divider)
-	 * The maximum error we make by rounding synth to an integer is on the order of 25Hz which is safe to ignore
-	 * considering the error due to XTAL imperfections can be >15kHz (20ppm XTAL)
-	 */
-	uint32_t synth_freq = 4 * frequency;
-	uint32_t synth = ((uint64_t)1 << 19) * synth_freq / S2LP_XTAL_FREQ;
+	renard_phy_s2lp_stats_refill(phy, refill->length);
 
-	/*
-	 * Charge pump configuration, see datsheet section 5.3 and table 37: "Charge pump words"
-	 * The logic for selecting PLL_PFD_SPLIT_EN and PLL_CP_ISEL has been taken from X-CUBE-SFXS2LP1
-	 */
-	uint8_t pll_pfd_split_en = DISABLE_CLKDIV ? 1 : 0;
-	uint8_t pll_cp_isel = (synth_freq < 3600000000) ?
-		(DISABLE_CLKDIV ? 0x02 : 0x03) :
-		(DISABLE_CLKDIV ? 0x01 : 0x02);
+	if (level < phy->tx_report.min_fifo_level)
+		phy->tx_report.min_fifo_level = level;
 
-	renard_phy_s2lp_write(SYNTH_CONFIG2_ADDR, (renard_phy_s2lp_read(SYNTH_CONFIG2_ADDR) & (~0x04)) |
-			(pll_pfd_split_en << 2));
-	renard_phy_s2lp_write(SYNT3_ADDR, ((synth >> 24) & 0x0f) | (pll_cp_isel << 5));
-	renard_phy_s2lp_write(SYNT2_ADDR, (synth >> 16) & 0xff);
-	renard_phy_s2lp_write(SYNT1_ADDR, (synth >> 8) & 0xff);
-	renard_phy_s2lp_write(SYNT0_ADDR, (synth >> 0) & 0xff);
+	if (refill->last && (irq_status0 & IRQ0_TX_FIFO_ERROR))
+		phy->tx_report.underrun = true;
 }
 
-bool renard_phy_s2lp_rx(uint8_t *frame, int16_t *rssi)
+static void renard_phy_s2lp_tx_refill(renard_phy_s2lp_t *phy, const renard_phy_s2lp_tx_refill_t *refill, uint8_t level)
 {
-#if RENARD_PHY_S2LP_HAVE_FEM == 1
-	/*
-	 * Optional, if present: Configure front-end module
-	 */
-	fem_mode(S2LP_FEM_MODE_RX);
-#endif
+	uint8_t irq_status0 = 0x00;
 
-	/* disable all IRQs except for RX DATA READY */
-	renard_phy_s2lp_write(IRQ_MASK3_ADDR, 0x00);
-	renard_phy_s2lp_write(IRQ_MASK2_ADDR, 0x00);
-	renard_phy_s2lp_write(IRQ_MASK1_ADDR, 0x00);
-	renard_phy_s2lp_write(IRQ_MASK0_ADDR, 0x01);
+	/* Final part of "Extra Symbol After Frame" - set FIFO almost empty threshold to zero so that complete FIFO
+	   contents get transmitted */
+	if (refill->last)
+		renard_phy_s2lp_write(phy, FIFO_CONFIG0_ADDR, 0x00);
 
-	/* GPIO configuration: nIRQ (interrupt request, active low --> falling edge on MCU) on GPIO3 */
-	renard_phy_s2lp_write(GPIO3_CONF_ADDR, 0x02);
-	renard_phy_s2lp_hal_interrupt_gpio(false);
+	renard_phy_s2lp_spi(phy, refill->length, (uint8_t *)refill->data, NULL);
 
-	/* clean up: flush FIFO and clear IRQ STATUS registers */
-	renard_phy_s2lp_cmd(CMD_FLUSHRXFIFO);
-	renard_phy_s2lp_read(IRQ_STATUS3_ADDR);
-	renard_phy_s2lp_read(IRQ_STATUS2_ADDR);
-	renard_phy_s2lp_read(IRQ_STATUS1_ADDR);
-	renard_phy_s2lp_read(IRQ_STATUS0_ADDR);
+	if (refill->last)
+		irq_status0 = renard_phy_s2lp_read(phy, IRQ_STATUS0_ADDR);
 
-	/* start RX */
-	renard_phy_s2lp_cmd(CMD_RX);
+	renard_phy_s2lp_tx_refilled(phy, refill, level, irq_status0);
+}
 
+static void renard_phy_s2lp_tx_prepare(renard_phy_s2lp_t *phy, const uint8_t *stream, uint8_t size,
+		renard_phy_s2lp_ul_datarate_t datarate, renard_phy_s2lp_rc_t rc_profile)
+{
+#if RENARD_PHY_S2LP_HAVE_FEM == 1
 	/*
-	 * Downlink procedure is over if either:
-	 * --> a downlink timer interrupt occurs
-	 * --> the S2-LP received some data; only in that case will the S2-LP generate a GPIO interrupt
+	 * Optional, if present: Configure front-end module and adjust power of symbol waveforms to RC profile
 	 */
-	bool is_gpio_ir = renard_phy_s2lp_hal_interrupt_wait();
+	fem_mode(phy, renard_phy_s2lp_bypass_fem_by_rc[rc_profile] ? S2LP_FEM_MODE_TX_BYPASS : S2LP_FEM_MODE_TX);
+	renard_phy_s2lp_tx_symbols(phy, renard_phy_s2lp_fem_power_adjustment_by_rc[rc_profile]);
+#else
+	(void)rc_profile;
+#endif
 
-	/* stop RX, disable interrupts */
-	renard_phy_s2lp_cmd(CMD_SABORT);
+	/* Configure datarate (100bps, 600bps), modulation type, frequency deviation, enable PA power interpolator */
+	if (datarate == UL_DATARATE_600BPS)
+		renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_TX_MOD_600BPS, sizeof(REGISTER_IMAGE_TX_MOD_600BPS));
+	else
+		renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_TX_MOD_100BPS, sizeof(REGISTER_IMAGE_TX_MOD_100BPS));
+
+	/*
+	 * Configure "FIFO almost empty" GPIO interrupt:
+	 * --> S2-LP Conf: Set "almost empty" treshold down to 48 bytes:
+	 *	 FIFO size is 128 bytes, max. symbol size is 80 bytes: 128 - 80 = 48 bytes.
+	 *	 With packed refills, the threshold is computed from datarate and refill latency instead.
+	 * --> S2-LP GPIO: Output FIFO almost empty flag on GPIO3
+	 * --> MCU GPIO: Enable interrupt with renard_phy_s2lp_interrupt_gpio
+	 */
+#if (RENARD_PHY_S2LP_TX_PACKED_REFILL == 1)
+	uint8_t threshold = renard_phy_s2lp_tx_threshold(datarate);
+	renard_phy_s2lp_write(phy, FIFO_CONFIG0_ADDR, threshold);
+#else
+	renard_phy_s2lp_write(phy, FIFO_CONFIG0_ADDR, 48);
+#endif
+	renard_phy_s2lp_write(phy, GPIO3_CONF_ADDR, 0x32);
+	renard_phy_s2lp_interrupt_gpio(phy, true);
+
+	/*
+	 * Latch TX FIFO underflows in IRQ_STATUS0 (the almost empty flag goes to GPIO3 directly, not through nIRQ), and
+	 * clear IRQ_STATUS0, which still holds the underflow from the end of the previous frame
+	 */
+	renard_phy_s2lp_write(phy, IRQ_MASK0_ADDR, IRQ0_TX_FIFO_ERROR);
+	renard_phy_s2lp_read(phy, IRQ_STATUS0_ADDR);
+	phy->tx_report.underrun = false;
+	phy->tx_report.min_fifo_level = 0xff;
+
+	phy->tx.stream = stream;
+	phy->tx.size = size;
+	phy->tx.byte_index = 0;
+	phy->tx.bit_index = 7;
+	phy->tx.stage = TX_STAGE_BEFOREFRAME;
+
+	/* Transmit "Extra Symbol Before Frame": First fill FIFO, then tell S2-LP to transmit FIFO contents (CMD_TX) */
+	renard_phy_s2lp_cmd(phy, CMD_FLUSHTXFIFO);
+#if (RENARD_PHY_S2LP_TX_PACKED_REFILL == 1)
+	renard_phy_s2lp_tx_refill_t refill;
+
+	phy->tx.symbol = FIFO_SYMBOL_BEFOREFRAME_1;
+	phy->tx.offset = FIFO_CMD_LENGTH;
+	phy->tx.space = RENARD_PHY_S2LP_FIFO_SIZE;
+	renard_phy_s2lp_tx_next(phy, &refill, 0);
+	renard_phy_s2lp_tx_refill(phy, &refill, 0xff);
+	phy->tx.space = RENARD_PHY_S2LP_FIFO_SIZE - threshold;
+#else
+	renard_phy_s2lp_spi(phy, FIFO_SYMBOL_LENGTHS[FIFO_SYMBOL_BEFOREFRAME_1],
+			(uint8_t *)renard_phy_s2lp_tx_symbol(phy, FIFO_SYMBOL_BEFOREFRAME_1, 0), NULL);
+#endif
+}
+
+static void renard_phy_s2lp_tx_finish(renard_phy_s2lp_t *phy)
+{
+	/* Stop S2-LP transmission */
+	renard_phy_s2lp_cmd(phy, CMD_SABORT);
+	renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_IDLE);
+	renard_phy_s2lp_cmd(phy, CMD_FLUSHTXFIFO);
+	renard_phy_s2lp_interrupt_clear(phy);
 #if RENARD_PHY_S2LP_HAVE_FEM == 1
-	fem_mode(S2LP_FEM_MODE_SHUTDOWN);
+	fem_mode(phy, S2LP_FEM_MODE_SHUTDOWN);
 #endif
+}
 
-	if (is_gpio_ir) {
-		uint8_t length = renard_phy_s2lp_read(RX_FIFO_STATUS_ADDR);
-		for (uint8_t i = 0; i < length; i++)
-			frame[i] = renard_phy_s2lp_read(FIFO_ADDR);
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+
+/*
+ * Asynchronous transmission: FIFO refills are started from the "FIFO almost empty" GPIO interrupt as asynchronous SPI
+ * transfers (e.g. DMA). Refills are double-buffered: While one refill is being transferred, the next one is already
+ * queued, so that the interrupt handler only has to start a transfer. The following refill is computed once the
+ * transfer has completed.
+ * Nothing blocks in interrupt context: The register accesses around a refill (FIFO level with
+ * RENARD_PHY_S2LP_TX_FIFO_MONITOR, threshold before and IRQ_STATUS0 after the final refill) and stopping transmission
+ * once the FIFO has run empty are asynchronous SPI transfers as well. phy->tx_async.spi is the transfer in progress,
+ * renard_phy_s2lp_async_spi_done starts the next one.
+ * Interrupts that occur while no asynchronous transmission is active are latched in phy->async_events until they are
+ * consumed with renard_phy_s2lp_async_event, e.g. by the non-blocking protocol transfer.
+ */
+static void renard_phy_s2lp_tx_async_stop(renard_phy_s2lp_t *phy)
+{
+	renard_phy_s2lp_interrupt_async(phy, false);
+	renard_phy_s2lp_tx_finish(phy);
+	phy->tx_async.active = false;
+}
+
+static void renard_phy_s2lp_tx_async_spi(renard_phy_s2lp_t *phy, renard_phy_s2lp_tx_async_spi_t spi)
+{
+	const renard_phy_s2lp_tx_refill_t *refill = &phy->tx_async.queue[phy->tx_async.queue_head];
+	uint8_t *out = phy->tx_async.spi_out;
+	uint8_t *in = NULL;
+	uint8_t length = 3;
+
+	switch (spi) {
+		case TX_ASYNC_SPI_MONITOR:
+		case TX_ASYNC_SPI_UNDERRUN:
+			out[0] = 0x01;
+			out[1] = spi == TX_ASYNC_SPI_MONITOR ? TX_FIFO_STATUS_ADDR : IRQ_STATUS0_ADDR;
+			out[2] = 0xff;
+			in = phy->tx_async.spi_in;
+			break;
+
+		case TX_ASYNC_SPI_THRESHOLD:
+			/* Same as renard_phy_s2lp_tx_refill: Transmit complete FIFO contents after the final refill */
+			renard_phy_s2lp_shadow_set(phy, FIFO_CONFIG0_ADDR, 0x00);
+			out[0] = 0x00;
+			out[1] = FIFO_CONFIG0_ADDR;
+			out[2] = 0x00;
+			break;
+
+		case TX_ASYNC_SPI_REFILL:
+			out = (uint8_t *)refill->data;
+			length = refill->length;
+			break;
+
+		case TX_ASYNC_SPI_ABORT:
+		case TX_ASYNC_SPI_FLUSH:
+			out[0] = 0x80;
+			out[1] = spi == TX_ASYNC_SPI_ABORT ? CMD_SABORT : CMD_FLUSHTXFIFO;
+			length = 2;
+			break;
+
+#if RENARD_PHY_S2LP_HAVE_FEM == 1
+		case TX_ASYNC_SPI_FEM:
+			out = (uint8_t *)REGISTER_IMAGE_FEM_SHUTDOWN;
+			length = sizeof(REGISTER_IMAGE_FEM_SHUTDOWN);
+			break;
+#endif
+
+		default:
+			return;
+	}
+
+	phy->tx_async.spi = spi;
+	renard_phy_s2lp_spi_async(phy, length, out, in);
+}
+
+/* Same as renard_phy_s2lp_tx_async_stop, but chained through asynchronous SPI transfers from interrupt context */
+static void renard_phy_s2lp_tx_async_stop_start(renard_phy_s2lp_t *phy)
+{
+	renard_phy_s2lp_interrupt_async(phy, false);
+	renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_IDLE);
+	renard_phy_s2lp_tx_async_spi(phy, TX_ASYNC_SPI_ABORT);
+}
+
+static void renard_phy_s2lp_tx_async_stop_done(renard_phy_s2lp_t *phy)
+{
+	renard_phy_s2lp_interrupt_clear(phy);
+	phy->tx_async.active = false;
+
+	if (phy->tx_async.done != NULL)
+		phy->tx_async.done(phy->tx_async.done_context);
+}
+
+static void renard_phy_s2lp_tx_async_refill(renard_phy_s2lp_t *phy)
+{
+	const renard_phy_s2lp_tx_refill_t *refill = &phy->tx_async.queue[phy->tx_async.queue_head];
+
+	if (refill->data == NULL)
+		renard_phy_s2lp_tx_async_stop_start(phy);
+	else if (RENARD_PHY_S2LP_TX_FIFO_MONITOR == 1)
+		renard_phy_s2lp_tx_async_spi(phy, TX_ASYNC_SPI_MONITOR);
+	else
+		renard_phy_s2lp_tx_async_spi(phy, refill->last ? TX_ASYNC_SPI_THRESHOLD : TX_ASYNC_SPI_REFILL);
+}
+
+#endif
+
+/**********************************************************************************************************************/
+
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1) || (RENARD_PHY_S2LP_RX_SNIFF == 1)
+
+/*
+ * RX timer, used for the hardware RX timeout and for the listening time in sniff mode
+ * The RX timer expires after RX_TIMER_CNTR * (RX_TIMER_PRESC + 1) * 1210 / f_dig seconds (datasheet "5.7.2 RX timer"),
+ * which is at most about 3.1s for f_dig = 25MHz. renard_phy_s2lp_rx_timer computes TIMERS5 .. TIMERS4 for the given
+ * duration, rounded up to whole timer ticks.
+ */
+#define RX_TIMER_F_DIG (S2LP_XTAL_FREQ / (DISABLE_CLKDIV ? 1 : 2))
+#define RX_TIMER_TICKS_MAX (255 * 256)
+#define RX_TIMER_PERIOD_MAX_MS ((uint32_t)((uint64_t)RX_TIMER_TICKS_MAX * 1210 * 1000 / RX_TIMER_F_DIG))
+
+static void renard_phy_s2lp_rx_timer(uint32_t microseconds, uint8_t *timers)
+{
+	uint32_t ticks = ((uint64_t)microseconds * RX_TIMER_F_DIG + 1210000000 - 1) / 1210000000;
+	if (ticks > RX_TIMER_TICKS_MAX)
+		ticks = RX_TIMER_TICKS_MAX;
+
+	uint32_t prescaler = (ticks + 254) / 255;
+
+	/* TIMERS5: RX_TIMER_CNTR, TIMERS4: RX_TIMER_PRESC */
+	timers[0] = prescaler == 0 ? 0 : (ticks + prescaler - 1) / prescaler;
+	timers[1] = prescaler == 0 ? 0 : prescaler - 1;
+}
+
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+
+/*
+ * Hardware RX timeout, see conf_driver.h
+ * Timeouts longer than the RX timer's range are split into equally long periods, each covered by one run of the RX
+ * timer. The timer is stopped at SYNC word detection, so that it never cuts off a frame that is being received.
+ * phy->rx_timer_periods counts the RX timer periods left until the timeout has elapsed, including the current one.
+ * renard_phy_s2lp_rx_start arms the timer for the whole timeout and sets phy->rx_deadline (HAL timestamp at which the
+ * window ends), renard_phy_s2lp_rx_restart re-arms it for the time left until then.
+ */
+static void renard_phy_s2lp_rx_timer_arm(renard_phy_s2lp_t *phy, uint32_t microseconds)
+{
+	uint8_t image[REGISTER_IMAGE_HEADER_LENGTH + 2] = {0x00, TIMERS5_ADDR, 0x00, 0x00};
+
+	phy->rx_timer_periods = (microseconds + RX_TIMER_PERIOD_MAX_MS * 1000 - 1) / (RX_TIMER_PERIOD_MAX_MS * 1000);
+
+	if (phy->rx_timer_periods > 0) {
+		uint32_t period = (microseconds + phy->rx_timer_periods - 1) / phy->rx_timer_periods;
+		renard_phy_s2lp_rx_timer(period, &image[REGISTER_IMAGE_HEADER_LENGTH]);
+	}
+
+	renard_phy_s2lp_write_image(phy, image, sizeof(image));
+}
+
+#endif
+
+#endif
+
+#if (RENARD_PHY_S2LP_RX_SNIFF == 1)
+
+/*
+ * Sniff mode, see conf_driver.h
+ * In low duty cycle (LDC) mode, the S2-LP's wake-up timer starts RX every (LDC_TIMER_PRESC + 1) * (LDC_TIMER_CNTR + 1)
+ * / f_RCO seconds (datasheet "5.7.3 Low duty cycle mode"), f_RCO = 33.3kHz. The RX timer then ends reception after the
+ * listening time and the S2-LP goes back to SLEEP, unless the carrier sense stop condition has stopped the RX timer.
+ * timers: TIMERS5 .. TIMERS0 (RX timer, wake-up timer, no wake-up timer reload on SYNC)
+ * protocol: PROTOCOL2 .. PROTOCOL1 (RX timer stop condition, LDC mode)
+ * phy->sniff holds these register images and the RSSI threshold. All-zero timers and protocol as well as the default
+ * RSSI threshold select continuous reception.
+ */
+#define LDC_TIMER_F_RCO 33333
+#define LDC_TIMER_TICKS_MAX (256 * 256)
+
+#endif
+
+/**********************************************************************************************************************/
+
+/*
+ * Other private functions
+ * renard_phy_s2lp_reset: Power-On-Reset S2-LP
+ * renard_phy_s2lp_ready: Bring S2-LP from any active or low-power state to READY without resetting it, returns false
+ *	 if that is not possible (S2-LP shut down since last reset or not responding), then a reset is required
+ */
+static void renard_phy_s2lp_reset(renard_phy_s2lp_t *phy)
+{
+	/* Power-On-Reset S2-LP (see datasheet "5.2 Power-On-Reset"), all registers return to their reset values */
+	phy->powered = true;
+	renard_phy_s2lp_shadow_invalidate(phy);
+	renard_phy_s2lp_hal_shutdown(phy, true);
+	renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_SHUTDOWN);
+	renard_phy_s2lp_interrupt_timeout(phy, 2);
+	renard_phy_s2lp_interrupt_wait(phy);
+	renard_phy_s2lp_hal_shutdown(phy, false);
+	renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_RESET);
+	renard_phy_s2lp_interrupt_timeout(phy, 2);
+	renard_phy_s2lp_interrupt_wait(phy);
+	renard_phy_s2lp_interrupt_clear(phy);
+	renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_IDLE);
+}
+
+static bool renard_phy_s2lp_ready(renard_phy_s2lp_t *phy)
+{
+	if (!phy->powered)
+		return false;
+
+	/* MC_STATE0: Main controller state in bits 7..1, XO_ON in bit 0 */
+	uint8_t state = renard_phy_s2lp_read(phy, MC_STATE0_ADDR);
+
+	switch (state >> 1) {
+		case MC_STATE_TX:
+		case MC_STATE_RX:
+		case MC_STATE_LOCK:
+		case MC_STATE_SYNTH_SETUP:
+			renard_phy_s2lp_cmd(phy, CMD_SABORT);
+			renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_IDLE);
+			break;
+
+		case MC_STATE_STANDBY:
+		case MC_STATE_SLEEP:
+		case MC_STATE_SLEEP_NOFIFO:
+			renard_phy_s2lp_cmd(phy, CMD_READY);
+			renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_IDLE);
+			/* fall through */
+
+		case MC_STATE_READY:
+			if ((state >> 1) == MC_STATE_READY && (state & 0x01) != 0)
+				return true;
+
+			/*
+			 * Leaving STANDBY / SLEEP requires the crystal oscillator to start up again, give it 1ms. Same if it is
+			 * still starting up after renard_phy_s2lp_wakeup.
+			 */
+			renard_phy_s2lp_interrupt_timeout(phy, 1);
+			renard_phy_s2lp_interrupt_wait(phy);
+			renard_phy_s2lp_interrupt_clear(phy);
+			break;
+
+		default:
+			return false;
+	}
+
+	state = renard_phy_s2lp_read(phy, MC_STATE0_ADDR);
+	return (state >> 1) == MC_STATE_READY && (state & 0x01) != 0;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Public interface
+ */
+bool renard_phy_s2lp_init(renard_phy_s2lp_t *phy, const renard_phy_s2lp_hal_t *hal, void *hal_context)
+{
+	/* All-zero context: S2-LP not powered, shadow cache invalid, statistics and energy reset, no transmission active */
+	memset(phy, 0, sizeof(*phy));
+	phy->hal = hal;
+	phy->hal_context = hal_context;
+
+	/* Expand symbol waveforms, with the adjustment of RC1 if using FEM */
+	phy->symbols_adjustment = INT16_MIN;
+#if RENARD_PHY_S2LP_HAVE_FEM == 1
+	renard_phy_s2lp_tx_symbols(phy, renard_phy_s2lp_fem_power_adjustment_by_rc[PROFILE_RC1]);
+#else
+	renard_phy_s2lp_tx_symbols(phy, 0);
+#endif
+
+	renard_phy_s2lp_hal_init(phy);
+	renard_phy_s2lp_reset(phy);
+
+#if (RENARD_PHY_S2LP_RX_SNIFF == 1)
+	renard_phy_s2lp_sniff_t sniff = {RENARD_PHY_S2LP_SNIFF_PERIOD_MS, RENARD_PHY_S2LP_SNIFF_LISTEN_US,
+			RENARD_PHY_S2LP_SNIFF_RSSI_DBM};
+	renard_phy_s2lp_rx_sniff(phy, &sniff);
+#endif
+
+	uint8_t partnum = renard_phy_s2lp_read(phy, DEVICE_INFO1_ADDR);
+	uint8_t version = renard_phy_s2lp_read(phy, DEVICE_INFO0_ADDR);
+
+	/* Check if S2-LP responds to SPI commands by verifying PARTNUM and VERSION information */
+	return (partnum == 0x03) && (version == 0xc1 || version == 0x91);
+}
+
+
+void renard_phy_s2lp_mode(renard_phy_s2lp_t *phy, renard_phy_s2lp_mode_t mode)
+{
+	/*
+	 * Warm switch: If the S2-LP is still powered and can be brought to READY, keep its configuration and only rewrite
+	 * the registers that differ between TX and RX mode: The register shadow cache skips all writes that would not
+	 * change a register. Registers that only affect the packet handler or RX chain are left as-is when switching to
+	 * TX, since uplinks are sent in direct FIFO mode. Only reset the S2-LP if it does not respond as expected.
+	 */
+	if (!renard_phy_s2lp_ready(phy))
+		renard_phy_s2lp_reset(phy);
+
+	/*
+	 * Choose correct digital domain clock: f_XO or f_XO / 2
+	 * Also, I have verified that writing writing 0x2e to XO_RCO_CONF1_ADDR massively reduces frequency drift.
+	 * This is something that is also done by STMicro's original S2-LP Sigfox Middleware (X-CUBE-SFXS2LP1), but it is
+	 * currently not documented in the datasheet.
+	 */
+	renard_phy_s2lp_write(phy, XO_RCO_CONF1_ADDR, 0x2e | ((DISABLE_CLKDIV << 4) & 0x10));
+
+	if (mode == S2LP_MODE_TX)
+		renard_phy_s2lp_tx_rf_init(phy);
+	else
+		renard_phy_s2lp_rx_rf_init(phy);
+}
+
+void renard_phy_s2lp_stop(renard_phy_s2lp_t *phy)
+{
+	renard_phy_s2lp_cmd(phy, CMD_SABORT);
+	renard_phy_s2lp_hal_shutdown(phy, true);
+	renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_SHUTDOWN);
+	renard_phy_s2lp_shadow_invalidate(phy);
+	phy->powered = false;
+}
+
+void renard_phy_s2lp_sleep(renard_phy_s2lp_t *phy)
+{
+	/* SLEEP can only be entered from READY, see datasheet "5.1 Operating modes". The register shadow remains valid. */
+	if (renard_phy_s2lp_ready(phy)) {
+		renard_phy_s2lp_cmd(phy, CMD_SLEEP);
+		renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_SLEEP);
+	}
+}
+
+void renard_phy_s2lp_wakeup(renard_phy_s2lp_t *phy)
+{
+	if (phy->powered) {
+		renard_phy_s2lp_cmd(phy, CMD_READY);
+		renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_IDLE);
+	}
+}
+
+uint32_t renard_phy_s2lp_shadow_saved(renard_phy_s2lp_t *phy)
+{
+	return phy->shadow_saved;
+}
+
+#if (RENARD_PHY_S2LP_STATS == 1)
+
+const renard_phy_s2lp_stats_t *renard_phy_s2lp_stats(renard_phy_s2lp_t *phy)
+{
+	return &phy->stats;
+}
+
+void renard_phy_s2lp_stats_reset(renard_phy_s2lp_t *phy)
+{
+	memset(&phy->stats, 0, sizeof(phy->stats));
+}
+
+#endif
+
+#if (RENARD_PHY_S2LP_ENERGY == 1)
+
+const renard_phy_s2lp_energy_t *renard_phy_s2lp_energy(renard_phy_s2lp_t *phy)
+{
+	renard_phy_s2lp_energy_enter(phy, phy->energy_state);
+	return &phy->energy;
+}
+
+void renard_phy_s2lp_energy_reset(renard_phy_s2lp_t *phy)
+{
+	memset(&phy->energy, 0, sizeof(phy->energy));
+	phy->energy_since = renard_phy_s2lp_timestamp(phy);
+}
+
+uint32_t renard_phy_s2lp_energy_charge(renard_phy_s2lp_t *phy, const renard_phy_s2lp_energy_t *energy)
+{
+	/* microseconds * nanoamperes = femtocoulombs */
+	uint64_t charge = 0;
+	(void)phy;
+	for (uint8_t state = 0; state < S2LP_ENERGY_COUNT; state++)
+		charge += (uint64_t)energy->time_us[state] * ENERGY_CURRENT_NA[state];
+
+	return (charge + 500000000) / 1000000000;
+}
 
-		*rssi = renard_phy_s2lp_read(RSSI_LEVEL_ADDR) - 146;
+#endif
+
+bool renard_phy_s2lp_tx(renard_phy_s2lp_t *phy, uint8_t *stream, uint8_t size, renard_phy_s2lp_ul_datarate_t datarate,
+		renard_phy_s2lp_rc_t rc_profile)
+{
+	renard_phy_s2lp_tx_prepare(phy, stream, size, datarate, rc_profile);
+	renard_phy_s2lp_cmd(phy, CMD_TX);
+	renard_phy_s2lp_energy_tx(phy, datarate, rc_profile);
+	renard_phy_s2lp_stats_tx_start(phy);
+
+	/* Refill FIFO whenever it is almost empty until complete frame has been transmitted */
+	renard_phy_s2lp_tx_refill_t refill;
+	do {
+		renard_phy_s2lp_interrupt_wait(phy);
+		renard_phy_s2lp_tx_next(phy, &refill, 0);
+		if (refill.data != NULL)
+			renard_phy_s2lp_tx_refill(phy, &refill, renard_phy_s2lp_tx_level(phy));
+	} while (refill.data != NULL);
+
+	renard_phy_s2lp_tx_finish(phy);
+
+	return !phy->tx_report.underrun;
+}
+
+const renard_phy_s2lp_tx_report_t *renard_phy_s2lp_tx_report(renard_phy_s2lp_t *phy)
+{
+	return &phy->tx_report;
+}
+
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+
+bool renard_phy_s2lp_tx_async(renard_phy_s2lp_t *phy, uint8_t *stream, uint8_t size,
+		renard_phy_s2lp_ul_datarate_t datarate, renard_phy_s2lp_rc_t rc_profile, void (*done)(void *context),
+		void *context)
+{
+	if (phy->tx_async.active)
+		return false;
+
+	renard_phy_s2lp_tx_prepare(phy, stream, size, datarate, rc_profile);
+
+	/* Pre-compute first two refills so that they can be started right from the GPIO interrupt */
+	renard_phy_s2lp_tx_next(phy, &phy->tx_async.queue[0], 0);
+	renard_phy_s2lp_tx_next(phy, &phy->tx_async.queue[1], 1);
+	phy->tx_async.queue_head = 0;
+	phy->tx_async.level = 0xff;
+	phy->tx_async.spi = TX_ASYNC_SPI_IDLE;
+	phy->tx_async.refill_pending = false;
+	phy->tx_async.cancel_pending = false;
+	phy->tx_async.done = done;
+	phy->tx_async.done_context = context;
+	phy->tx_async.active = true;
+
+	renard_phy_s2lp_interrupt_async(phy, true);
+	renard_phy_s2lp_cmd(phy, CMD_TX);
+	renard_phy_s2lp_energy_tx(phy, datarate, rc_profile);
+	renard_phy_s2lp_stats_tx_start(phy);
+
+	return true;
+}
+
+bool renard_phy_s2lp_tx_async_busy(renard_phy_s2lp_t *phy)
+{
+	return phy->tx_async.active;
+}
+
+void renard_phy_s2lp_tx_async_cancel(renard_phy_s2lp_t *phy)
+{
+	if (!phy->tx_async.active)
+		return;
+
+	/* Stop right away unless a refill is still being transferred, in that case stop once it is done */
+	phy->tx_async.done = NULL;
+	if (phy->tx_async.spi != TX_ASYNC_SPI_IDLE)
+		phy->tx_async.cancel_pending = true;
+	else
+		renard_phy_s2lp_tx_async_stop(phy);
+}
+
+bool renard_phy_s2lp_async_event(renard_phy_s2lp_t *phy, renard_phy_s2lp_event_t event)
+{
+	if (!phy->async_events[event])
+		return false;
+
+	phy->async_events[event] = false;
+	return true;
+}
+
+void renard_phy_s2lp_async_interrupt(renard_phy_s2lp_t *phy, bool is_gpio)
+{
+	if (!phy->tx_async.active) {
+		phy->async_events[is_gpio ? S2LP_EVENT_GPIO : S2LP_EVENT_TIMEOUT] = true;
+		return;
+	}
+
+	if (!is_gpio || phy->tx_async.cancel_pending)
+		return;
+
+	/* Previous refill still in progress (should not happen unless SPI is very slow): refill once it is done */
+	if (phy->tx_async.spi != TX_ASYNC_SPI_IDLE) {
+		phy->tx_async.refill_pending = true;
+		return;
+	}
+
+	renard_phy_s2lp_tx_async_refill(phy);
+}
+
+void renard_phy_s2lp_async_spi_done(renard_phy_s2lp_t *phy)
+{
+	if (!phy->tx_async.active)
+		return;
+
+	renard_phy_s2lp_tx_async_spi_t spi = phy->tx_async.spi;
+	renard_phy_s2lp_tx_refill_t *refill = &phy->tx_async.queue[phy->tx_async.queue_head];
+	phy->tx_async.spi = TX_ASYNC_SPI_IDLE;
+
+	/* Cancelled while a transfer was in progress: Stop now */
+	if (phy->tx_async.cancel_pending && spi < TX_ASYNC_SPI_ABORT) {
+		renard_phy_s2lp_tx_async_stop_start(phy);
+		return;
+	}
+
+	switch (spi) {
+		case TX_ASYNC_SPI_MONITOR:
+			phy->tx_async.level = phy->tx_async.spi_in[2];
+			renard_phy_s2lp_tx_async_spi(phy, refill->last ? TX_ASYNC_SPI_THRESHOLD : TX_ASYNC_SPI_REFILL);
+			return;
+
+		case TX_ASYNC_SPI_THRESHOLD:
+			renard_phy_s2lp_tx_async_spi(phy, TX_ASYNC_SPI_REFILL);
+			return;
+
+		case TX_ASYNC_SPI_REFILL:
+			if (refill->last) {
+				renard_phy_s2lp_tx_async_spi(phy, TX_ASYNC_SPI_UNDERRUN);
+				return;
+			}
+
+			renard_phy_s2lp_tx_refilled(phy, refill, phy->tx_async.level, 0x00);
+			break;
+
+		case TX_ASYNC_SPI_UNDERRUN:
+			renard_phy_s2lp_tx_refilled(phy, refill, phy->tx_async.level, phy->tx_async.spi_in[2]);
+			break;
+
+		case TX_ASYNC_SPI_ABORT:
+			renard_phy_s2lp_tx_async_spi(phy, TX_ASYNC_SPI_FLUSH);
+			return;
+
+		case TX_ASYNC_SPI_FLUSH:
+#if RENARD_PHY_S2LP_HAVE_FEM == 1
+			if (!renard_phy_s2lp_shadow_image(phy, REGISTER_IMAGE_FEM_SHUTDOWN, sizeof(REGISTER_IMAGE_FEM_SHUTDOWN))) {
+				renard_phy_s2lp_tx_async_spi(phy, TX_ASYNC_SPI_FEM);
+				return;
+			}
+#endif
+			renard_phy_s2lp_tx_async_stop_done(phy);
+			return;
+
+		default:
+			renard_phy_s2lp_tx_async_stop_done(phy);
+			return;
+	}
+
+	/* Buffer slot of the refill that was just transferred is free again: Queue the refill after the next one */
+	phy->tx_async.level = 0xff;
+	renard_phy_s2lp_tx_next(phy, refill, phy->tx_async.queue_head);
+	phy->tx_async.queue_head ^= 1;
+
+	if (phy->tx_async.refill_pending) {
+		phy->tx_async.refill_pending = false;
+		renard_phy_s2lp_tx_async_refill(phy);
+	}
+}
+
+#endif
+
+/* 2^53 / f_xo, rounded up, see renard_phy_s2lp_channel */
+#define SYNTH_RECIPROCAL ((((uint64_t)1 << 53) + S2LP_XTAL_FREQ - 1) / S2LP_XTAL_FREQ)
+
+void renard_phy_s2lp_channel(renard_phy_s2lp_t *phy, renard_phy_s2lp_channel_t *channel, uint32_t frequency)
+{
+	/*
+	 * Frequency selection is explained in datasheet section 5.3.1, equations 6 / 7 / 8 / 9:
+	 * Since CHNUM = 0, f_c = f_base here, so equation 7 effectively defines frequency selection:
+	 * --> synth = 2^19 * B * D * f_base / f_xo
+	 * --> where B = 4 since we are in the 826-1055MHz band.
+	 * --> where D = 1 since REFDIV XO_RCO_CONFIG0 is 0 (has nothing to do with digital domain clock divider)
+	 * The maximum error we make by rounding synth to an integer is on the order of 25Hz which is safe to ignore
+	 * considering the error due to XTAL imperfections can be >15kHz (20ppm XTAL)
+	 *
+	 * Instead of dividing by f_xo, multiply with SYNTH_RECIPROCAL = 2^53 / f_xo (rounded up, computed at compile time)
+	 * and shift right by 32. Since f_base < 2^30, this overestimates synth by less than 0.25, so the result is either
+	 * exact or too large by one, which the following comparison corrects.
+	 */
+	(void)phy;
+	uint32_t synth = ((uint64_t)frequency * SYNTH_RECIPROCAL) >> 32;
+	if ((uint64_t)synth * S2LP_XTAL_FREQ > ((uint64_t)frequency << 21))
+		synth--;
+
+	/*
+	 * Charge pump configuration, see datsheet section 5.3 and table 37: "Charge pump words"
+	 * The logic for selecting PLL_CP_ISEL has been taken from X-CUBE-SFXS2LP1, PLL_PFD_SPLIT_EN only depends on the
+	 * digital domain clock divider, so it is part of the register images for TX / RX mode (see register_images.c).
+	 * synth_freq = 4 * f_base < 3.6GHz is equivalent to f_base < 900MHz.
+	 */
+	uint8_t pll_cp_isel = (frequency < 900000000) ?
+		(DISABLE_CLKDIV ? 0x02 : 0x03) :
+		(DISABLE_CLKDIV ? 0x01 : 0x02);
+
+	channel->image[0] = 0x00;
+	channel->image[1] = SYNT3_ADDR;
+	channel->image[2] = ((synth >> 24) & 0x0f) | (pll_cp_isel << 5);
+	channel->image[3] = (synth >> 16) & 0xff;
+	channel->image[4] = (synth >> 8) & 0xff;
+	channel->image[5] = (synth >> 0) & 0xff;
+}
+
+void renard_phy_s2lp_retune(renard_phy_s2lp_t *phy, const renard_phy_s2lp_channel_t *channel)
+{
+	renard_phy_s2lp_write_image(phy, channel->image, sizeof(channel->image));
+}
+
+void renard_phy_s2lp_frequency(renard_phy_s2lp_t *phy, uint32_t frequency)
+{
+	renard_phy_s2lp_channel_t channel;
+
+	renard_phy_s2lp_channel(phy, &channel, frequency);
+	renard_phy_s2lp_retune(phy, &channel);
+}
+
+void renard_phy_s2lp_rx_start(renard_phy_s2lp_t *phy)
+{
+#if RENARD_PHY_S2LP_HAVE_FEM == 1
+	/*
+	 * Optional, if present: Configure front-end module
+	 */
+	fem_mode(phy, S2LP_FEM_MODE_RX);
+#endif
+
+	/* disable all IRQs except for RX DATA READY */
+	renard_phy_s2lp_write_image(phy, REGISTER_IMAGE_RX_IRQ_MASK, sizeof(REGISTER_IMAGE_RX_IRQ_MASK));
+
+	/* GPIO configuration: nIRQ (interrupt request, active low --> falling edge on MCU) on GPIO3 */
+	renard_phy_s2lp_write(phy, GPIO3_CONF_ADDR, 0x02);
+	renard_phy_s2lp_interrupt_gpio(phy, false);
+
+#if (RENARD_PHY_S2LP_RX_SNIFF == 1)
+	/* sniff mode: RX timer, wake-up timer, carrier sense stop condition and LDC mode, RSSI threshold */
+	renard_phy_s2lp_write_image(phy, phy->sniff.timers, sizeof(phy->sniff.timers));
+	renard_phy_s2lp_write_image(phy, phy->sniff.protocol, sizeof(phy->sniff.protocol));
+	renard_phy_s2lp_write(phy, RSSI_TH_ADDR, phy->sniff.rssi_th);
+#endif
+
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+	/* hardware RX timeout: the window starts now, see renard_phy_s2lp_rx_timeout */
+	phy->rx_deadline = renard_phy_s2lp_timestamp(phy) + phy->rx_timeout_us;
+	renard_phy_s2lp_rx_timer_arm(phy, phy->rx_timeout_us);
+#endif
+
+	/* clean up: flush FIFO and clear IRQ STATUS registers (cleared on read) */
+	uint8_t irq_status[4];
+	renard_phy_s2lp_cmd(phy, CMD_FLUSHRXFIFO);
+	renard_phy_s2lp_read_burst(phy, IRQ_STATUS3_ADDR, irq_status, sizeof(irq_status));
+
+	/* start RX */
+	renard_phy_s2lp_cmd(phy, CMD_RX);
+	renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_RX);
+}
+
+bool renard_phy_s2lp_rx_finish(renard_phy_s2lp_t *phy, bool is_gpio_ir, uint8_t *frame, int16_t *rssi)
+{
+	/* stop RX, disable interrupts */
+#if (RENARD_PHY_S2LP_RX_SNIFF == 1)
+	/* sniff mode: leave LDC mode first so that the wake-up timer cannot restart RX, S2-LP may be in SLEEP */
+	if (phy->sniff.protocol[REGISTER_IMAGE_HEADER_LENGTH + 1] & PROTOCOL1_LDC_MODE) {
+		renard_phy_s2lp_write(phy, PROTOCOL1_ADDR, 0x00);
+		renard_phy_s2lp_cmd(phy, CMD_SABORT);
+		renard_phy_s2lp_cmd(phy, CMD_READY);
+	} else {
+		renard_phy_s2lp_cmd(phy, CMD_SABORT);
 	}
+#else
+	renard_phy_s2lp_cmd(phy, CMD_SABORT);
+#endif
+	renard_phy_s2lp_energy_enter(phy, S2LP_ENERGY_IDLE);
+#if RENARD_PHY_S2LP_HAVE_FEM == 1
+	fem_mode(phy, S2LP_FEM_MODE_SHUTDOWN);
+#endif
+
+	if (is_gpio_ir)
+		renard_phy_s2lp_rx_read(phy, frame, rssi);
 
 	return is_gpio_ir;
 }
+
+void renard_phy_s2lp_rx_read(renard_phy_s2lp_t *phy, uint8_t *frame, int16_t *rssi)
+{
+	/*
+	 * Fetch RX_FIFO_STATUS .. RSSI_LEVEL (number of bytes in RX FIFO, RSSI at SYNC detection) with one burst read,
+	 * then the received frame with another burst read from FIFO
+	 */
+	uint8_t status[RSSI_LEVEL_ADDR - RX_FIFO_STATUS_ADDR + 1];
+	renard_phy_s2lp_read_burst(phy, RX_FIFO_STATUS_ADDR, status, sizeof(status));
+
+	uint8_t length = status[0];
+	if (length > DOWNLINK_FRAME_LENGTH)
+		length = DOWNLINK_FRAME_LENGTH;
+
+	renard_phy_s2lp_read_burst(phy, FIFO_ADDR, frame, length);
+	*rssi = status[RSSI_LEVEL_ADDR - RX_FIFO_STATUS_ADDR] - 146;
+}
+
+void renard_phy_s2lp_rx_restart(renard_phy_s2lp_t *phy)
+{
+	/*
+	 * The S2-LP has returned to READY after the frame, IRQ masks, GPIO, FEM, RX timer and sniff configuration are
+	 * still in place. Only drop the frame, release nIRQ and listen again.
+	 */
+	renard_phy_s2lp_cmd(phy, CMD_FLUSHRXFIFO);
+
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 0)
+	/*
+	 * Without hardware RX timeout, nothing has read the IRQ STATUS registers since the frame was received (with it,
+	 * renard_phy_s2lp_rx_irq has): Read them now, which clears them and releases nIRQ
+	 */
+	uint8_t irq_status[4];
+	renard_phy_s2lp_read_burst(phy, IRQ_STATUS3_ADDR, irq_status, sizeof(irq_status));
+#else
+	/*
+	 * The RX timer would start over with a full period, reprogram it with what is left of the window instead. If the
+	 * window is already over, arm the shortest possible period so that the timeout is still reported by the S2-LP.
+	 */
+	if (phy->rx_timeout_us > 0) {
+		int32_t remaining = (int32_t)(phy->rx_deadline - renard_phy_s2lp_timestamp(phy));
+		renard_phy_s2lp_rx_timer_arm(phy, remaining > 0 ? (uint32_t)remaining : 1);
+	}
+#endif
+
+	renard_phy_s2lp_cmd(phy, CMD_RX);
+}
+
+bool renard_phy_s2lp_rx(renard_phy_s2lp_t *phy, uint8_t *frame, int16_t *rssi)
+{
+	renard_phy_s2lp_rx_start(phy);
+
+	/*
+	 * Downlink procedure is over if either:
+	 * --> a downlink timer interrupt occurs
+	 * --> the S2-LP received some data; only in that case will the S2-LP generate a GPIO interrupt
+	 * --> with hardware RX timeout: the S2-LP's RX timer has expired, which is also reported as GPIO interrupt
+	 */
+	bool is_gpio_ir = renard_phy_s2lp_interrupt_wait(phy);
+
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+	renard_phy_s2lp_rx_status_t status = S2LP_RX_PENDING;
+	while (is_gpio_ir && (status = renard_phy_s2lp_rx_irq(phy)) == S2LP_RX_PENDING)
+		is_gpio_ir = renard_phy_s2lp_interrupt_wait(phy);
+
+	is_gpio_ir = is_gpio_ir && status == S2LP_RX_FRAME;
+#endif
+
+	return renard_phy_s2lp_rx_finish(phy, is_gpio_ir, frame, rssi);
+}
+
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+
+/*
+ * Hardware RX timeout, see renard_phy_s2lp_rx_timer_arm
+ */
+void renard_phy_s2lp_rx_timeout(renard_phy_s2lp_t *phy, uint32_t milliseconds)
+{
+	phy->rx_timeout_us = milliseconds * 1000;
+}
+
+renard_phy_s2lp_rx_status_t renard_phy_s2lp_rx_irq(renard_phy_s2lp_t *phy)
+{
+	uint8_t irq_status[4];
+	renard_phy_s2lp_read_burst(phy, IRQ_STATUS3_ADDR, irq_status, sizeof(irq_status));
+
+	if (irq_status[3] & IRQ0_RX_DATA_READY)
+		return S2LP_RX_FRAME;
+
+	if (!(irq_status[0] & IRQ3_RX_TIMEOUT))
+		return S2LP_RX_PENDING;
+
+	/* RX timer period over, S2-LP is back in READY: Restart RX unless this was the last period */
+	if (phy->rx_timer_periods > 1) {
+		phy->rx_timer_periods--;
+		renard_phy_s2lp_cmd(phy, CMD_RX);
+		return S2LP_RX_PENDING;
+	}
+
+	phy->rx_timer_periods = 0;
+	return S2LP_RX_TIMEOUT;
+}
+
+#endif
+
+#if (RENARD_PHY_S2LP_RX_SNIFF == 1)
+
+void renard_phy_s2lp_rx_sniff(renard_phy_s2lp_t *phy, const renard_phy_s2lp_sniff_t *sniff)
+{
+	memset(&phy->sniff, 0, sizeof(phy->sniff));
+	phy->sniff.timers[1] = TIMERS5_ADDR;
+	phy->sniff.protocol[1] = PROTOCOL2_ADDR;
+	phy->sniff.rssi_th = 0x07;
+
+	if (sniff == NULL)
+		return;
+
+	uint8_t *timers = &phy->sniff.timers[REGISTER_IMAGE_HEADER_LENGTH];
+	renard_phy_s2lp_rx_timer(sniff->listen_us, &timers[0]);
+
+	uint32_t ticks = (uint32_t)sniff->period_ms * LDC_TIMER_F_RCO / 1000;
+	if (ticks == 0)
+		ticks = 1;
+	if (ticks > LDC_TIMER_TICKS_MAX)
+		ticks = LDC_TIMER_TICKS_MAX;
+
+	/* TIMERS3: LDC_TIMER_PRESC, TIMERS2: LDC_TIMER_CNTR */
+	uint32_t prescaler = (ticks + 255) / 256;
+	timers[2] = prescaler - 1;
+	timers[3] = (ticks + prescaler - 1) / prescaler - 1;
+
+	phy->sniff.protocol[REGISTER_IMAGE_HEADER_LENGTH] = PROTOCOL2_CS_TIMEOUT_MASK;
+	phy->sniff.protocol[REGISTER_IMAGE_HEADER_LENGTH + 1] = PROTOCOL1_LDC_MODE;
+
+	int16_t rssi_th = sniff->rssi_dbm + 146;
+	phy->sniff.rssi_th = rssi_th < 0 ? 0 : (rssi_th > 255 ? 255 : rssi_th);
+}
+
+#endif
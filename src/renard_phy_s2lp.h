@@ -1,5 +1,10 @@
+#include <stdint.h>
 #include <stdbool.h>
 
+#include "renard_phy_s2lp_hal.h"
+#include "conf_driver.h"
+#include "fifo_symbols.h"
+
 /*
  * renard-phy-s2lp - Free Sigfox physical layer for STMicro's S2-LP
  *
@@ -7,11 +12,19 @@
  *   awareness of Sigfox protocol definitions
  * - renard-phy-s2lp-protocol has bindings to librenard and implements encoding / decoding of frames as well as
  *   scheduling aspects
+ *
+ * All driver state lives in a driver context (renard_phy_s2lp_t) that the caller allocates and passes to every
+ * function, so that one MCU or host can drive several S2-LPs, each through its own HAL context.
  */
 
 #ifndef _RENARD_PHY_S2LP_H
 #define _RENARD_PHY_S2LP_H
 
+/*
+ * Driver context of a single S2-LP, all members are private (see end of file)
+ */
+typedef struct renard_phy_s2lp renard_phy_s2lp_t;
+
 /*
  * For now, only RC1 and RC2 are supported.
  */
@@ -33,15 +46,348 @@ typedef enum
 	S2LP_MODE_RX
 } renard_phy_s2lp_mode_t;
 
-bool renard_phy_s2lp_init(void);
+/*
+ * renard_phy_s2lp_init: Set up the driver context phy for the S2-LP behind the given HAL, hal_context is passed to
+ * every HAL function. Returns false if the S2-LP does not respond. Call first, for every S2-LP.
+ */
+bool renard_phy_s2lp_init(renard_phy_s2lp_t *phy, const renard_phy_s2lp_hal_t *hal, void *hal_context);
+
+/*
+ * HAL of the given driver context, for renard-phy-s2lp-protocol and for applications that wait for interrupts
+ * themselves (see renard_phy_s2lp_hal_t)
+ */
+void renard_phy_s2lp_interrupt_timeout(renard_phy_s2lp_t *phy, uint32_t milliseconds);
+void renard_phy_s2lp_interrupt_clear(renard_phy_s2lp_t *phy);
+bool renard_phy_s2lp_interrupt_wait(renard_phy_s2lp_t *phy);
+void renard_phy_s2lp_interrupt_async(renard_phy_s2lp_t *phy, bool enable);
+uint32_t renard_phy_s2lp_timestamp(renard_phy_s2lp_t *phy);
+
+void renard_phy_s2lp_mode(renard_phy_s2lp_t *phy, renard_phy_s2lp_mode_t mode);
+void renard_phy_s2lp_stop(renard_phy_s2lp_t *phy);
+
+/*
+ * Low-power state between transmissions that keeps the S2-LP's configuration:
+ * renard_phy_s2lp_sleep puts the S2-LP into SLEEP (registers retained, crystal oscillator off). The next
+ * renard_phy_s2lp_mode call wakes it up without a reset, but has to wait 1ms for the crystal oscillator to start up.
+ * renard_phy_s2lp_wakeup only starts the crystal oscillator and returns immediately, so that the caller can wait for
+ * at least 1ms by other means (e.g. a timeout interrupt) before calling renard_phy_s2lp_mode.
+ */
+void renard_phy_s2lp_sleep(renard_phy_s2lp_t *phy);
+void renard_phy_s2lp_wakeup(renard_phy_s2lp_t *phy);
+
+/*
+ * renard_phy_s2lp_tx returns false if the TX FIFO ran empty while the frame was being transmitted (underrun), i.e. a
+ * refill came too late and the frame's waveform is broken. See renard_phy_s2lp_tx_report for details.
+ */
+bool renard_phy_s2lp_tx(renard_phy_s2lp_t *phy, uint8_t *stream, uint8_t size,
+		renard_phy_s2lp_ul_datarate_t datarate, renard_phy_s2lp_rc_t rc_profile);
+bool renard_phy_s2lp_rx(renard_phy_s2lp_t *phy, uint8_t *frame, int16_t *rssi);
+
+/*
+ * Timing margin of the last uplink frame (blocking or asynchronous):
+ * underrun: TX FIFO ran empty before the frame was complete
+ * min_fifo_level: Lowest TX FIFO fill level in bytes right before a refill, 0xff if not measured (only measured if
+ *   RENARD_PHY_S2LP_TX_FIFO_MONITOR is enabled, see conf_driver.h)
+ */
+typedef struct
+{
+	bool underrun;
+	uint8_t min_fifo_level;
+} renard_phy_s2lp_tx_report_t;
+
+const renard_phy_s2lp_tx_report_t *renard_phy_s2lp_tx_report(renard_phy_s2lp_t *phy);
+
+/*
+ * renard_phy_s2lp_rx split into its two halves for callers that wait for the interrupt themselves:
+ * renard_phy_s2lp_rx_start puts the S2-LP into RX mode, renard_phy_s2lp_rx_finish stops reception and, if is_gpio_ir
+ * is set (the S2-LP reported a received frame), reads frame and RSSI.
+ */
+void renard_phy_s2lp_rx_start(renard_phy_s2lp_t *phy);
+bool renard_phy_s2lp_rx_finish(renard_phy_s2lp_t *phy, bool is_gpio_ir, uint8_t *frame, int16_t *rssi);
+
+/*
+ * Fast re-arm for candidate frames that turn out to be invalid, e.g. because their CRC or MAC is wrong:
+ * renard_phy_s2lp_rx_read reads the frame and RSSI after a GPIO interrupt without stopping reception,
+ * renard_phy_s2lp_rx_restart then listens again right away with the configuration of the last renard_phy_s2lp_rx_start
+ * (IRQ masks, GPIO, FEM, timeouts), flushing only RX FIFO and IRQ status. Decode the frame after the restart and end
+ * reception with renard_phy_s2lp_rx_finish(false, ...) if it is valid.
+ */
+void renard_phy_s2lp_rx_read(renard_phy_s2lp_t *phy, uint8_t *frame, int16_t *rssi);
+void renard_phy_s2lp_rx_restart(renard_phy_s2lp_t *phy);
+
+/*
+ * Hardware RX timeout, only available if RENARD_PHY_S2LP_RX_HW_TIMEOUT is enabled (see conf_driver.h):
+ * renard_phy_s2lp_rx_timeout: Listen for (at least) the given time after every following renard_phy_s2lp_rx_start,
+ *   using the S2-LP's RX timer, 0 disables the timeout. renard_phy_s2lp_rx_restart keeps the end of the window, it
+ *   re-arms the RX timer with the time that is left, measured with the HAL's timestamp function.
+ * renard_phy_s2lp_rx_irq: Call after every GPIO interrupt during reception to find out what happened. Returns
+ *   S2LP_RX_FRAME if a frame was received, S2LP_RX_TIMEOUT once the timeout has elapsed and S2LP_RX_PENDING if the
+ *   S2-LP is (still) listening, e.g. because an RX timer period has ended and RX was restarted.
+ * renard_phy_s2lp_rx also handles these interrupts, then the HAL timeout interrupt is not needed.
+ */
+typedef enum
+{
+	S2LP_RX_PENDING = 0,
+	S2LP_RX_FRAME,
+	S2LP_RX_TIMEOUT
+} renard_phy_s2lp_rx_status_t;
+
+void renard_phy_s2lp_rx_timeout(renard_phy_s2lp_t *phy, uint32_t milliseconds);
+renard_phy_s2lp_rx_status_t renard_phy_s2lp_rx_irq(renard_phy_s2lp_t *phy);
+
+/*
+ * Sniff mode, only available if RENARD_PHY_S2LP_RX_SNIFF is enabled (see conf_driver.h): Configure duty-cycled
+ * reception for all following renard_phy_s2lp_rx_start calls, NULL switches back to continuous reception.
+ * period_ms: Time between two receiver wake-ups, at most about 2000ms
+ * listen_us: Time that the receiver listens for a carrier after every wake-up, at most about 3s
+ * rssi_dbm: Carrier sense threshold, frames with a lower RSSI are not received
+ */
+typedef struct
+{
+	uint16_t period_ms;
+	uint32_t listen_us;
+	int16_t rssi_dbm;
+} renard_phy_s2lp_sniff_t;
+
+void renard_phy_s2lp_rx_sniff(renard_phy_s2lp_t *phy, const renard_phy_s2lp_sniff_t *sniff);
+
+/*
+ * Asynchronous uplink transmission, only available if RENARD_PHY_S2LP_ASYNC is enabled (see conf_driver.h):
+ * renard_phy_s2lp_tx_async returns right after transmission has started (false if a transmission is still in
+ * progress). FIFO refills are then driven by interrupts and asynchronous SPI transfers. done(context) is called from
+ * interrupt context once the frame has been transmitted completely. stream must remain valid until then.
+ */
+bool renard_phy_s2lp_tx_async(renard_phy_s2lp_t *phy, uint8_t *stream, uint8_t size,
+		renard_phy_s2lp_ul_datarate_t datarate, renard_phy_s2lp_rc_t rc_profile, void (*done)(void *context),
+		void *context);
+bool renard_phy_s2lp_tx_async_busy(renard_phy_s2lp_t *phy);
+
+/*
+ * renard_phy_s2lp_tx_async_cancel: Abort asynchronous transmission without calling done
+ * renard_phy_s2lp_async_event: While no asynchronous transmission is active, GPIO and timeout interrupts reported by
+ * the HAL are latched. Returns true (and clears the event) if the given interrupt occurred since the last call.
+ */
+typedef enum
+{
+	S2LP_EVENT_GPIO = 0,
+	S2LP_EVENT_TIMEOUT,
+	S2LP_EVENT_COUNT
+} renard_phy_s2lp_event_t;
+
+void renard_phy_s2lp_tx_async_cancel(renard_phy_s2lp_t *phy);
+bool renard_phy_s2lp_async_event(renard_phy_s2lp_t *phy, renard_phy_s2lp_event_t event);
+
+void renard_phy_s2lp_frequency(renard_phy_s2lp_t *phy, uint32_t frequency);
+
+/*
+ * Channel plan: renard_phy_s2lp_channel precomputes the synthesizer configuration for the given frequency in Hz
+ * without using divisions, renard_phy_s2lp_retune then tunes the S2-LP to that channel with a single SPI burst write.
+ * renard_phy_s2lp_frequency(f) is equivalent to computing a channel for f and retuning to it right away.
+ */
+typedef struct
+{
+	uint8_t image[6]; /* SPI burst write of SYNT3 .. SYNT0 */
+} renard_phy_s2lp_channel_t;
+
+void renard_phy_s2lp_channel(renard_phy_s2lp_t *phy, renard_phy_s2lp_channel_t *channel, uint32_t frequency);
+void renard_phy_s2lp_retune(renard_phy_s2lp_t *phy, const renard_phy_s2lp_channel_t *channel);
+
+/* Number of SPI transactions saved by the register shadow cache, see conf_driver.h */
+uint32_t renard_phy_s2lp_shadow_saved(renard_phy_s2lp_t *phy);
+
+/*
+ * Statistics, only available if RENARD_PHY_S2LP_STATS is enabled (see conf_driver.h). Counters accumulate until
+ * renard_phy_s2lp_stats_reset is called, renard-phy-s2lp-protocol resets them at the start of every transfer.
+ */
+typedef struct
+{
+	uint32_t spi_transactions;
+	uint32_t spi_bytes;
+	uint32_t fifo_refills;
+
+	/* Longest time between starting TX or the previous TX FIFO refill and a refill, in microseconds */
+	uint32_t max_refill_gap_us;
+} renard_phy_s2lp_stats_t;
+
+const renard_phy_s2lp_stats_t *renard_phy_s2lp_stats(renard_phy_s2lp_t *phy);
+void renard_phy_s2lp_stats_reset(renard_phy_s2lp_t *phy);
+
+/*
+ * Energy accounting, only available if RENARD_PHY_S2LP_ENERGY is enabled (see conf_driver.h). Time spent in every
+ * state accumulates until renard_phy_s2lp_energy_reset is called, renard-phy-s2lp-protocol resets it at the start of
+ * every transfer. Each state's time is a 32-bit microsecond counter, so reset at least once per hour. In sniff mode,
+ * all of the time between renard_phy_s2lp_rx_start and renard_phy_s2lp_rx_finish counts as RX (upper bound).
+ * renard_phy_s2lp_energy: Time spent in every state up to now
+ * renard_phy_s2lp_energy_charge: Estimated charge in uC for the given times, based on the board's supply current table
+ */
+typedef enum
+{
+	S2LP_ENERGY_SHUTDOWN = 0,
+	S2LP_ENERGY_RESET,
+	S2LP_ENERGY_SLEEP,
+	S2LP_ENERGY_IDLE,
+	S2LP_ENERGY_RX,
+	S2LP_ENERGY_TX_100BPS,
+	S2LP_ENERGY_TX_600BPS,
+	S2LP_ENERGY_TX_100BPS_BOOST,
+	S2LP_ENERGY_TX_600BPS_BOOST,
+	S2LP_ENERGY_COUNT
+} renard_phy_s2lp_energy_state_t;
+
+typedef struct
+{
+	uint32_t time_us[S2LP_ENERGY_COUNT];
+} renard_phy_s2lp_energy_t;
+
+const renard_phy_s2lp_energy_t *renard_phy_s2lp_energy(renard_phy_s2lp_t *phy);
+void renard_phy_s2lp_energy_reset(renard_phy_s2lp_t *phy);
+uint32_t renard_phy_s2lp_energy_charge(renard_phy_s2lp_t *phy, const renard_phy_s2lp_energy_t *energy);
+
+/*
+ * Events reported through the RENARD_PHY_S2LP_TRACE(phy, event, value) hook (see conf_driver.h), meaning of value
+ */
+typedef enum
+{
+	S2LP_TRACE_TRANSFER_START = 0,  /* 0 */
+	S2LP_TRACE_ENCODED,             /* 0 */
+	S2LP_TRACE_UPLINK_START,        /* frame number: 0 for initial frame, 1 / 2 for replicas */
+	S2LP_TRACE_FIFO_REFILL,         /* bytes written to TX FIFO, may be reported from interrupt context */
+	S2LP_TRACE_UPLINK_DONE,         /* frame number, bit 8 set if TX FIFO ran empty */
+	S2LP_TRACE_DOWNLINK_WAIT,       /* milliseconds until downlink window opens */
+	S2LP_TRACE_RX_ARMED,            /* 0 */
+	S2LP_TRACE_RX_CANDIDATE,        /* bit 0: CRC ok, bit 1: MAC ok */
+	S2LP_TRACE_TRANSFER_DONE,       /* renard_phy_s2lp_protocol_error_t */
+	S2LP_TRACE_SLEEP,               /* milliseconds until wakeup */
+	S2LP_TRACE_WAKEUP               /* 0 */
+} renard_phy_s2lp_trace_event_t;
+
+/*
+ * Driver context, private: Only declared here so that the caller can provide the memory, e.g. one static instance per
+ * S2-LP. Sizes depend on the options in conf_driver.h.
+ */
+#define RENARD_PHY_S2LP_SHADOW_SIZE 0x8d /* MC_STATE1_ADDR */
+#define RENARD_PHY_S2LP_FIFO_SIZE 128
+
+typedef enum
+{
+	TX_STAGE_BEFOREFRAME = 0,
+	TX_STAGE_BITS,
+	TX_STAGE_AFTERFRAME_1,
+	TX_STAGE_AFTERFRAME_2,
+	TX_STAGE_DONE
+} renard_phy_s2lp_tx_stage_t;
+
+typedef struct
+{
+	const uint8_t *data;
+	uint8_t length;
+	bool last;
+} renard_phy_s2lp_tx_refill_t;
+
+/* SPI transfer that asynchronous transmission is waiting for, see renard_phy_s2lp_async_spi_done */
+typedef enum
+{
+	TX_ASYNC_SPI_IDLE = 0,
+	TX_ASYNC_SPI_MONITOR,
+	TX_ASYNC_SPI_THRESHOLD,
+	TX_ASYNC_SPI_REFILL,
+	TX_ASYNC_SPI_UNDERRUN,
+	TX_ASYNC_SPI_ABORT,
+	TX_ASYNC_SPI_FLUSH,
+	TX_ASYNC_SPI_FEM
+} renard_phy_s2lp_tx_async_spi_t;
+
+struct renard_phy_s2lp
+{
+	const renard_phy_s2lp_hal_t *hal;
+	void *hal_context;
+	bool powered;
+
+	/* Register shadow cache */
+	uint32_t shadow_saved;
+#if (RENARD_PHY_S2LP_SHADOW_REGISTERS == 1)
+	uint8_t shadow[RENARD_PHY_S2LP_SHADOW_SIZE];
+	uint8_t shadow_valid[(RENARD_PHY_S2LP_SHADOW_SIZE + 7) / 8];
+#endif
+
+#if (RENARD_PHY_S2LP_STATS == 1)
+	renard_phy_s2lp_stats_t stats;
+	uint32_t stats_last_refill;
+#endif
 
-void renard_phy_s2lp_mode(renard_phy_s2lp_mode_t mode);
-void renard_phy_s2lp_stop(void);
+#if (RENARD_PHY_S2LP_ENERGY == 1)
+	renard_phy_s2lp_energy_t energy;
+	renard_phy_s2lp_energy_state_t energy_state;
+	uint32_t energy_since;
+#endif
+
+	/* Uplink symbol sequencing */
+	struct
+	{
+		const uint8_t *stream;
+		uint8_t size;
+		uint8_t byte_index;
+		uint8_t bit_index;
+		renard_phy_s2lp_tx_stage_t stage;
+#if (RENARD_PHY_S2LP_TX_PACKED_REFILL == 1)
+		fifo_symbol_t symbol;
+		uint8_t offset;
+		uint8_t space;
+#endif
+	} tx;
+
+	renard_phy_s2lp_tx_report_t tx_report;
 
-void renard_phy_s2lp_tx(uint8_t *stream, uint8_t size, renard_phy_s2lp_ul_datarate_t datarate,
-		renard_phy_s2lp_rc_t rc_profile);
-bool renard_phy_s2lp_rx(uint8_t *frame, int16_t *rssi);
+	/*
+	 * Power adjustment of the current RC profile (FEM only) that symbol waveforms from fifo_symbols.c are expanded
+	 * with. With the symbol cache, the expanded waveforms, re-expanded only when the adjustment changes.
+	 */
+	int16_t symbols_adjustment;
+#if (RENARD_PHY_S2LP_TX_SYMBOL_CACHE == 1)
+	uint8_t symbols[FIFO_SYMBOL_COUNT][FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
+#endif
+
+	/* Refill buffers: One for blocking transmission, two for double-buffered asynchronous transmission */
+#if (RENARD_PHY_S2LP_TX_PACKED_REFILL == 1)
+	uint8_t tx_buffers[2][FIFO_CMD_LENGTH + RENARD_PHY_S2LP_FIFO_SIZE];
+#elif (RENARD_PHY_S2LP_TX_SYMBOL_CACHE == 0)
+	uint8_t tx_buffers[RENARD_PHY_S2LP_ASYNC == 1 ? 2 : 1][FIFO_CMD_LENGTH + FIFO_SYMBOL_LENGTH];
+#endif
 
-void renard_phy_s2lp_frequency(uint32_t frequency);
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+	struct
+	{
+		bool active;
+		renard_phy_s2lp_tx_async_spi_t spi;
+		bool refill_pending;
+		bool cancel_pending;
+		renard_phy_s2lp_tx_refill_t queue[2];
+		uint8_t queue_head;
+		uint8_t level;
+		uint8_t spi_out[3];
+		uint8_t spi_in[3];
+		void (*done)(void *context);
+		void *done_context;
+	} tx_async;
+
+	volatile bool async_events[S2LP_EVENT_COUNT];
+#endif
+
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+	uint32_t rx_timeout_us;
+	uint32_t rx_deadline;
+	uint16_t rx_timer_periods;
+#endif
+
+#if (RENARD_PHY_S2LP_RX_SNIFF == 1)
+	/* Register images TIMERS5 .. TIMERS0 and PROTOCOL2 .. PROTOCOL1, RSSI_TH */
+	struct
+	{
+		uint8_t timers[2 + 6];
+		uint8_t protocol[2 + 2];
+		uint8_t rssi_th;
+	} sniff;
+#endif
+};
 
 #endif
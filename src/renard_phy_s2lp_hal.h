@@ -1,25 +1,58 @@
+#include <stdint.h>
 #include <stdbool.h>
 
 #ifndef _RENARD_PHY_S2LP_HAL_H
 #define _RENARD_PHY_S2LP_HAL_H
 
-/*
- * Initialization
- */
-void renard_phy_s2lp_hal_init(void);
+struct renard_phy_s2lp;
 
 /*
- * Output: SPI and Shutdown
+ * HAL of a single S2-LP, passed to renard_phy_s2lp_init together with the HAL's own state (context), which is handed
+ * to every HAL function. Several S2-LPs can share one HAL with different contexts.
  */
-void renard_phy_s2lp_hal_spi(uint8_t length, uint8_t *in, uint8_t *out);
-void renard_phy_s2lp_hal_shutdown(bool shutdown);
+typedef struct
+{
+	/*
+	 * Initialization: phy is the driver context that the HAL reports asynchronous events to, see below
+	 */
+	void (*init)(void *context, struct renard_phy_s2lp *phy);
+
+	/*
+	 * Output: SPI and Shutdown
+	 */
+	void (*spi)(void *context, uint8_t length, uint8_t *in, uint8_t *out);
+	void (*shutdown)(void *context, bool shutdown);
+
+	/*
+	 * Input: Timeout and GPIO interrupts
+	 */
+	void (*interrupt_timeout)(void *context, uint32_t milliseconds);
+	void (*interrupt_gpio)(void *context, bool risingTrigger);
+	void (*interrupt_clear)(void *context);
+	bool (*interrupt_wait)(void *context);
+
+	/*
+	 * Optional: Asynchronous operation, only required if RENARD_PHY_S2LP_ASYNC is enabled (see conf_driver.h)
+	 * spi_async: Start SPI transfer (e.g. using DMA) and return immediately. The buffers remain valid until the HAL
+	 *   reports completion by calling renard_phy_s2lp_async_spi_done.
+	 * interrupt_async: While enabled, report GPIO and timeout interrupts by calling renard_phy_s2lp_async_interrupt
+	 *   from interrupt context instead of waking up interrupt_wait.
+	 */
+	void (*spi_async)(void *context, uint8_t length, uint8_t *in, uint8_t *out);
+	void (*interrupt_async)(void *context, bool enable);
+
+	/*
+	 * Optional: Statistics, only required if RENARD_PHY_S2LP_STATS or RENARD_PHY_S2LP_ENERGY is enabled (see
+	 * conf_driver.h)
+	 * timestamp: Free-running time in microseconds, may wrap around
+	 */
+	uint32_t (*timestamp)(void *context);
+} renard_phy_s2lp_hal_t;
 
 /*
- * Input: Timeout and GPIO interrupts
+ * Provided by renard-phy-s2lp, called by the HAL for asynchronous operation with the driver context passed to init
  */
-void renard_phy_s2lp_hal_interrupt_timeout(uint32_t milliseconds);
-void renard_phy_s2lp_hal_interrupt_gpio(bool risingTrigger);
-void renard_phy_s2lp_hal_interrupt_clear(void);
-bool renard_phy_s2lp_hal_interrupt_wait(void);
+void renard_phy_s2lp_async_spi_done(struct renard_phy_s2lp *phy);
+void renard_phy_s2lp_async_interrupt(struct renard_phy_s2lp *phy, bool is_gpio);
 
 #endif
@@ -0,0 +1,192 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "renard_phy_s2lp_hal.h"
+#include "renard_phy_s2lp_hal_trace.h"
+#include "conf_driver.h"
+
+#if (RENARD_PHY_S2LP_HAL_TRACE == 1)
+
+/*
+ * Record encoding:
+ * renard_phy_s2lp_hal_trace_varint: Append unsigned LEB128 varint to buffer, returns its length
+ * renard_phy_s2lp_hal_trace_begin: Start record of given type at the wrapped HAL's current time, returns its length
+ * renard_phy_s2lp_hal_trace_byte: Write record that consists of type, time and an optional single payload byte
+ */
+static uint8_t renard_phy_s2lp_hal_trace_varint(uint8_t *buffer, uint32_t value)
+{
+	uint8_t length = 0;
+
+	do {
+		buffer[length] = value & 0x7f;
+		value >>= 7;
+		if (value != 0)
+			buffer[length] |= 0x80;
+		length++;
+	} while (value != 0);
+
+	return length;
+}
+
+static uint8_t renard_phy_s2lp_hal_trace_begin(renard_phy_s2lp_hal_trace_t *trace, uint8_t type, uint8_t *record)
+{
+	uint32_t now = trace->hal->timestamp != NULL ? trace->hal->timestamp(trace->hal_context) : 0;
+	uint32_t delta = now - trace->time;
+
+	trace->time = now;
+	record[0] = type;
+
+	return 1 + renard_phy_s2lp_hal_trace_varint(&record[1], delta);
+}
+
+static void renard_phy_s2lp_hal_trace_byte(renard_phy_s2lp_hal_trace_t *trace, uint8_t type, bool has_value,
+		uint8_t value)
+{
+	uint8_t record[1 + 5 + 1];
+	uint8_t length = renard_phy_s2lp_hal_trace_begin(trace, type, record);
+
+	if (has_value)
+		record[length++] = value;
+
+	trace->write(trace->write_context, record, length);
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Recorder control interface
+ */
+void renard_phy_s2lp_hal_trace_setup(renard_phy_s2lp_hal_trace_t *trace, const renard_phy_s2lp_hal_t *hal,
+		void *hal_context, void (*write)(void *context, const uint8_t *data, uint16_t length), void *write_context)
+{
+	memset(trace, 0, sizeof(*trace));
+	trace->hal = hal;
+	trace->hal_context = hal_context;
+	trace->write = write;
+	trace->write_context = write_context;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * HAL implementation, see renard_phy_s2lp_hal.h
+ */
+static void renard_phy_s2lp_hal_trace_init(void *context, struct renard_phy_s2lp *phy)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+
+	if (!trace->started) {
+		uint8_t header[RENARD_PHY_S2LP_TRACE_HEADER_LENGTH] = {0};
+		memcpy(header, RENARD_PHY_S2LP_TRACE_MAGIC, 4);
+		header[4] = RENARD_PHY_S2LP_TRACE_VERSION;
+
+		trace->write(trace->write_context, header, sizeof(header));
+		trace->started = true;
+	}
+
+	trace->hal->init(trace->hal_context, phy);
+	renard_phy_s2lp_hal_trace_byte(trace, RENARD_PHY_S2LP_TRACE_INIT, false, 0);
+}
+
+static void renard_phy_s2lp_hal_trace_spi(void *context, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+	uint8_t record[1 + 5 + 1];
+	uint8_t position = renard_phy_s2lp_hal_trace_begin(trace, RENARD_PHY_S2LP_TRACE_SPI |
+			(out != NULL ? RENARD_PHY_S2LP_TRACE_MISO : 0), record);
+
+	trace->hal->spi(trace->hal_context, length, in, out);
+
+	/* Only type, time and length are buffered, MOSI and MISO are appended straight from the driver's buffers */
+	record[position++] = length;
+	trace->write(trace->write_context, record, position);
+	trace->write(trace->write_context, in, length);
+
+	if (out != NULL)
+		trace->write(trace->write_context, out, length);
+}
+
+static void renard_phy_s2lp_hal_trace_shutdown(void *context, bool shutdown)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+
+	renard_phy_s2lp_hal_trace_byte(trace, RENARD_PHY_S2LP_TRACE_SHUTDOWN, true, shutdown);
+	trace->hal->shutdown(trace->hal_context, shutdown);
+}
+
+static void renard_phy_s2lp_hal_trace_interrupt_timeout(void *context, uint32_t milliseconds)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+	uint8_t record[1 + 5 + 5];
+	uint8_t length = renard_phy_s2lp_hal_trace_begin(trace, RENARD_PHY_S2LP_TRACE_TIMEOUT, record);
+
+	length += renard_phy_s2lp_hal_trace_varint(&record[length], milliseconds);
+	trace->write(trace->write_context, record, length);
+
+	trace->hal->interrupt_timeout(trace->hal_context, milliseconds);
+}
+
+static void renard_phy_s2lp_hal_trace_interrupt_gpio(void *context, bool risingTrigger)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+
+	renard_phy_s2lp_hal_trace_byte(trace, RENARD_PHY_S2LP_TRACE_GPIO, true, risingTrigger);
+	trace->hal->interrupt_gpio(trace->hal_context, risingTrigger);
+}
+
+static void renard_phy_s2lp_hal_trace_interrupt_clear(void *context)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+
+	renard_phy_s2lp_hal_trace_byte(trace, RENARD_PHY_S2LP_TRACE_CLEAR, false, 0);
+	trace->hal->interrupt_clear(trace->hal_context);
+}
+
+static bool renard_phy_s2lp_hal_trace_interrupt_wait(void *context)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+	bool is_gpio = trace->hal->interrupt_wait(trace->hal_context);
+
+	renard_phy_s2lp_hal_trace_byte(trace, RENARD_PHY_S2LP_TRACE_WAIT, true, is_gpio);
+	return is_gpio;
+}
+
+static uint32_t renard_phy_s2lp_hal_trace_timestamp(void *context)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+
+	renard_phy_s2lp_hal_trace_byte(trace, RENARD_PHY_S2LP_TRACE_TIMESTAMP, false, 0);
+	return trace->time;
+}
+
+static void renard_phy_s2lp_hal_trace_spi_async(void *context, uint8_t length, uint8_t *in, uint8_t *out)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+
+	renard_phy_s2lp_hal_trace_byte(trace, RENARD_PHY_S2LP_TRACE_ASYNC, false, 0);
+	trace->hal->spi_async(trace->hal_context, length, in, out);
+}
+
+static void renard_phy_s2lp_hal_trace_interrupt_async(void *context, bool enable)
+{
+	renard_phy_s2lp_hal_trace_t *trace = context;
+
+	renard_phy_s2lp_hal_trace_byte(trace, RENARD_PHY_S2LP_TRACE_ASYNC, false, 0);
+	trace->hal->interrupt_async(trace->hal_context, enable);
+}
+
+const renard_phy_s2lp_hal_t renard_phy_s2lp_hal_trace_functions = {
+	.init = renard_phy_s2lp_hal_trace_init,
+	.spi = renard_phy_s2lp_hal_trace_spi,
+	.shutdown = renard_phy_s2lp_hal_trace_shutdown,
+	.interrupt_timeout = renard_phy_s2lp_hal_trace_interrupt_timeout,
+	.interrupt_gpio = renard_phy_s2lp_hal_trace_interrupt_gpio,
+	.interrupt_clear = renard_phy_s2lp_hal_trace_interrupt_clear,
+	.interrupt_wait = renard_phy_s2lp_hal_trace_interrupt_wait,
+	.spi_async = renard_phy_s2lp_hal_trace_spi_async,
+	.interrupt_async = renard_phy_s2lp_hal_trace_interrupt_async,
+	.timestamp = renard_phy_s2lp_hal_trace_timestamp
+};
+
+#endif
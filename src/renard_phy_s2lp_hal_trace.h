@@ -0,0 +1,80 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "renard_phy_s2lp_hal.h"
+
+/*
+ * renard-phy-s2lp-hal-trace - HAL wrapper that records the driver's HAL calls to a binary trace
+ *
+ * Placed between renard-phy-s2lp and any HAL (hardware or emulator), it forwards every call to the wrapped HAL and
+ * appends one record per call to a trace: SPI transactions (MOSI and, if the driver reads it, MISO), shutdown, timeout
+ * and GPIO interrupt configuration, interrupt waits with their result and timestamps. The records are handed to a
+ * write function, which may e.g. append them to a file, a flash region or a UART. Only built if
+ * RENARD_PHY_S2LP_HAL_TRACE is enabled (see conf_driver.h).
+ * A trace contains everything that the driver gets to see from the HAL, so host/renard_phy_s2lp_hal_replay can serve
+ * it back to the driver without hardware, see host/trace_tool.c.
+ *
+ * Trace format, all multi-byte values little endian, so that a trace can be memory-mapped and parsed in place:
+ * --> Header: RENARD_PHY_S2LP_TRACE_MAGIC (4 bytes), RENARD_PHY_S2LP_TRACE_VERSION (1 byte), 3 bytes reserved (0)
+ * --> Records: Type (1 byte, renard_phy_s2lp_trace_type_t, RENARD_PHY_S2LP_TRACE_MISO flag for SPI), time since the
+ *     previous record in us (unsigned LEB128 varint, 1 byte for gaps below 128us, the first record's time is relative
+ *     to timestamp 0), followed by the payload:
+ *     INIT, CLEAR, TIMESTAMP, ASYNC: no payload
+ *     SPI: length (1 byte), MOSI (length bytes), MISO (length bytes, only with RENARD_PHY_S2LP_TRACE_MISO)
+ *     SHUTDOWN, GPIO, WAIT: shutdown / rising trigger / GPIO interrupt (1 byte, 0 or 1)
+ *     TIMEOUT: milliseconds (unsigned LEB128 varint)
+ * The time of a record is the wrapped HAL's timestamp before the call, or after the call for WAIT, so that it is the
+ * wakeup time. Without timestamp function, all times are 0. TIMESTAMP records the driver reading the timestamp.
+ * Asynchronous operation (RENARD_PHY_S2LP_ASYNC) is forwarded, but not recorded, the trace then contains an ASYNC
+ * record that marks it as incomplete.
+ */
+
+#ifndef _RENARD_PHY_S2LP_HAL_TRACE_H
+#define _RENARD_PHY_S2LP_HAL_TRACE_H
+
+#define RENARD_PHY_S2LP_TRACE_MAGIC "RPST"
+#define RENARD_PHY_S2LP_TRACE_VERSION 1
+#define RENARD_PHY_S2LP_TRACE_HEADER_LENGTH 8
+
+#define RENARD_PHY_S2LP_TRACE_MISO 0x80
+#define RENARD_PHY_S2LP_TRACE_TYPE_MASK 0x7f
+
+typedef enum {
+	RENARD_PHY_S2LP_TRACE_INIT = 0,
+	RENARD_PHY_S2LP_TRACE_SPI = 1,
+	RENARD_PHY_S2LP_TRACE_SHUTDOWN = 2,
+	RENARD_PHY_S2LP_TRACE_TIMEOUT = 3,
+	RENARD_PHY_S2LP_TRACE_GPIO = 4,
+	RENARD_PHY_S2LP_TRACE_CLEAR = 5,
+	RENARD_PHY_S2LP_TRACE_WAIT = 6,
+	RENARD_PHY_S2LP_TRACE_TIMESTAMP = 7,
+	RENARD_PHY_S2LP_TRACE_ASYNC = 8,
+	RENARD_PHY_S2LP_TRACE_TYPE_COUNT
+} renard_phy_s2lp_trace_type_t;
+
+/*
+ * Recorder instance, set up with renard_phy_s2lp_hal_trace_setup, all other members are private.
+ * write: Append data to the trace. SPI records are appended in up to three parts (type, time and length, MOSI, MISO),
+ *   all other records and the header in one piece.
+ */
+typedef struct
+{
+	const renard_phy_s2lp_hal_t *hal;
+	void *hal_context;
+	void (*write)(void *context, const uint8_t *data, uint16_t length);
+	void *write_context;
+
+	bool started;
+	uint32_t time;
+} renard_phy_s2lp_hal_trace_t;
+
+extern const renard_phy_s2lp_hal_t renard_phy_s2lp_hal_trace_functions;
+
+/*
+ * Wrap hal (with its context hal_context), pass renard_phy_s2lp_hal_trace_functions and trace to renard_phy_s2lp_init.
+ * The trace header is written on the first initialization.
+ */
+void renard_phy_s2lp_hal_trace_setup(renard_phy_s2lp_hal_trace_t *trace, const renard_phy_s2lp_hal_t *hal,
+		void *hal_context, void (*write)(void *context, const uint8_t *data, uint16_t length), void *write_context);
+
+#endif
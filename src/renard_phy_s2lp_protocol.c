@@ -1,10 +1,12 @@
 #include <stdint.h>
+#include <string.h>
 
 /* librenard */
 #include "uplink.h"
 #include "downlink.h"
 
 #include "renard_phy_s2lp_hal.h"
+#include "conf_driver.h"
 
 #include "renard_phy_s2lp_rc_profiles.h"
 #include "renard_phy_s2lp_protocol.h"
@@ -19,131 +21,558 @@
 #define INTERVAL_UL_TO_DL 20000
 #define INTERVAL_DL_WINDOW 25000
 
-static uint16_t m_random_current;
+void renard_phy_s2lp_protocol_init(renard_phy_s2lp_protocol_t *protocol, renard_phy_s2lp_t *phy, uint16_t random)
+{
+	memset(protocol, 0, sizeof(*protocol));
+	protocol->phy = phy;
+	protocol->random = random == 0 ? 1 : random;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Transfer statistics, see conf_driver.h
+ * STATS(statement) only executes statement if statistics are enabled
+ */
+#if (RENARD_PHY_S2LP_STATS == 1)
+
+#define STATS(statement) do { statement; } while (0)
+
+static void renard_phy_s2lp_protocol_stats_start(renard_phy_s2lp_protocol_t *protocol)
+{
+	memset(&protocol->stats, 0, sizeof(protocol->stats));
+	renard_phy_s2lp_stats_reset(protocol->phy);
+	protocol->stats.start = renard_phy_s2lp_timestamp(protocol->phy);
+	protocol->stats.min_fifo_level = 0xff;
+}
+
+static void renard_phy_s2lp_protocol_stats_uplink(renard_phy_s2lp_protocol_t *protocol, uint8_t fcount,
+		const renard_phy_s2lp_tx_report_t *report)
+{
+	protocol->stats.uplink_end[fcount] = renard_phy_s2lp_timestamp(protocol->phy);
+
+	if (report->underrun)
+		protocol->stats.uplink_underruns |= 1 << fcount;
+
+	if (report->min_fifo_level < protocol->stats.min_fifo_level)
+		protocol->stats.min_fifo_level = report->min_fifo_level;
+}
+
+static void renard_phy_s2lp_protocol_stats_end(renard_phy_s2lp_protocol_t *protocol,
+		renard_phy_s2lp_protocol_error_t error)
+{
+	protocol->stats.end = renard_phy_s2lp_timestamp(protocol->phy);
+	protocol->stats.error = error;
+	protocol->stats.phy = *renard_phy_s2lp_stats(protocol->phy);
+}
+
+static void renard_phy_s2lp_protocol_stats_candidate(renard_phy_s2lp_protocol_t *protocol,
+		const renard_phy_s2lp_protocol_candidate_t *candidate, const sfx_dl_plain *downlink)
+{
+	if (protocol->stats.candidates < PROTOCOL_STATS_CANDIDATES) {
+		protocol->stats.candidate_time[protocol->stats.candidates] = candidate->timestamp;
+		protocol->stats.candidate_result[protocol->stats.candidates] = downlink->crc_ok | downlink->mac_ok << 1;
+	}
+
+	if (protocol->stats.candidates < UINT8_MAX)
+		protocol->stats.candidates++;
+}
+
+#else
+
+#define STATS(statement) do { } while (0)
+
+#endif
 
 /*
- * 16-bit XORshift
- * For internal use only, chooses next pseudorandom number (used for first uplink frequency) using.
+ * Energy accounting, see conf_driver.h
+ * ENERGY(statement) only executes statement if energy accounting is enabled
  */
-uint16_t random_next()
+#if (RENARD_PHY_S2LP_ENERGY == 1)
+
+#define ENERGY(statement) do { statement; } while (0)
+
+#else
+
+#define ENERGY(statement) do { } while (0)
+
+#endif
+
+/**********************************************************************************************************************/
+
+/*
+ * Transfer state machine, shared by blocking and non-blocking transfers:
+ * Every state waits for one kind of event (uplink frame transmitted, timer interrupt, GPIO interrupt). Blocking
+ * transfers obtain events from renard_phy_s2lp_interrupt_wait, non-blocking transfers from interrupts that the
+ * HAL reports asynchronously (see renard_phy_s2lp_async_event).
+ */
+typedef enum
+{
+	PROTOCOL_EVENT_UPLINK_DONE = 0,
+	PROTOCOL_EVENT_TIMEOUT,
+	PROTOCOL_EVENT_GPIO
+} renard_phy_s2lp_protocol_event_t;
+
+static void renard_phy_s2lp_protocol_step(renard_phy_s2lp_protocol_transfer_t *transfer,
+		renard_phy_s2lp_protocol_event_t event);
+
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+static void renard_phy_s2lp_protocol_uplink_done(void *context)
 {
-	m_random_current ^= m_random_current << 7;
-	m_random_current ^= m_random_current >> 9;
-	m_random_current ^= m_random_current << 8;
+	renard_phy_s2lp_protocol_t *protocol = context;
+	protocol->uplink_done = true;
+}
+#endif
+
+static void renard_phy_s2lp_protocol_complete(renard_phy_s2lp_protocol_transfer_t *transfer,
+		renard_phy_s2lp_protocol_error_t error)
+{
+	renard_phy_s2lp_protocol_t *protocol = transfer->protocol;
+	renard_phy_s2lp_t *phy = protocol->phy;
+
+	/* clear all interrupts (timer / gpio) */
+	renard_phy_s2lp_interrupt_clear(phy);
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+	if (!transfer->blocking)
+		renard_phy_s2lp_interrupt_async(phy, false);
+#endif
+
+	transfer->state = PROTOCOL_STATE_IDLE;
+	transfer->error = error;
+
+	STATS(renard_phy_s2lp_protocol_stats_end(protocol, error));
+	ENERGY(protocol->energy = *renard_phy_s2lp_energy(phy));
+	RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_TRANSFER_DONE, error);
+
+	if (transfer->done != NULL)
+		transfer->done(transfer->done_context, error);
+}
+
+/*
+ * Transmit uplink frame number transfer->fcount: Initial frame, first replica or second replica
+ */
+static void renard_phy_s2lp_protocol_uplink(renard_phy_s2lp_protocol_transfer_t *transfer)
+{
+	renard_phy_s2lp_protocol_t *protocol = transfer->protocol;
+	renard_phy_s2lp_t *phy = protocol->phy;
+	uint8_t fcount = transfer->fcount;
+	uint8_t *bytestream = transfer->bytestream;
+
+	transfer->bytestream_len = (transfer->uplink_encoded.framelen_nibbles + 5) / 2;
+	memset(bytestream, 0, sizeof(transfer->bytestream));
+	bytestream[0] = 0xaa;
+	bytestream[1] = 0xaa;
+	bytestream[2] = 0xa0;
+
+	for (uint8_t i = 0; i < transfer->uplink_encoded.framelen_nibbles; i++) {
+		bytestream[(i + 5) / 2] = i % 2 == 0 ?
+				(bytestream[(i + 5) / 2] & 0xf0) | ((transfer->uplink_encoded.frame[fcount][i / 2] & 0xf0) >> 4) :
+				(bytestream[(i + 5) / 2] & 0x0f) | ((transfer->uplink_encoded.frame[fcount][i / 2] & 0x0f) << 4);
+	}
+
+	/* Switch to correct frequency: Initial frame, first replica or second replica frequency */
+	renard_phy_s2lp_retune(phy, &transfer->uplink_channels[fcount]);
+
+	/* Transmit actual uplink */
+	transfer->state = PROTOCOL_STATE_UPLINK;
+	STATS(protocol->stats.uplink_start[fcount] = renard_phy_s2lp_timestamp(phy));
+	STATS(protocol->stats.uplinks = fcount + 1);
+	RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_UPLINK_START, fcount);
+
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+	if (!transfer->blocking) {
+		protocol->uplink_done = false;
+		renard_phy_s2lp_tx_async(phy, bytestream, transfer->bytestream_len, transfer->datarate, transfer->rc_profile,
+				renard_phy_s2lp_protocol_uplink_done, protocol);
+		return;
+	}
+#endif
+
+	renard_phy_s2lp_tx(phy, bytestream, transfer->bytestream_len, transfer->datarate, transfer->rc_profile);
+	renard_phy_s2lp_protocol_step(transfer, PROTOCOL_EVENT_UPLINK_DONE);
+}
+
+/*
+ * Downlink candidate ring, see conf_driver.h
+ * renard_phy_s2lp_protocol_decode: Decode the oldest captured candidate, returns true if it is a valid downlink.
+ * renard_phy_s2lp_protocol_decode_next: Same while still listening, ends the transfer if the candidate is valid.
+ * renard_phy_s2lp_protocol_capture: Fetch the received frame into the ring and listen again right away.
+ */
+static bool renard_phy_s2lp_protocol_decode(renard_phy_s2lp_protocol_transfer_t *transfer)
+{
+	renard_phy_s2lp_protocol_candidate_t *candidate = &transfer->candidates[transfer->candidates_first];
+	transfer->candidates_first = (transfer->candidates_first + 1) % RENARD_PHY_S2LP_DL_CANDIDATES;
+	transfer->candidates_pending--;
+
+	sfx_downlink_decode(candidate->encoded, *transfer->common, transfer->downlink);
+	*transfer->downlink_rssi = candidate->rssi;
+	STATS(renard_phy_s2lp_protocol_stats_candidate(transfer->protocol, candidate, transfer->downlink));
+	RENARD_PHY_S2LP_TRACE(transfer->protocol->phy, S2LP_TRACE_RX_CANDIDATE,
+			transfer->downlink->crc_ok | transfer->downlink->mac_ok << 1);
+
+	return transfer->downlink->crc_ok && transfer->downlink->mac_ok;
+}
+
+static void renard_phy_s2lp_protocol_decode_next(renard_phy_s2lp_protocol_transfer_t *transfer)
+{
+	if (renard_phy_s2lp_protocol_decode(transfer)) {
+		renard_phy_s2lp_rx_finish(transfer->protocol->phy, false, NULL, NULL);
+		renard_phy_s2lp_protocol_complete(transfer, PROTOCOL_ERROR_NONE);
+	}
+}
+
+static void renard_phy_s2lp_protocol_capture(renard_phy_s2lp_protocol_transfer_t *transfer)
+{
+	renard_phy_s2lp_t *phy = transfer->protocol->phy;
+
+	/* Ring is full: make room by decoding the oldest candidate first, it may be the downlink */
+	if (transfer->candidates_pending == RENARD_PHY_S2LP_DL_CANDIDATES) {
+		renard_phy_s2lp_protocol_decode_next(transfer);
+		if (transfer->state != PROTOCOL_STATE_DOWNLINK)
+			return;
+	}
+
+	uint8_t slot = (transfer->candidates_first + transfer->candidates_pending) % RENARD_PHY_S2LP_DL_CANDIDATES;
+	renard_phy_s2lp_protocol_candidate_t *candidate = &transfer->candidates[slot];
+
+	candidate->timestamp = 0;
+	STATS(candidate->timestamp = renard_phy_s2lp_timestamp(phy));
+	renard_phy_s2lp_rx_read(phy, candidate->encoded.frame, &candidate->rssi);
+	renard_phy_s2lp_rx_restart(phy);
+	transfer->candidates_pending++;
+}
+
+static void renard_phy_s2lp_protocol_step(renard_phy_s2lp_protocol_transfer_t *transfer,
+		renard_phy_s2lp_protocol_event_t event)
+{
+	renard_phy_s2lp_protocol_t *protocol = transfer->protocol;
+	renard_phy_s2lp_t *phy = protocol->phy;
+
+	switch (transfer->state) {
+		case PROTOCOL_STATE_UPLINK:
+			if (event != PROTOCOL_EVENT_UPLINK_DONE)
+				break;
+
+			STATS(renard_phy_s2lp_protocol_stats_uplink(protocol, transfer->fcount, renard_phy_s2lp_tx_report(phy)));
+			RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_UPLINK_DONE,
+					transfer->fcount | (renard_phy_s2lp_tx_report(phy)->underrun ? 0x100 : 0));
+
+			if (transfer->uplink->replicas && transfer->fcount < 2) {
+				/* Wait interframe period */
+				renard_phy_s2lp_interrupt_timeout(phy, INTERVAL_INTERFRAME);
+				transfer->state = PROTOCOL_STATE_INTERFRAME;
+			} else if (transfer->uplink->request_downlink) {
+				/*
+				 * Wait until downlink window starts
+				 * INTERVAL_UL_TO_DL is the time between the end of the final uplink replica and the start of the
+				 * downlink listening window. Since we need the timeout interrupt for interframe timing during uplink
+				 * procedure, we just compute how much time the replicas must have taken (if any).
+				 */
+				uint32_t replica_duration = 0;
+				if (transfer->uplink->replicas) {
+					replica_duration += 2 * INTERVAL_INTERFRAME;
+					uint32_t symbol_duration_us = (transfer->datarate == UL_DATARATE_600BPS ? 1667 : 10000);
+					replica_duration += 2 * transfer->bytestream_len * 8 * symbol_duration_us / 1000;
+				}
+				RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_DOWNLINK_WAIT, INTERVAL_UL_TO_DL - replica_duration);
+#if (RENARD_PHY_S2LP_SLEEP_BEFORE_DOWNLINK == 1)
+				/* Sleep through the gap, wake up just in time for the crystal oscillator to be stable */
+				renard_phy_s2lp_sleep(phy);
+				renard_phy_s2lp_interrupt_timeout(phy, INTERVAL_UL_TO_DL - replica_duration -
+						RENARD_PHY_S2LP_WAKEUP_LEAD_MS);
+				RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_SLEEP,
+						INTERVAL_UL_TO_DL - replica_duration - RENARD_PHY_S2LP_WAKEUP_LEAD_MS);
+#else
+				renard_phy_s2lp_interrupt_timeout(phy, INTERVAL_UL_TO_DL - replica_duration);
+#endif
+				transfer->state = PROTOCOL_STATE_UL_TO_DL;
+			} else {
+				renard_phy_s2lp_protocol_complete(transfer, PROTOCOL_ERROR_NONE);
+			}
+			break;
+
+		case PROTOCOL_STATE_INTERFRAME:
+			if (event != PROTOCOL_EVENT_TIMEOUT)
+				break;
+
+			transfer->fcount++;
+			renard_phy_s2lp_protocol_uplink(transfer);
+			break;
+
+		case PROTOCOL_STATE_UL_TO_DL:
+			if (event != PROTOCOL_EVENT_TIMEOUT)
+				break;
+
+#if (RENARD_PHY_S2LP_SLEEP_BEFORE_DOWNLINK == 1)
+			renard_phy_s2lp_wakeup(phy);
+			renard_phy_s2lp_interrupt_timeout(phy, RENARD_PHY_S2LP_WAKEUP_LEAD_MS);
+			transfer->state = PROTOCOL_STATE_WAKEUP;
+			STATS(protocol->stats.wakeup = renard_phy_s2lp_timestamp(phy));
+			RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_WAKEUP, 0);
+			break;
+
+		case PROTOCOL_STATE_WAKEUP:
+			if (event != PROTOCOL_EVENT_TIMEOUT)
+				break;
+#endif
+
+			/* Put S2-LP in RX mode and start downlink window timer (MCU timer or S2-LP's RX timer) */
+			renard_phy_s2lp_mode(phy, S2LP_MODE_RX);
+			renard_phy_s2lp_retune(phy, &transfer->downlink_channel);
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+			renard_phy_s2lp_rx_timeout(phy, INTERVAL_DL_WINDOW);
+#else
+			renard_phy_s2lp_interrupt_timeout(phy, INTERVAL_DL_WINDOW);
+#endif
+			renard_phy_s2lp_rx_start(phy);
+			transfer->state = PROTOCOL_STATE_DOWNLINK;
+			STATS(protocol->stats.rx_armed = renard_phy_s2lp_timestamp(phy));
+			RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_RX_ARMED, 0);
+			break;
 
-	return m_random_current;
+		case PROTOCOL_STATE_DOWNLINK:
+#if (RENARD_PHY_S2LP_RX_HW_TIMEOUT == 1)
+			/* The S2-LP's RX timer reports the end of the downlink window (or of a timer period) as GPIO interrupt */
+			if (event == PROTOCOL_EVENT_GPIO) {
+				renard_phy_s2lp_rx_status_t status = renard_phy_s2lp_rx_irq(phy);
+				if (status == S2LP_RX_PENDING)
+					break;
+
+				if (status == S2LP_RX_TIMEOUT)
+					event = PROTOCOL_EVENT_TIMEOUT;
+			}
+#endif
+
+			if (event == PROTOCOL_EVENT_GPIO) {
+				/*
+				 * received frame - might be valid, might be not - capture it and listen again, the real downlink may
+				 * follow right after a false SYNC word detection. Candidates are decoded later, see
+				 * renard_phy_s2lp_protocol_decode_next.
+				 */
+				renard_phy_s2lp_protocol_capture(transfer);
+			} else if (event == PROTOCOL_EVENT_TIMEOUT) {
+				/* Downlink window is over, decode the candidates that are still waiting */
+				renard_phy_s2lp_rx_finish(phy, false, NULL, NULL);
+
+				bool valid = false;
+				while (!valid && transfer->candidates_pending > 0)
+					valid = renard_phy_s2lp_protocol_decode(transfer);
+
+				renard_phy_s2lp_protocol_complete(transfer, valid ? PROTOCOL_ERROR_NONE : PROTOCOL_ERROR_TIMEOUT);
+			}
+			break;
+
+		default:
+			break;
+	}
 }
 
-void renard_phy_s2lp_protocol_init(uint16_t random)
+/*
+ * Transfer was rejected before anything was transmitted
+ */
+static renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_reject(renard_phy_s2lp_protocol_t *protocol,
+		renard_phy_s2lp_protocol_error_t error)
 {
-	m_random_current = random == 0 ? 1 : random;
+	(void)protocol;
+	STATS(renard_phy_s2lp_protocol_stats_end(protocol, error));
+	ENERGY(protocol->energy = *renard_phy_s2lp_energy(protocol->phy));
+	RENARD_PHY_S2LP_TRACE(protocol->phy, S2LP_TRACE_TRANSFER_DONE, error);
+
+	return error;
 }
 
-renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_transfer(sfx_commoninfo *common, sfx_ul_plain *uplink,
+static renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_begin(renard_phy_s2lp_protocol_t *protocol,
+		renard_phy_s2lp_protocol_transfer_t *transfer, sfx_commoninfo *common, sfx_ul_plain *uplink,
 		sfx_dl_plain *downlink, renard_phy_s2lp_rc_t rc_profile, renard_phy_s2lp_ul_datarate_t datarate,
-		int16_t *downlink_rssi)
+		int16_t *downlink_rssi, bool blocking)
 {
+	renard_phy_s2lp_t *phy = protocol->phy;
+
+	STATS(renard_phy_s2lp_protocol_stats_start(protocol));
+	ENERGY(renard_phy_s2lp_energy_reset(phy));
+	RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_TRANSFER_START, 0);
+
 	/*
 	 * Check if we're allowed to use desired data rate in given Sigfox Radio Configuration
 	 */
 	if (!renard_phy_s2lp_baudrates_allowed_by_rc[rc_profile][datarate])
-		return PROTOCOL_ERROR_INVALID_PROFILE;
+		return renard_phy_s2lp_protocol_reject(protocol, PROTOCOL_ERROR_INVALID_PROFILE);
 
 	/*
 	 * Encode uplink using librenard
 	 */
-	sfx_ul_encoded uplink_encoded;
-	if (sfx_uplink_encode(*uplink, *common, &uplink_encoded))
-		return PROTOCOL_ERROR_ULENCODE;
+	if (sfx_uplink_encode(*uplink, *common, &transfer->uplink_encoded))
+		return renard_phy_s2lp_protocol_reject(protocol, PROTOCOL_ERROR_ULENCODE);
+
+	STATS(protocol->stats.encoded = renard_phy_s2lp_timestamp(phy));
+	RENARD_PHY_S2LP_TRACE(phy, S2LP_TRACE_ENCODED, 0);
 
 	/*
-	 * Randomly choose initial uplink's carrier frequency
+	 * Randomly choose initial uplink's carrier frequency, replicas follow at fixed offsets
 	 */
-	uint32_t freq_interframe_gap = renard_phy_s2lp_freq_interframe_gap_by_rc[rc_profile];
-	uint32_t lowerbound = renard_phy_s2lp_freq_bound_low_by_rc[rc_profile] +
-			(uplink->replicas ? freq_interframe_gap : 0);
-	uint32_t upperbound = renard_phy_s2lp_freq_bound_high_by_rc[rc_profile] -
-			(uplink->replicas ? freq_interframe_gap : 0);
-	uint32_t initial_uplink_frequency = lowerbound + (uint64_t)(upperbound - lowerbound) * random_next() / 0xffff;
+	uint32_t uplink_frequencies[3];
+	renard_phy_s2lp_uplink_carriers(rc_profile, uplink->replicas, renard_phy_s2lp_random_next(&protocol->random),
+			uplink_frequencies);
 
 	/*
-	 * Transmit uplink: Depending on whether or not replicas were requested, once or multiple times
+	 * Precompute channel plan: Initial uplink frame, first replica, second replica and downlink frequency, so that
+	 * every retune during the transfer is a single SPI transaction
 	 */
-	uint8_t ul_bytestream_len = 0;
-	renard_phy_s2lp_mode(S2LP_MODE_TX);
-	for (uint8_t fcount = 0; fcount < (uplink->replicas ? 3 : 1); fcount++) {
-		ul_bytestream_len = (uplink_encoded.framelen_nibbles + 5) / 2;
-		uint8_t bytestream[SFX_UL_MAX_FRAMELEN] = {0xaa, 0xaa, 0xa0};
-
-		for (uint8_t i = 0; i < uplink_encoded.framelen_nibbles; i++) {
-			bytestream[(i + 5) / 2] = i % 2 == 0 ?
-					(bytestream[(i + 5) / 2] & 0xf0) | ((uplink_encoded.frame[fcount][i / 2] & 0xf0) >> 4) :
-					(bytestream[(i + 5) / 2] & 0x0f) | ((uplink_encoded.frame[fcount][i / 2] & 0x0f) << 4);
-		}
-
-		/* Switch to correct frequency: Initial frame, first replica or second replica frequency */
-		uint32_t frequency = initial_uplink_frequency;
-		if (fcount == 1)
-			frequency = initial_uplink_frequency + freq_interframe_gap;
-		else if (fcount == 2)
-			frequency = initial_uplink_frequency - freq_interframe_gap;
-		renard_phy_s2lp_frequency(frequency);
-
-		/* Transmit actual uplink */
-		renard_phy_s2lp_tx(bytestream, ul_bytestream_len, datarate, rc_profile);
-
-		/* Wait interframe period */
-		if (uplink->replicas && fcount < 2) {
-			renard_phy_s2lp_hal_interrupt_timeout(INTERVAL_INTERFRAME);
-			renard_phy_s2lp_hal_interrupt_wait();
-		}
-	}
+	for (uint8_t fcount = 0; fcount < 3; fcount++)
+		renard_phy_s2lp_channel(phy, &transfer->uplink_channels[fcount], uplink_frequencies[fcount]);
+	renard_phy_s2lp_channel(phy, &transfer->downlink_channel,
+			uplink_frequencies[0] + renard_phy_s2lp_freq_ul_dl_gap_by_rc[rc_profile]);
+
+	transfer->protocol = protocol;
+	transfer->common = common;
+	transfer->uplink = uplink;
+	transfer->downlink = downlink;
+	transfer->downlink_rssi = downlink_rssi;
+	transfer->rc_profile = rc_profile;
+	transfer->datarate = datarate;
+	transfer->blocking = blocking;
+	transfer->error = PROTOCOL_ERROR_NONE;
+	transfer->fcount = 0;
+	transfer->candidates_first = 0;
+	transfer->candidates_pending = 0;
 
 	/*
-	 * If downlink was requested, wait for downlink
+	 * Transmit uplink: Depending on whether or not replicas were requested, once or multiple times
 	 */
-	bool timeout = false;
-
-	if (uplink->request_downlink)
-	{
-		/*
-		 * Wait until downlink window starts
-		 * INTERVAL_UL_TO_DL is the time between the end of the final uplink replica and the start of the downlink
-		 * listening window. Since we need the timeout interrupt for interframe timing during uplink procedure,
-		 * we just compute how much time the replicas must have taken (if any).
-		 */
-		uint32_t replica_duration = 0;
-		if (uplink->replicas) {
-			replica_duration += 2 * INTERVAL_INTERFRAME;
-			uint32_t symbol_duration_us = (datarate == UL_DATARATE_600BPS ? 1667 : 10000);
-			replica_duration += 2 * ul_bytestream_len * 8 * symbol_duration_us / 1000;
-		}
-		renard_phy_s2lp_hal_interrupt_timeout(INTERVAL_UL_TO_DL - replica_duration);
-		renard_phy_s2lp_hal_interrupt_wait();
-
-		/* Put S2-LP in RX mode and start downlink window timer */
-		sfx_dl_encoded dl_encoded;
-		renard_phy_s2lp_mode(S2LP_MODE_RX);
-		renard_phy_s2lp_frequency(initial_uplink_frequency + renard_phy_s2lp_freq_ul_dl_gap_by_rc[rc_profile]);
-		renard_phy_s2lp_hal_interrupt_timeout(INTERVAL_DL_WINDOW);
-
-		while (true) {
-			if (renard_phy_s2lp_rx(dl_encoded.frame, downlink_rssi))
-			{
-				/* received frame - might be valid, might be not - decode and check! */
-				sfx_downlink_decode(dl_encoded, *common, downlink);
-
-				if (downlink->crc_ok && downlink->mac_ok)
-					break;
-			} else {
-				timeout = true;
-				break;
-			}
-		}
+	renard_phy_s2lp_mode(phy, S2LP_MODE_TX);
+	renard_phy_s2lp_protocol_uplink(transfer);
+
+	return PROTOCOL_ERROR_NONE;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Public interface
+ */
+renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_transfer(renard_phy_s2lp_protocol_t *protocol,
+		sfx_commoninfo *common, sfx_ul_plain *uplink, sfx_dl_plain *downlink, renard_phy_s2lp_rc_t rc_profile,
+		renard_phy_s2lp_ul_datarate_t datarate, int16_t *downlink_rssi)
+{
+	renard_phy_s2lp_protocol_transfer_t transfer;
+	transfer.done = NULL;
+
+	renard_phy_s2lp_protocol_error_t error = renard_phy_s2lp_protocol_begin(protocol, &transfer, common, uplink,
+			downlink, rc_profile, datarate, downlink_rssi, true);
+	if (error != PROTOCOL_ERROR_NONE)
+		return error;
+
+	while (transfer.state != PROTOCOL_STATE_IDLE) {
+		bool is_gpio_ir = renard_phy_s2lp_interrupt_wait(protocol->phy);
+		renard_phy_s2lp_protocol_step(&transfer, is_gpio_ir ? PROTOCOL_EVENT_GPIO : PROTOCOL_EVENT_TIMEOUT);
+
+		/* The receiver is listening again, decode captured candidates before waiting for the next interrupt */
+		while (transfer.state == PROTOCOL_STATE_DOWNLINK && transfer.candidates_pending > 0)
+			renard_phy_s2lp_protocol_decode_next(&transfer);
 	}
 
-	/* clear all interrupts (timer / gpio) */
-	renard_phy_s2lp_hal_interrupt_clear();
+	return transfer.error;
+}
+
+#if (RENARD_PHY_S2LP_ASYNC == 1)
 
-	return timeout ? PROTOCOL_ERROR_TIMEOUT : PROTOCOL_ERROR_NONE;
+renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_start(renard_phy_s2lp_protocol_t *protocol,
+		renard_phy_s2lp_protocol_transfer_t *transfer, sfx_commoninfo *common, sfx_ul_plain *uplink,
+		sfx_dl_plain *downlink, renard_phy_s2lp_rc_t rc_profile, renard_phy_s2lp_ul_datarate_t datarate,
+		int16_t *downlink_rssi, void (*done)(void *context, renard_phy_s2lp_protocol_error_t error), void *context)
+{
+	/* Discard interrupts that were latched before this transfer */
+	renard_phy_s2lp_async_event(protocol->phy, S2LP_EVENT_GPIO);
+	renard_phy_s2lp_async_event(protocol->phy, S2LP_EVENT_TIMEOUT);
+
+	transfer->done = done;
+	transfer->done_context = context;
+	transfer->state = PROTOCOL_STATE_IDLE;
+
+	return renard_phy_s2lp_protocol_begin(protocol, transfer, common, uplink, downlink, rc_profile, datarate,
+			downlink_rssi, false);
 }
+
+bool renard_phy_s2lp_protocol_poll(renard_phy_s2lp_protocol_transfer_t *transfer)
+{
+	renard_phy_s2lp_protocol_t *protocol = transfer->protocol;
+	renard_phy_s2lp_t *phy = protocol->phy;
+
+	/* Asynchronous transmission reports interrupts to renard-phy-s2lp again once the uplink frame is complete */
+	if (transfer->state == PROTOCOL_STATE_UPLINK && protocol->uplink_done) {
+		protocol->uplink_done = false;
+		renard_phy_s2lp_interrupt_async(phy, true);
+		renard_phy_s2lp_protocol_step(transfer, PROTOCOL_EVENT_UPLINK_DONE);
+	}
+
+	if (transfer->state != PROTOCOL_STATE_IDLE && renard_phy_s2lp_async_event(phy, S2LP_EVENT_GPIO))
+		renard_phy_s2lp_protocol_step(transfer, PROTOCOL_EVENT_GPIO);
+
+	if (transfer->state != PROTOCOL_STATE_IDLE && renard_phy_s2lp_async_event(phy, S2LP_EVENT_TIMEOUT))
+		renard_phy_s2lp_protocol_step(transfer, PROTOCOL_EVENT_TIMEOUT);
+
+	/* Decode captured candidates, but capture frames received in the meantime first so that RX is re-armed quickly */
+	while (transfer->state == PROTOCOL_STATE_DOWNLINK && transfer->candidates_pending > 0) {
+		if (renard_phy_s2lp_async_event(phy, S2LP_EVENT_GPIO))
+			renard_phy_s2lp_protocol_step(transfer, PROTOCOL_EVENT_GPIO);
+		else
+			renard_phy_s2lp_protocol_decode_next(transfer);
+	}
+
+	return transfer->state != PROTOCOL_STATE_IDLE;
+}
+
+renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_cancel(renard_phy_s2lp_protocol_transfer_t *transfer)
+{
+	renard_phy_s2lp_t *phy = transfer->protocol->phy;
+
+	switch (transfer->state) {
+		case PROTOCOL_STATE_IDLE:
+			return transfer->error;
+
+		case PROTOCOL_STATE_UPLINK:
+			renard_phy_s2lp_tx_async_cancel(phy);
+			break;
+
+		case PROTOCOL_STATE_UL_TO_DL:
+#if (RENARD_PHY_S2LP_SLEEP_BEFORE_DOWNLINK == 1)
+			/* S2-LP is sleeping through the gap before the downlink window, bring it back to READY */
+			renard_phy_s2lp_wakeup(phy);
+#endif
+			break;
+
+		case PROTOCOL_STATE_DOWNLINK:
+			renard_phy_s2lp_rx_finish(phy, false, NULL, NULL);
+			break;
+
+		default:
+			/* INTERFRAME and WAKEUP: S2-LP is in READY already, only the pending timeout needs to be cleared */
+			break;
+	}
+
+	/* Completing clears the pending timeout / GPIO interrupt and stops reporting interrupts to the driver */
+	transfer->done = NULL;
+	renard_phy_s2lp_protocol_complete(transfer, PROTOCOL_ERROR_CANCELLED);
+
+	return PROTOCOL_ERROR_CANCELLED;
+}
+
+#endif
+
+#if (RENARD_PHY_S2LP_STATS == 1)
+
+const renard_phy_s2lp_protocol_stats_t *renard_phy_s2lp_protocol_stats(renard_phy_s2lp_protocol_t *protocol)
+{
+	return &protocol->stats;
+}
+
+#endif
+
+#if (RENARD_PHY_S2LP_ENERGY == 1)
+
+const renard_phy_s2lp_energy_t *renard_phy_s2lp_protocol_energy(renard_phy_s2lp_protocol_t *protocol)
+{
+	return &protocol->energy;
+}
+
+#endif
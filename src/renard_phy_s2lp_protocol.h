@@ -1,6 +1,8 @@
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "renard_phy_s2lp.h"
+#include "conf_driver.h"
 
 /* librenard */
 #include "downlink.h"
@@ -14,12 +16,148 @@ typedef enum
 	PROTOCOL_ERROR_NONE = 0,
 	PROTOCOL_ERROR_ULENCODE,
 	PROTOCOL_ERROR_TIMEOUT,
-	PROTOCOL_ERROR_INVALID_PROFILE
+	PROTOCOL_ERROR_INVALID_PROFILE,
+	PROTOCOL_ERROR_CANCELLED
 } renard_phy_s2lp_protocol_error_t;
 
-void renard_phy_s2lp_protocol_init(uint16_t random);
-renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_transfer(sfx_commoninfo *common, sfx_ul_plain *uplink,
+typedef enum
+{
+	PROTOCOL_STATE_IDLE = 0,
+	PROTOCOL_STATE_UPLINK,
+	PROTOCOL_STATE_INTERFRAME,
+	PROTOCOL_STATE_UL_TO_DL,
+	PROTOCOL_STATE_WAKEUP,
+	PROTOCOL_STATE_DOWNLINK
+} renard_phy_s2lp_protocol_state_t;
+
+/*
+ * Downlink candidate frame captured during the downlink window, waiting to be decoded. timestamp is the
+ * renard_phy_s2lp_timestamp of reception if RENARD_PHY_S2LP_STATS is enabled, 0 otherwise.
+ */
+typedef struct
+{
+	sfx_dl_encoded encoded;
+	int16_t rssi;
+	uint32_t timestamp;
+} renard_phy_s2lp_protocol_candidate_t;
+
+/*
+ * Statistics of a transfer, only available if RENARD_PHY_S2LP_STATS is enabled (see conf_driver.h). Timestamps are
+ * taken from renard_phy_s2lp_timestamp (microseconds), phases that did not happen have timestamp 0.
+ */
+#define PROTOCOL_STATS_CANDIDATES 4
+
+typedef struct
+{
+	uint32_t start;
+	uint32_t encoded;
+	uint32_t uplink_start[3];
+	uint32_t uplink_end[3];
+	uint32_t wakeup;
+	uint32_t rx_armed;
+	uint32_t end;
+
+	/* Downlink candidate frames: reception time and decode result (bit 0: CRC ok, bit 1: MAC ok) of the first ones */
+	uint8_t candidates;
+	uint32_t candidate_time[PROTOCOL_STATS_CANDIDATES];
+	uint8_t candidate_result[PROTOCOL_STATS_CANDIDATES];
+
+	uint8_t uplinks;
+
+	/* Bit n set if TX FIFO ran empty during uplink frame n, lowest TX FIFO level (renard_phy_s2lp_tx_report) */
+	uint8_t uplink_underruns;
+	uint8_t min_fifo_level;
+
+	renard_phy_s2lp_protocol_error_t error;
+	renard_phy_s2lp_stats_t phy;
+} renard_phy_s2lp_protocol_stats_t;
+
+/*
+ * Protocol context of a single S2-LP, on top of its driver context. The caller provides the memory, all members are
+ * private. Several protocol contexts (with different driver contexts) can run transfers at the same time.
+ */
+typedef struct
+{
+	renard_phy_s2lp_t *phy;
+	uint16_t random;
+#if (RENARD_PHY_S2LP_STATS == 1)
+	renard_phy_s2lp_protocol_stats_t stats;
+#endif
+#if (RENARD_PHY_S2LP_ENERGY == 1)
+	renard_phy_s2lp_energy_t energy;
+#endif
+#if (RENARD_PHY_S2LP_ASYNC == 1)
+	volatile bool uplink_done;
+#endif
+} renard_phy_s2lp_protocol_t;
+
+/*
+ * State of a Sigfox transfer (uplink, optional replicas, optional downlink). The caller provides the memory, all
+ * members are private. common, uplink, downlink and downlink_rssi must remain valid until the transfer is complete.
+ */
+typedef struct
+{
+	renard_phy_s2lp_protocol_t *protocol;
+	sfx_commoninfo *common;
+	sfx_ul_plain *uplink;
+	sfx_dl_plain *downlink;
+	int16_t *downlink_rssi;
+	renard_phy_s2lp_rc_t rc_profile;
+	renard_phy_s2lp_ul_datarate_t datarate;
+	void (*done)(void *context, renard_phy_s2lp_protocol_error_t error);
+	void *done_context;
+
+	renard_phy_s2lp_protocol_state_t state;
+	renard_phy_s2lp_protocol_error_t error;
+	bool blocking;
+	uint8_t fcount;
+	renard_phy_s2lp_channel_t uplink_channels[3];
+	renard_phy_s2lp_channel_t downlink_channel;
+	sfx_ul_encoded uplink_encoded;
+	uint8_t bytestream[SFX_UL_MAX_FRAMELEN];
+	uint8_t bytestream_len;
+	renard_phy_s2lp_protocol_candidate_t candidates[RENARD_PHY_S2LP_DL_CANDIDATES];
+	uint8_t candidates_first;
+	uint8_t candidates_pending;
+} renard_phy_s2lp_protocol_transfer_t;
+
+/*
+ * renard_phy_s2lp_protocol_init: Set up protocol context for the S2-LP with the given (initialized) driver context,
+ *   random seeds the choice of uplink carrier frequencies. Use a different seed for every S2-LP.
+ */
+void renard_phy_s2lp_protocol_init(renard_phy_s2lp_protocol_t *protocol, renard_phy_s2lp_t *phy, uint16_t random);
+renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_transfer(renard_phy_s2lp_protocol_t *protocol,
+		sfx_commoninfo *common, sfx_ul_plain *uplink, sfx_dl_plain *downlink, renard_phy_s2lp_rc_t rc_profile,
+		renard_phy_s2lp_ul_datarate_t datarate, int16_t *downlink_rssi);
+
+/*
+ * Non-blocking transfer, only available if RENARD_PHY_S2LP_ASYNC is enabled (see conf_driver.h):
+ * renard_phy_s2lp_protocol_start: Check parameters, encode uplink and start transmitting it. Returns
+ *   PROTOCOL_ERROR_NONE if the transfer was started, in that case done(context, error) will be called with the
+ *   transfer's result.
+ * renard_phy_s2lp_protocol_poll: Handle pending HAL interrupts, returns true as long as the transfer is in progress.
+ *   Call after every interrupt, e.g. whenever the MCU wakes up from sleep. Calls done once the transfer is complete.
+ * renard_phy_s2lp_protocol_cancel: Abort transfer without calling done, the S2-LP is left in READY with all interrupts
+ *   cleared. Returns PROTOCOL_ERROR_CANCELLED if the transfer was still in progress, otherwise the error it had
+ *   already completed with.
+ * Only one transfer per protocol context can be in progress at a time, poll and cancel use the context that the
+ * transfer was started on.
+ */
+renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_start(renard_phy_s2lp_protocol_t *protocol,
+		renard_phy_s2lp_protocol_transfer_t *transfer, sfx_commoninfo *common, sfx_ul_plain *uplink,
 		sfx_dl_plain *downlink, renard_phy_s2lp_rc_t rc_profile, renard_phy_s2lp_ul_datarate_t datarate,
-		int16_t *downlink_rssi);
+		int16_t *downlink_rssi, void (*done)(void *context, renard_phy_s2lp_protocol_error_t error), void *context);
+bool renard_phy_s2lp_protocol_poll(renard_phy_s2lp_protocol_transfer_t *transfer);
+renard_phy_s2lp_protocol_error_t renard_phy_s2lp_protocol_cancel(renard_phy_s2lp_protocol_transfer_t *transfer);
+
+/* Statistics of the transfer that is currently in progress or was completed last */
+const renard_phy_s2lp_protocol_stats_t *renard_phy_s2lp_protocol_stats(renard_phy_s2lp_protocol_t *protocol);
+
+/*
+ * Energy of the transfer completed last, only available if RENARD_PHY_S2LP_ENERGY is enabled (see conf_driver.h):
+ * Time the S2-LP spent in every state from start to end of the transfer. The estimated charge drawn in uC is
+ * renard_phy_s2lp_energy_charge(phy, renard_phy_s2lp_protocol_energy(protocol)).
+ */
+const renard_phy_s2lp_energy_t *renard_phy_s2lp_protocol_energy(renard_phy_s2lp_protocol_t *protocol);
 
 #endif
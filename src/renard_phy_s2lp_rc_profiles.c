@@ -44,3 +44,32 @@ const int8_t renard_phy_s2lp_fem_power_adjustment_by_rc[] = {
 	30, // RC1: Increase output power because we bypass the FEM
 	27  // RC2: Increase output power since higher output powers are allowed
 };
+
+/* Sigfox Specifications: 4.9.2 Frequency selection in B-procedure */
+uint32_t renard_phy_s2lp_initial_carrier(renard_phy_s2lp_rc_t rc_profile, bool replicas, uint16_t random)
+{
+	uint32_t freq_interframe_gap = renard_phy_s2lp_freq_interframe_gap_by_rc[rc_profile];
+	uint32_t lowerbound = renard_phy_s2lp_freq_bound_low_by_rc[rc_profile] + (replicas ? freq_interframe_gap : 0);
+	uint32_t upperbound = renard_phy_s2lp_freq_bound_high_by_rc[rc_profile] - (replicas ? freq_interframe_gap : 0);
+
+	return lowerbound + (uint64_t)(upperbound - lowerbound) * random / 0xffff;
+}
+
+uint16_t renard_phy_s2lp_random_next(uint16_t *state)
+{
+	*state ^= *state << 7;
+	*state ^= *state >> 9;
+	*state ^= *state << 8;
+
+	return *state;
+}
+
+void renard_phy_s2lp_uplink_carriers(renard_phy_s2lp_rc_t rc_profile, bool replicas, uint16_t random,
+		uint32_t carriers[3])
+{
+	uint32_t freq_interframe_gap = renard_phy_s2lp_freq_interframe_gap_by_rc[rc_profile];
+
+	carriers[0] = renard_phy_s2lp_initial_carrier(rc_profile, replicas, random);
+	carriers[1] = carriers[0] + freq_interframe_gap;
+	carriers[2] = carriers[0] - freq_interframe_gap;
+}
@@ -5,6 +5,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "renard_phy_s2lp.h"
+
 #ifndef _RENARD_PHY_S2LP_RC_PROFILES_H
 #define _RENARD_PHY_S2LP_RC_PROFILES_H
 
@@ -18,5 +20,21 @@ extern const bool renard_phy_s2lp_baudrates_allowed_by_rc[][2];
 extern const bool renard_phy_s2lp_bypass_fem_by_rc[];
 extern const int8_t renard_phy_s2lp_fem_power_adjustment_by_rc[];
 
+/*
+ * Carrier frequency of the initial uplink frame for a random number in [0, 0xffff], chosen such that replicas (if any)
+ * also remain within the RC's bounds. Reentrant, so that it can also be used by host-side simulations.
+ */
+uint32_t renard_phy_s2lp_initial_carrier(renard_phy_s2lp_rc_t rc_profile, bool replicas, uint16_t random);
+
+/*
+ * Frequency plan of a transfer, shared by renard-phy-s2lp-protocol and host-side simulations:
+ * renard_phy_s2lp_random_next: Advance 16-bit XORshift state (must not be 0), returns the next pseudorandom number
+ * renard_phy_s2lp_uplink_carriers: Carrier frequencies of initial uplink frame, first and second replica, in order of
+ *   transmission, with the initial carrier chosen by renard_phy_s2lp_initial_carrier for the given random number
+ */
+uint16_t renard_phy_s2lp_random_next(uint16_t *state);
+void renard_phy_s2lp_uplink_carriers(renard_phy_s2lp_rc_t rc_profile, bool replicas, uint16_t random,
+		uint32_t carriers[3]);
+
 
 #endif
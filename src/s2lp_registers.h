@@ -150,3 +150,27 @@
 #define CMD_FLUSHRXFIFO					0x71
 #define CMD_FLUSHTXFIFO					0x72
 #define CMD_SEQUENCE_UPDATE				0x72
+
+/* IRQ_MASK0 / IRQ_STATUS0 bits, see datasheet "7.4 Interrupts" - Table 50 */
+#define IRQ0_RX_DATA_READY				0x01
+#define IRQ0_TX_FIFO_ERROR				0x20
+
+/* IRQ_MASK3 / IRQ_STATUS3 bits, see datasheet "7.4 Interrupts" - Table 50 */
+#define IRQ3_RX_TIMEOUT					0x10
+
+/* PROTOCOL2 bits: RX timeout stop conditions, see datasheet "5.7.2 RX timer" */
+#define PROTOCOL2_CS_TIMEOUT_MASK		0x80
+#define PROTOCOL2_SQI_TIMEOUT_MASK		0x40
+
+/* PROTOCOL1 bits, see datasheet "5.7.3 Low duty cycle mode" */
+#define PROTOCOL1_LDC_MODE				0x80
+
+/* S2-LP main controller states (MC_STATE0 bits 7..1), see datasheet "5.1 Operating modes" - Table 20 */
+#define MC_STATE_READY					0x00
+#define MC_STATE_SLEEP_NOFIFO			0x01
+#define MC_STATE_STANDBY				0x02
+#define MC_STATE_SLEEP					0x03
+#define MC_STATE_LOCK					0x0C
+#define MC_STATE_RX						0x30
+#define MC_STATE_SYNTH_SETUP			0x50
+#define MC_STATE_TX						0x5C